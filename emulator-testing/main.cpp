@@ -3,9 +3,12 @@
 #include <string_view>
 
 #include "Core.hpp"
+#include "Disasm.hpp"
+#include "InstrInfo.hpp"
 #include "Emulator.hpp"
 #include "ConstexprAdditions.hpp"
 
+#include <algorithm>
 #include <array>
 #include <charconv>
 #include <filesystem>
@@ -16,16 +19,42 @@
 #include <chrono>
 #include <thread>
 
+enum class TestMode {
+	RUN,
+	STEP,	// press enter to execute each instruction
+	BENCH,			// run headless and report mcycles per second
+	BENCH_NO_IDLE,	// same, but without skipping through idle loops
+	BENCH_NO_CATCH_UP,	// same, but the hardware only catches up to the cpu after every instruction
+	SAMPLE,			// run headless with the sampling profiler and write where the time went
+	CALLS,			// run headless with the call profiler and write which functions the time went to
+	DOCTOR,			// run headless and compare every instruction against a gameboy-doctor log
+	TRACE,			// run headless and record every instruction into a binary trace
+	BREAK,			// run headless and print the state every time a breakpoint is hit
+	ANALYSE			// run headless while finding the rom's code in the background, and check it against what ran
+};
+
 static int TestMain(int argc, char** argv);
 static int RunTests(bool step = false);
-static inline int RunTest(std::size_t testNum, bool step = false);
-static int RunTest(const std::filesystem::path& test, bool step = false);
+static inline int RunTest(std::size_t testNum, TestMode mode = TestMode::RUN);
+static int RunTest(const std::filesystem::path& test, TestMode mode = TestMode::RUN);
+static int BenchTest(const std::filesystem::path& test, bool idleLoops, bool catchUp);
+static int SampleTest(const std::filesystem::path& test);
+static int CallProfileTest(const std::filesystem::path& test);
+static int DoctorTest(const std::filesystem::path& test);
+static int TraceTest(const std::filesystem::path& test);
+static int BreakTest(const std::filesystem::path& test);
+static int AnalyseTest(const std::filesystem::path& test);
+static int MicroBench();
+static int InterruptCycleTest();
+static int OpcodeCycleTest();
+static TestMode ParseTestMode(std::string_view arg);
 
 int main(int argc, char** argv) {
 	using namespace gb;
 
 	static constexpr auto testNum = "18";
 	//auto simulatedArgs = std::to_array<const char*>({ "", testNum, "step" });
+	//auto simulatedArgs = std::to_array<const char*>({ "", testNum, "bench" });
 	auto simulatedArgs = std::to_array<const char*>({ "", testNum });
 	//auto simulatedArgs = std::to_array<const char*>({ "" });
 	return TestMain(simulatedArgs.size(), const_cast<char**>(simulatedArgs.data()));
@@ -37,6 +66,10 @@ using namespace std::string_view_literals;
 
 static std::vector<std::filesystem::path> testRoms{};
 
+// Third argument. The log in doctor mode, defaulting to the rom with a .log extension, how many runs of each
+// to compare in sample mode, and where to break in break mode.
+static std::string_view modeArg{};
+
 static int TestMain(int argc, char** argv) {
 	// add all test roms from directories into test rom list
 	for (auto& file : std::filesystem::recursive_directory_iterator{ testPath }) {
@@ -50,6 +83,18 @@ static int TestMain(int argc, char** argv) {
 	if (argc < 2) {
 		std::println(stderr, "To run a specific test, input either a file path or a number. Tests available:");
 		std::println(stderr, "To step through the program, add \"step\" as the second argument.");
+		std::println(stderr, "To benchmark the cpu without a screen, add \"bench\" as the second argument.");
+		std::println(stderr, "To benchmark without skipping idle loops, add \"benchnoidle\" as the second argument.");
+		std::println(stderr, "To benchmark without catching the hardware up partway through instructions, add \"benchnocatchup\" as the second argument.");
+		std::println(stderr, "To profile where the rom spends its time, add \"sample\" and optionally how many runs as the second and third arguments (needs SAMPLING_PROFILER).");
+		std::println(stderr, "To profile how long every function and what it calls take, add \"calls\" as the second argument (needs CALL_PROFILER).");
+		std::println(stderr, "To compare against a gameboy-doctor log, add \"doctor\" and optionally the log as the second and third arguments.");
+		std::println(stderr, "To record a binary trace for gbtrace, add \"trace\" as the second argument (needs INSTR_TRACE).");
+		std::println(stderr, "To stop at a breakpoint, add \"break\" and a label, bank:addr, or addr as the second and third arguments.");
+		std::println(stderr, "To find the rom's code in the background and check it against what runs, add \"analyse\" as the second argument.");
+		std::println(stderr, "To benchmark an ld [hl+], a loop on the cpu alone, use \"microbench\" instead of a test.");
+		std::println(stderr, "To check the cycles interrupt handling takes, use \"interruptcycles\" instead of a test.");
+		std::println(stderr, "To check and time the cycles every op code takes, use \"opcodecycles\" instead of a test.");
 
 		for (const auto [i, test] : std::views::enumerate(testRoms)) {
 			std::string testStr = test.string();
@@ -60,7 +105,16 @@ static int TestMain(int argc, char** argv) {
 
 		return 1;
 	}
+	else if (argv[1] == "microbench"sv)
+		return MicroBench();
+	else if (argv[1] == "interruptcycles"sv)
+		return InterruptCycleTest();
+	else if (argv[1] == "opcodecycles"sv)
+		return OpcodeCycleTest();
 	else {
+		if (argc >= 4)
+			modeArg = argv[3];
+
 		std::string_view str = argv[1];
 		std::size_t testNum;
 		auto [res, ec] = std::from_chars(str.data(), str.data() + str.size(), testNum);
@@ -75,12 +129,8 @@ static int TestMain(int argc, char** argv) {
 				return 1;
 			}
 
-			if (argc >= 3) {
-				std::string_view stepArg = argv[2];
-				bool shouldStep = (stepArg.compare("step") == 0);
-
-				RunTest(testPath, shouldStep);
-			}
+			if (argc >= 3)
+				return RunTest(testPath, ParseTestMode(argv[2]));
 			else
 				return RunTest(testPath);
 		}
@@ -97,12 +147,8 @@ static int TestMain(int argc, char** argv) {
 			return 1;
 		}
 
-		if (argc >= 3) {
-			std::string_view stepArg = argv[2];
-			bool shouldStep = (stepArg.compare("step") == 0);
-
-			return RunTest(testNum, shouldStep);
-		}
+		if (argc >= 3)
+			return RunTest(testNum, ParseTestMode(argv[2]));
 		else
 			return RunTest(testNum);
 	}
@@ -120,19 +166,59 @@ static int RunTests(bool step) {
 	}
 }
 
-static inline int RunTest(std::size_t testNum, bool step) {
-	return RunTest(testPath / testRoms[testNum - 1], step);
+static TestMode ParseTestMode(std::string_view arg) {
+	if (arg.compare("step") == 0)
+		return TestMode::STEP;
+	else if (arg.compare("bench") == 0)
+		return TestMode::BENCH;
+	else if (arg.compare("benchnoidle") == 0)
+		return TestMode::BENCH_NO_IDLE;
+	else if (arg.compare("benchnocatchup") == 0)
+		return TestMode::BENCH_NO_CATCH_UP;
+	else if (arg.compare("sample") == 0)
+		return TestMode::SAMPLE;
+	else if (arg.compare("calls") == 0)
+		return TestMode::CALLS;
+	else if (arg.compare("doctor") == 0)
+		return TestMode::DOCTOR;
+	else if (arg.compare("trace") == 0)
+		return TestMode::TRACE;
+	else if (arg.compare("break") == 0)
+		return TestMode::BREAK;
+	else if (arg.compare("analyse") == 0)
+		return TestMode::ANALYSE;
+
+	return TestMode::RUN;
 }
 
-static int RunTest(const std::filesystem::path& test, bool step) {
+static inline int RunTest(std::size_t testNum, TestMode mode) {
+	return RunTest(testPath / testRoms[testNum - 1], mode);
+}
+
+static int RunTest(const std::filesystem::path& test, TestMode mode) {
 	using namespace gb;
 	using namespace std::chrono_literals;
 
+	if (mode == TestMode::BENCH || mode == TestMode::BENCH_NO_IDLE || mode == TestMode::BENCH_NO_CATCH_UP)
+		return BenchTest(test, mode != TestMode::BENCH_NO_IDLE, mode != TestMode::BENCH_NO_CATCH_UP);
+	else if (mode == TestMode::SAMPLE)
+		return SampleTest(test);
+	else if (mode == TestMode::CALLS)
+		return CallProfileTest(test);
+	else if (mode == TestMode::DOCTOR)
+		return DoctorTest(test);
+	else if (mode == TestMode::TRACE)
+		return TraceTest(test);
+	else if (mode == TestMode::BREAK)
+		return BreakTest(test);
+	else if (mode == TestMode::ANALYSE)
+		return AnalyseTest(test);
+
 	std::println("Running test: {}", test.string());
 
 	Emu emu{ test };
 
-	if (step) {
+	if (mode == TestMode::STEP) {
 		std::println("\n-----Press Enter to execute the next instruction-----\n");
 		emu.Start();
 
@@ -151,6 +237,701 @@ static int RunTest(const std::filesystem::path& test, bool step) {
 	return 0;
 }
 
+// Runs a cpu bound test rom with all dumping turned off and reports the throughput.
+// Build in RelWithDebInfo to get meaningful numbers. Configure with and without THREADED_DISPATCH
+// and ENABLE_JIT to compare the threaded interpreter and the jit against the dispatch table path.
+// Compare against benchnoidle to see how much skipping through idle loops saves, and against benchnocatchup
+// to see what catching the hardware up partway through instructions costs.
+// Configure with OPCODE_PROFILER to also get how often each op code ran, as text and json.
+static int BenchTest(const std::filesystem::path& test, bool idleLoops, bool catchUp) {
+	using namespace gb;
+	using Clock = std::chrono::steady_clock;
+
+	// 60 seconds of emulated time.
+	static constexpr u64 benchCycles = 60ull * 1'048'576;
+	static constexpr double realMHz = 1.048576;
+
+#ifdef JIT
+	static constexpr std::string_view interpreter = "jit";
+#elif defined(THREADED_DISPATCH)
+	static constexpr std::string_view interpreter = "threaded";
+#else
+	static constexpr std::string_view interpreter = "dispatch table";
+#endif
+
+	std::println("Benchmarking test ({} interpreter, idle loops {}, catch up {}): {}",
+				 interpreter, idleLoops ? "skipped" : "run", catchUp ? "on" : "off", test.string());
+
+	Emu emu{ test };
+	emu.Start();
+	emu.SetDump(false, false);
+	emu.SetIdleLoops(idleLoops);
+	emu.SetCatchUp(catchUp);
+
+	const auto start = Clock::now();
+
+	u64 updates = 0;
+	for (; emu.DebugCycles() < benchCycles; ++updates) {
+		if (!emu.DebugCoreUpdate())
+			break;
+	}
+
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+	const double mhz = emu.DebugCycles() / elapsed.count() / 1'000'000.0;
+
+	std::println("{} mcycles ({} updates) in {:.3f}s -- {:.2f} million mcycles per second ({:.1f}x real time)",
+				 emu.DebugCycles(), updates, elapsed.count(), mhz, mhz / realMHz);
+
+	const auto& fusionCounts = emu.DebugCpu().GetFusionCounts();
+	for (std::size_t i = 0; i < fusionCounts.size(); ++i)
+		std::println("\tfused {}: {}", cpu::fusionNames[i], fusionCounts[i]);
+
+	const cpu::IdleLoopStats& idleStats = emu.GetIdleLoopStats();
+	std::println("\tidle loops: {} found, {} skips, {} iterations skipped, {} mcycles skipped ({:.1f}%)",
+				 idleStats.detected, idleStats.skips, idleStats.skippedIterations, idleStats.skippedCycles,
+				 100.0 * idleStats.skippedCycles / std::max<u64>(emu.DebugCycles(), 1));
+
+#ifdef OPCODE_PROFILER
+	const cpu::OpcodeProfiler& profiler = emu.GetOpcodeProfiler();
+	profiler.WriteText(std::cout);
+
+	const std::filesystem::path jsonPath = test.stem().string() + "-opcodes.json";
+	std::ofstream json{ jsonPath };
+	profiler.WriteJson(json);
+	std::println("Op code profile written to {}", jsonPath.string());
+#endif
+
+	return 0;
+}
+
+// Runs the rom headless for the same time as bench, alternating runs without and with the sampling profiler,
+// then prints where the time went and writes <rom>.folded for flamegraph.pl or speedscope.
+// The fastest of each (3 runs unless the third argument says otherwise) is compared, since single runs vary more
+// than the overhead does.
+// Labels come from <rom>.sym if rgblink -n wrote one next to the rom.
+// Needs the emulator configured with SAMPLING_PROFILER.
+static int SampleTest(const std::filesystem::path& test) {
+#ifdef SAMPLING_PROFILER
+	using namespace gb;
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr u64 sampleCycles = 60ull * 1'048'576;
+
+	int runs = 3;
+	if (!modeArg.empty())
+		std::from_chars(modeArg.data(), modeArg.data() + modeArg.size(), runs);
+	runs = std::max(runs, 1);
+
+	std::println("Sampling test: {}", test.string());
+
+	auto run = [&](Emu& emu) {
+		emu.Start();
+		emu.SetDump(false, false);
+
+		const auto start = Clock::now();
+		while (emu.DebugCycles() < sampleCycles) {
+			if (!emu.DebugCoreUpdate())
+				break;
+		}
+
+		return std::chrono::duration<double>{ Clock::now() - start }.count();
+	};
+
+	double baselineTime = std::numeric_limits<double>::max();
+	double sampledTime = std::numeric_limits<double>::max();
+	std::unique_ptr<Emu> emu;
+
+	for (int i = 0; i < runs; ++i) {
+		Emu baseline{ test };
+		baselineTime = std::min(baselineTime, run(baseline));
+
+		emu = std::make_unique<Emu>(test);
+		emu->StartSampling();
+		sampledTime = std::min(sampledTime, run(*emu));
+	}
+
+	const double baselineMHz = sampleCycles / baselineTime / 1'000'000.0;
+	const double sampledMHz = sampleCycles / sampledTime / 1'000'000.0;
+
+	std::println("fastest of {}: {:.2f} million mcycles per second without sampling, {:.2f} with it ({:+.1f}%)",
+				 runs, baselineMHz, sampledMHz, 100.0 * (sampledTime - baselineTime) / baselineTime);
+
+	SamplingProfiler& sampler = *emu->GetSampler();
+	sampler.WriteText(std::cout);
+
+	std::filesystem::path foldedPath = test.filename();
+	foldedPath.replace_extension(".folded");
+
+	std::ofstream folded{ foldedPath };
+	sampler.WriteCollapsed(folded);
+	std::println("Collapsed stacks written to {}", foldedPath.string());
+
+	return 0;
+#else
+	std::println(stderr, "Configure with SAMPLING_PROFILER to use this mode: {}", test.string());
+	return 1;
+#endif // SAMPLING_PROFILER
+}
+
+// Runs the rom headless for the same time as sample with the call profiler, then prints the mcycles spent in
+// and under every function and writes <rom>.callgrind for KCachegrind.
+// Labels come from <rom>.sym if rgblink -n wrote one next to the rom.
+// Needs the emulator configured with CALL_PROFILER.
+static int CallProfileTest(const std::filesystem::path& test) {
+#ifdef CALL_PROFILER
+	using namespace gb;
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr u64 profileCycles = 60ull * 1'048'576;
+
+	std::println("Call profiling test: {}", test.string());
+
+	Emu emu{ test };
+	emu.Start();
+	emu.SetDump(false, false);
+	emu.StartCallProfiling();
+
+	const auto start = Clock::now();
+
+	while (emu.DebugCycles() < profileCycles) {
+		if (!emu.DebugCoreUpdate())
+			break;
+	}
+
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+	std::println("{} mcycles in {:.3f}s", emu.DebugCycles(), elapsed.count());
+
+	const CallProfiler& profiler = *emu.GetCallProfiler();
+	profiler.WriteText(std::cout);
+
+	std::filesystem::path callgrindPath = test.filename();
+	callgrindPath.replace_extension(".callgrind");
+
+	std::ofstream callgrind{ callgrindPath };
+	profiler.WriteCallgrind(callgrind, test.filename().string());
+	std::println("Call graph written to {}", callgrindPath.string());
+
+	return 0;
+#else
+	std::println(stderr, "Configure with CALL_PROFILER to use this mode: {}", test.string());
+	return 1;
+#endif // CALL_PROFILER
+}
+
+// Runs the rom headless and checks the state before every instruction against a gameboy-doctor log,
+// stopping at the first line that doesn't match. Nothing is printed until then.
+// The logs expect LY to always read $90, which this ppu doesn't fake, so roms that poll LY diverge there.
+static int DoctorTest(const std::filesystem::path& test) {
+	using namespace gb;
+	using Clock = std::chrono::steady_clock;
+
+	// Longer than any of the blargg cpu tests take, in case the cpu gets stuck halted.
+	static constexpr u64 maxCycles = 600ull * 1'048'576;
+
+	std::filesystem::path logPath = modeArg;
+	if (logPath.empty()) {
+		logPath = test;
+		logPath.replace_extension(".log");
+	}
+
+	std::println("Comparing test against {}: {}", logPath.string(), test.string());
+
+	Emu emu{ test };
+	emu.Start();
+	emu.SetDump(false, false);
+	emu.SetDoctorLog(logPath);
+
+	const auto start = Clock::now();
+
+	while (emu.DebugCycles() < maxCycles && emu.GetDoctorLog().GetStatus() == cpu::DoctorLog::Status::RUNNING) {
+		if (!emu.DebugCoreUpdate())
+			break;
+	}
+
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+	const cpu::DoctorLog& log = emu.GetDoctorLog();
+	log.PrintReport();
+	std::println("{} mcycles in {:.3f}s", emu.DebugCycles(), elapsed.count());
+
+	return log.GetStatus() == cpu::DoctorLog::Status::MATCHED ? 0 : 1;
+}
+
+// Runs the rom headless for the same time as bench while recording every instruction into <rom>.gbtrace.
+// Use gbtrace to turn any range of it back into ShortDump text.
+// Needs the emulator configured with INSTR_TRACE.
+static int TraceTest(const std::filesystem::path& test) {
+#ifdef INSTR_TRACE
+	using namespace gb;
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr u64 traceCycles = 60ull * 1'048'576;
+	static constexpr double realMHz = 1.048576;
+
+	std::filesystem::path tracePath = test.filename();
+	tracePath.replace_extension(".gbtrace");
+
+	std::println("Tracing test into {}: {}", tracePath.string(), test.string());
+
+	Emu emu{ test };
+	emu.Start();
+	emu.SetDump(false, false);
+
+	if (!emu.StartTrace(tracePath)) {
+		std::println(stderr, "Couldn't create {}.", tracePath.string());
+		return 1;
+	}
+
+	const auto start = Clock::now();
+
+	while (emu.DebugCycles() < traceCycles) {
+		if (!emu.DebugCoreUpdate())
+			break;
+	}
+
+	// Waits for the last blocks to be written.
+	emu.StopTrace();
+
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+	const double mhz = emu.DebugCycles() / elapsed.count() / 1'000'000.0;
+
+	std::println("{} mcycles in {:.3f}s ({:.1f}x real time), {} bytes written", emu.DebugCycles(), elapsed.count(),
+				 mhz / realMHz, std::filesystem::file_size(tracePath));
+
+	return 0;
+#else
+	std::println(stderr, "Configure with INSTR_TRACE to use this mode: {}", test.string());
+	return 1;
+#endif // INSTR_TRACE
+}
+
+// Runs the rom headless for up to 60 seconds of emulated time with a breakpoint at the third argument, and prints
+// the state every time it's hit, up to 16 times. Labels come from <rom>.sym, anything else is bank:addr or addr in hex.
+static int BreakTest(const std::filesystem::path& test) {
+	using namespace gb;
+
+	static constexpr u64 breakCycles = 60ull * 1'048'576;
+	static constexpr int maxHits = 16;
+
+	auto parseHex = [](std::string_view str, u16& val) {
+		if (str.starts_with('$'))
+			str.remove_prefix(1);
+
+		auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), val, 16);
+		return !str.empty() && ec == std::errc{} && ptr == str.data() + str.size();
+	};
+
+	Emu emu{ test };
+	emu.Start();
+	emu.SetDump(false, false);
+
+	// Labels first, since a lot of them are valid hex too.
+	if (!emu.AddBreakpoint(modeArg)) {
+		Breakpoint breakpoint{ .addr = 0 };
+
+		const auto colon = modeArg.find(':');
+		const bool parsed = colon == std::string_view::npos
+			? parseHex(modeArg, breakpoint.addr)
+			: parseHex(modeArg.substr(0, colon), breakpoint.bank) && parseHex(modeArg.substr(colon + 1), breakpoint.addr);
+
+		if (!parsed) {
+			std::println(stderr, "\"{}\" isn't a label in the .sym file next to the rom, bank:addr, or addr.", modeArg);
+			return 1;
+		}
+
+		emu.AddBreakpoint(std::move(breakpoint));
+	}
+
+	std::println("Breaking at {} in test: {}", modeArg, test.string());
+
+	int hits = 0;
+	while (emu.DebugCycles() < breakCycles && hits < maxHits) {
+		if (!emu.DebugCoreUpdate())
+			break;
+
+		if (emu.IsPaused()) {
+			++hits;
+			std::print("{:>10} ", emu.DebugCycles());
+			emu.DebugCpu().ShortDump();
+			emu.Resume();
+		}
+	}
+
+	std::println("Hit {} times in {} mcycles.", hits, emu.DebugCycles());
+	return 0;
+}
+
+// Runs the rom headless for 10 seconds of emulated time while its code is found in the background, then reports how
+// far emulation got before the analysis was ready, what it found, and how many of the rom addresses that ran it found.
+// A second copy of the rom has to get the same analysis back instead of doing it again.
+static int AnalyseTest(const std::filesystem::path& test) {
+	using namespace gb;
+	using namespace std::chrono_literals;
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr u64 analyseCycles = 10ull * 1'048'576;
+
+	Emu emu{ test, Emu::Headless{} };
+	emu.Start();
+	emu.SetDump(false, false);
+
+	std::println("Analysing test: {}", test.string());
+
+	const auto start = Clock::now();
+	emu.StartRomAnalysis();
+
+	rom::SharedAnalysis analysis;
+	std::chrono::duration<double> analyseTime{};
+	u64 readyCycle = 0;
+
+	const auto& memory = emu.DebugMemory();
+	std::vector<bool> ran(memory.RomSize());
+
+	while (emu.DebugCycles() < analyseCycles) {
+		if (!analysis && (analysis = emu.GetRomAnalysis())) {
+			analyseTime = Clock::now() - start;
+			readyCycle = emu.DebugCycles();
+		}
+
+		if (!emu.DebugCoreUpdate())
+			break;
+
+		if (const u16 pc = emu.DebugCpu().reg.pc; pc < romNEnd)
+			ran[memory.RomPhysicalAddr(pc) % ran.size()] = true;
+	}
+
+	while (!analysis) {
+		std::this_thread::sleep_for(1ms);
+		analysis = emu.GetRomAnalysis();
+		analyseTime = Clock::now() - start;
+		readyCycle = emu.DebugCycles();
+	}
+
+	std::size_t ranCount = 0, found = 0;
+	for (u32 addr = 0; addr < ran.size(); ++addr) {
+		if (ran[addr]) {
+			++ranCount;
+			found += analysis->At(addr) == rom::Analysis::Byte::OPCODE;
+		}
+	}
+
+	Emu copy{ test, Emu::Headless{} };
+	copy.StartRomAnalysis();
+
+	rom::SharedAnalysis copyAnalysis;
+	while (!(copyAnalysis = copy.GetRomAnalysis()))
+		std::this_thread::sleep_for(1ms);
+
+	std::println("analysed in {:.3f}s, ready after {} mcycles of emulation", analyseTime.count(), readyCycle);
+	std::println("{} blocks, {} of {} bytes are code ({:.1f}%)", analysis->Blocks().size(), analysis->CodeBytes(),
+				 ran.size(), 100.0 * analysis->CodeBytes() / std::max<std::size_t>(ran.size(), 1));
+	std::println("{} of {} rom addresses that ran were found ({:.1f}%)", found, ranCount,
+				 100.0 * found / std::max<std::size_t>(ranCount, 1));
+	std::println("shared with a second copy: {}", copyAnalysis == analysis ? "yes" : "no");
+
+	return copyAnalysis == analysis ? 0 : 1;
+}
+
+// Runs a loop of ld [hl+], a that fills work ram on the cpu alone, without the rest of the hardware.
+// Mostly measures the register file and the memory write path.
+static int MicroBench() {
+	using namespace gb;
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr u64 benchInstrs = 100'000'000;
+
+	// $0150: ld a, $AA
+	// $0152: ld hl, $C000
+	//        ld c, 8
+	// $0157: ld b, 0
+	// $0159: ld [hl+], a (x4)
+	//        dec b
+	//        jr nz, $0159
+	//        dec c
+	//        jr nz, $0157
+	//        jp $0152
+	static constexpr auto program = std::to_array<byte>({
+		0x3E, 0xAA, 0x21, 0x00, 0xC0, 0x0E, 0x08, 0x06, 0x00, 0x22, 0x22, 0x22, 0x22,
+		0x05, 0x20, 0xF9, 0x0D, 0x20, 0xF4, 0xC3, 0x52, 0x01
+	});
+
+	rom::RomData data(2 * romBankSize);
+	std::ranges::copy(std::to_array<byte>({ 0x00, 0xC3, 0x50, 0x01 }), data.begin() + 0x0100);	// nop; jp $0150
+	std::ranges::copy(program, data.begin() + headerEnd);
+
+	Timer timer;
+	Memory memory{ std::move(data), timer };
+	cpu::Context cpu{ memory };
+
+	cpu::Context::shortDump = false;
+	cpu::Context::longDump = false;
+
+	std::println("Benchmarking ld [hl+], a loop: {} instructions", benchInstrs);
+
+	const auto start = Clock::now();
+
+	u64 mCycles = 0;
+	for (u64 i = 0; i < benchInstrs; ++i) {
+		if (!cpu.Update())
+			break;
+
+		mCycles += cpu.GetUpdateCycles();
+	}
+
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+	std::println("{} mcycles in {:.3f}s -- {:.2f} million instructions per second",
+				 mCycles, elapsed.count(), benchInstrs / elapsed.count() / 1'000'000.0);
+
+	return 0;
+}
+
+// Checks that with ime set and nothing pending, instructions take exactly as long as they do with ime cleared,
+// and that dispatching an interrupt takes 5 mcycles on top of the instruction before it.
+static int InterruptCycleTest() {
+	using namespace gb;
+
+	// $0150: ei, then nothing but nops (the rest of the rom is 0).
+	rom::RomData data(2 * romBankSize);
+	std::ranges::copy(std::to_array<byte>({ 0x00, 0xC3, 0x50, 0x01 }), data.begin() + 0x0100);	// nop; jp $0150
+	data[headerEnd] = 0xFB;
+
+	Timer timer;
+	Memory memory{ std::move(data), timer };
+	cpu::Context cpu{ memory };
+
+	cpu::Context::shortDump = false;
+	cpu::Context::longDump = false;
+
+	int failures = 0;
+	const auto expect = [&](std::string_view what, u64 expected) {
+		if (!cpu.Update()) {
+			std::println(stderr, "FAIL {}: the cpu stopped", what);
+			++failures;
+		}
+		else if (cpu.GetUpdateCycles() != expected) {
+			std::println(stderr, "FAIL {}: {} mcycles, expected {}", what, cpu.GetUpdateCycles(), expected);
+			++failures;
+		}
+	};
+
+	expect("nop", 1);
+	expect("jp imm16", 4);
+	expect("ei", 1);
+
+	// ie is 0, so nothing can be pending.
+	for (int i = 0; i < 16; ++i)
+		expect("nop with ime set and nothing pending", 1);
+
+	// Requested but not enabled.
+	memory.RequestInterrupt(Interrupt::TIMER);
+	expect("nop with ime set and a disabled interrupt requested", 1);
+
+	memory.Write(0xFFFF, static_cast<byte>(Interrupt::TIMER) | static_cast<byte>(Interrupt::SERIAL));
+	expect("nop then the timer interrupt", 1 + 5);
+
+	if (cpu.reg.pc != 0x0050) {
+		std::println(stderr, "FAIL timer interrupt jumped to {:#06x}, expected 0x0050", cpu.reg.pc);
+		++failures;
+	}
+
+	if (memory.PendingInterrupts() != 0) {
+		std::println(stderr, "FAIL the timer interrupt is still pending after being dispatched");
+		++failures;
+	}
+
+	// ime was cleared by the dispatch, so a pending interrupt isn't taken.
+	memory.RequestInterrupt(Interrupt::SERIAL);
+	expect("nop with ime cleared and an interrupt pending", 1);
+
+	if (failures == 0)
+		std::println("Interrupt cycle test passed.");
+
+	return failures;
+}
+
+// Mcycles every non-prefixed op code takes from the gbdev op code tables, when its condition is false for
+// conditional ones. 0 for unused op codes, the cb prefix, and halt and stop, which don't run on their own.
+static constexpr std::array<gb::byte, 256> opCodeCycles = {
+//	x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 xA xB xC xD xE xF
+	1, 3, 2, 2, 1, 1, 2, 1, 5, 2, 2, 2, 1, 1, 2, 1,	// 0x
+	0, 3, 2, 2, 1, 1, 2, 1, 3, 2, 2, 2, 1, 1, 2, 1,	// 1x
+	2, 3, 2, 2, 1, 1, 2, 1, 2, 2, 2, 2, 1, 1, 2, 1,	// 2x
+	2, 3, 2, 2, 3, 3, 3, 1, 2, 2, 2, 2, 1, 1, 2, 1,	// 3x
+	1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	// 4x
+	1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	// 5x
+	1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	// 6x
+	2, 2, 2, 2, 2, 2, 0, 2, 1, 1, 1, 1, 1, 1, 2, 1,	// 7x
+	1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	// 8x
+	1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	// 9x
+	1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	// Ax
+	1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	// Bx
+	2, 3, 3, 4, 3, 4, 2, 4, 2, 4, 3, 0, 3, 6, 2, 4,	// Cx
+	2, 3, 3, 0, 3, 4, 2, 4, 2, 4, 3, 0, 3, 0, 2, 4,	// Dx
+	3, 3, 2, 0, 0, 4, 2, 4, 4, 1, 4, 0, 0, 0, 2, 4,	// Ex
+	3, 3, 2, 1, 0, 4, 2, 4, 3, 2, 4, 1, 0, 0, 2, 4	// Fx
+};
+
+// Mcycles a conditional op code takes when its condition is true.
+static constexpr gb::byte TakenCycles(gb::byte op) {
+	using gb::cpu::Flow;
+	const gb::cpu::InstrInfo info = gb::cpu::instrInfo[op];
+
+	switch (info.flow) {
+	case Flow::COND_JUMP: return info.length == 2 ? 3 : 4;	// jr cc, jp cc
+	case Flow::COND_CALL: return 6;
+	case Flow::COND_RET: return 5;
+	default: return opCodeCycles[op];
+	}
+}
+
+// Mcycles every cb prefixed op code takes, including the prefix. bit only reads [hl], the rest write it back.
+static constexpr gb::byte CbCycles(gb::byte op) {
+	if ((op & 0b111) != 6)
+		return 2;
+
+	return (op >> 6) == 1 ? 3 : 4;
+}
+
+// Runs every op code on its own, non-prefixed and cb prefixed, from every register state in a grid with hl pointing at
+// wram and hram, and checks the mcycles Context::GetUpdateCycles reports against the published timing table.
+// Conditional op codes are checked both ways. Then times every op code over the same grid, and prints nanoseconds
+// per instruction for each one, including the fetch.
+// Runs on a lone cpu and memory without the rest of the hardware, with the code in wram so it can be rewritten.
+static int OpcodeCycleTest() {
+	using namespace gb;
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr u16 codeAddr = 0xC000;
+	static constexpr u16 returnAddr = 0xC200;
+	static constexpr u32 timedRuns = 2000;
+
+	// Immediates make every jump, call, and ldh land somewhere harmless: jr -$80, $C180, and $FF80.
+	static constexpr byte imm0 = 0x80;
+	static constexpr byte imm1 = 0xC1;
+
+	struct State {
+		u16 af, bc, de, hl, sp;
+	};
+
+	// Flags cover every condition both ways. bc and de point into wram, and c into hram for ldh [c].
+	std::vector<State> states;
+	for (u16 a : { 0x00, 0x0F, 0x80, 0xFF }) {
+		for (u16 f : { 0x00, 0x10, 0x80, 0xF0 }) {
+			states.push_back({ static_cast<u16>(a << 8 | f), 0xC980, 0xCA01, 0xC800, 0xDFF0 });
+			states.push_back({ static_cast<u16>(a << 8 | f), 0xC980, 0xCA01, 0xFF90, 0xFFF0 });
+		}
+	}
+
+	rom::RomData data(2 * romBankSize);
+	Timer timer;
+	Memory memory{ std::move(data), timer };
+	cpu::Context cpu{ memory };
+
+	cpu::Context::shortDump = false;
+	cpu::Context::longDump = false;
+
+	// Nothing can be dispatched in between, and jumping back can't be taken for an idle loop.
+	memory.Write(0xFFFF, 0);
+	cpu.SetIdleLoops(false);
+
+	// ret and pop read the same address from either stack.
+	for (const State& state : states) {
+		memory.Write(state.sp, returnAddr & 0xFF);
+		memory.Write(static_cast<u16>(state.sp + 1), returnAddr >> 8);
+	}
+
+	auto load = [&](const std::array<byte, 3>& bytes) {
+		for (u16 i = 0; i < bytes.size(); ++i)
+			memory.Write(static_cast<u16>(codeAddr + i), bytes[i]);
+	};
+
+	auto run = [&](const State& state) {
+		cpu.reg.af(state.af);
+		cpu.reg.bc(state.bc);
+		cpu.reg.de(state.de);
+		cpu.reg.hl(state.hl);
+		cpu.reg.sp = state.sp;
+		cpu.reg.pc = codeAddr;
+
+		return cpu.Update();
+	};
+
+	int failures = 0;
+	std::array<std::array<double, 256>, 2> nanoseconds{};
+
+	for (int prefixed = 0; prefixed < 2; ++prefixed) {
+		for (u32 op = 0; op < 256; ++op) {
+			const byte expected = prefixed ? CbCycles(static_cast<byte>(op)) : opCodeCycles[op];
+			if (expected == 0)
+				continue;
+
+			const std::array<byte, 3> bytes = prefixed
+				? std::array<byte, 3>{ 0xCB, static_cast<byte>(op), 0 }
+				: std::array<byte, 3>{ static_cast<byte>(op), imm0, imm1 };
+
+			const disasm::Line line = disasm::Disassemble(codeAddr, bytes);
+			load(bytes);
+
+			// Only the first mismatch of every op code and outcome is reported.
+			bool reported[2] = { false, false };
+
+			for (const State& state : states) {
+				if (!run(state)) {
+					std::println(stderr, "FAIL {} (${:02X}): the cpu stopped", line.text, op);
+					++failures;
+					break;
+				}
+
+				const bool taken = cpu.reg.pc != codeAddr + line.length;
+				const u64 want = !prefixed && taken ? TakenCycles(static_cast<byte>(op)) : expected;
+
+				if (cpu.GetUpdateCycles() != want && !reported[taken]) {
+					std::println(stderr, "FAIL {} (${}{:02X}){}: {} mcycles, expected {}", line.text, prefixed ? "CB " : "",
+								 op, taken && TakenCycles(static_cast<byte>(op)) != expected ? " taken" : "", cpu.GetUpdateCycles(), want);
+					reported[taken] = true;
+					++failures;
+				}
+			}
+
+			const auto start = Clock::now();
+			for (u32 i = 0; i < timedRuns; ++i) {
+				for (const State& state : states)
+					(void)run(state);
+			}
+			const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+
+			nanoseconds[prefixed][op] = elapsed.count() / (timedRuns * states.size());
+		}
+	}
+
+	// Laid out like the op code tables, blank where nothing was run.
+	for (int prefixed = 0; prefixed < 2; ++prefixed) {
+		std::println("\nNanoseconds per {} instruction:", prefixed ? "cb prefixed" : "non-prefixed");
+		std::print("    ");
+		for (u32 col = 0; col < 16; ++col)
+			std::print("{:>6}", std::format("x{:X}", col));
+		std::println("");
+
+		for (u32 row = 0; row < 16; ++row) {
+			std::print("{:X}x  ", row);
+			for (u32 col = 0; col < 16; ++col) {
+				const double ns = nanoseconds[prefixed][row * 16 + col];
+				ns == 0.0 ? std::print("{:>6}", "") : std::print("{:6.1f}", ns);
+			}
+			std::println("");
+		}
+	}
+
+	std::println("");
+	if (failures == 0)
+		std::println("Op code cycle test passed.");
+	else
+		std::println("Op code cycle test failed: {} mismatches.", failures);
+
+	return failures;
+}
+
 #else // DEBUG && TESTS
 #include <print>
 
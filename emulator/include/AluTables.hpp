@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+
+#include "Core.hpp"
+
+// Flag results for the 8-bit alu instructions, worked out at compile time.
+// Every table entry is a value for the f register (znhc0000).
+// CPUInstructions.cpp checks every table against the formulas below for every possible input.
+namespace gb::cpu::alu {
+
+static constexpr byte zeroFlag = 1 << 7;
+static constexpr byte subtractFlag = 1 << 6;
+static constexpr byte halfCarryFlag = 1 << 5;
+static constexpr byte carryFlag = 1 << 4;
+
+#pragma region reference formulas
+constexpr byte MakeFlags(bool z, bool n, bool h, bool c) {
+	return (z ? zeroFlag : 0) | (n ? subtractFlag : 0) | (h ? halfCarryFlag : 0) | (c ? carryFlag : 0);
+}
+
+// lhs + rhs + carry
+constexpr byte AddFlags(byte lhs, byte rhs, byte carry) {
+	return MakeFlags(static_cast<byte>(lhs + rhs + carry) == 0, false,
+					 (lhs & 0x0F) + (rhs & 0x0F) + carry >= 0x10, lhs + rhs + carry >= 0x100);
+}
+
+// lhs - rhs - carry
+constexpr byte SubFlags(byte lhs, byte rhs, byte carry) {
+	return MakeFlags(static_cast<byte>(lhs - rhs - carry) == 0, true,
+					 (lhs & 0x0F) - (rhs & 0x0F) - carry < 0, rhs + carry > lhs);
+}
+
+// 8-bit inc and dec from the result. Carry isn't touched by either.
+constexpr byte IncFlags(byte result) {
+	return MakeFlags(result == 0, false, (result & 0x0F) == 0x00, false);
+}
+
+constexpr byte DecFlags(byte result) {
+	return MakeFlags(result == 0, true, (result & 0x0F) == 0x0F, false);
+}
+
+struct DaaResult {
+	byte a;
+	byte f;
+};
+
+// https://gbdev.io/pandocs/CPU_Instruction_Set.html#decimal-adjust-accumulator
+constexpr DaaResult Daa(byte a, bool n, bool h, bool c) {
+	byte adjustment = 0;
+
+	if (n) {
+		if (h)
+			adjustment += 0x6;
+
+		if (c)
+			adjustment += 0x60;
+
+		a -= adjustment;
+	}
+	else {
+		if (h || (a & 0xF) > 0x9)
+			adjustment += 0x6;
+
+		if (c || a > 0x99) {
+			adjustment += 0x60;
+			c = true;
+		}
+
+		a += adjustment;
+	}
+
+	return { a, MakeFlags(a == 0, n, false, c) };
+}
+#pragma endregion reference formulas
+
+#pragma region tables
+// Add and sub tables are indexed by the 9-bit result and the carry out of bit 3.
+// Bit 8 of the result is the carry (or borrow), and bit 4 of lhs ^ rhs ^ result is the half carry (or borrow).
+// The result has to be worked out anyway, so this costs a few bit operations instead of comparisons.
+constexpr std::size_t AluIndex(int result, byte lhs, byte rhs) {
+	return static_cast<std::size_t>(result & 0x1FF) << 1 | ((lhs ^ rhs ^ result) >> 4 & 1);
+}
+
+template <bool Subtract>
+consteval std::array<byte, 0x400> MakeAluTable() {
+	std::array<byte, 0x400> table{};
+
+	for (std::size_t i = 0; i < table.size(); ++i) {
+		const std::size_t result = i >> 1;
+		table[i] = MakeFlags((result & 0xFF) == 0, Subtract, i & 1, result & 0x100);
+	}
+
+	return table;
+}
+
+template <auto Formula>
+consteval std::array<byte, 0x100> MakeResultTable() {
+	std::array<byte, 0x100> table{};
+
+	for (std::size_t i = 0; i < table.size(); ++i)
+		table[i] = Formula(static_cast<byte>(i));
+
+	return table;
+}
+
+// Indexed by a << 3 | n << 2 | h << 1 | c. Each entry is the new a in the high byte and f in the low byte.
+constexpr std::size_t DaaIndex(byte a, bool n, bool h, bool c) {
+	return static_cast<std::size_t>(a) << 3 | n << 2 | h << 1 | static_cast<std::size_t>(c);
+}
+
+consteval std::array<u16, 0x800> MakeDaaTable() {
+	std::array<u16, 0x800> table{};
+
+	for (std::size_t i = 0; i < table.size(); ++i) {
+		const auto [a, f] = Daa(static_cast<byte>(i >> 3), i & 0b100, i & 0b010, i & 0b001);
+		table[i] = static_cast<u16>(a << 8 | f);
+	}
+
+	return table;
+}
+
+inline constexpr auto addTable = MakeAluTable<false>();
+inline constexpr auto subTable = MakeAluTable<true>();
+inline constexpr auto incTable = MakeResultTable<IncFlags>();
+inline constexpr auto decTable = MakeResultTable<DecFlags>();
+inline constexpr auto daaTable = MakeDaaTable();
+#pragma endregion tables
+
+} // namespace gb::cpu::alu
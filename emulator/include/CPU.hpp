@@ -1,11 +1,36 @@
 #pragma once
 
+#include <array>
+#include <bit>
+#include <bitset>
+#include <memory>
+#include <string_view>
+
+#include "AluTables.hpp"
 #include "Core.hpp"
+#include "DecodeCache.hpp"
+#include "IdleLoop.hpp"
+
+#ifdef DEBUG
+#include "DoctorLog.hpp"
+#endif
+
+#ifdef OPCODE_PROFILER
+#include "OpcodeProfiler.hpp"
+#endif
+
+#if defined(THREADED_DISPATCH) && !(defined(__GNUC__) || defined(__clang__))
+#error "THREADED_DISPATCH needs labels as values, which is only supported by GCC and Clang."
+#endif
 
 namespace gb {
 
 class Memory;
 
+#ifdef CALL_PROFILER
+class CallProfiler;
+#endif
+
 namespace cpu {
 
 /* 
@@ -50,12 +75,33 @@ register file (holds cpu state in registers)
 
 enum class OpCode : byte;
 
+class Recompiled;
+struct RecompiledRom;
+
+#ifdef JIT
+class Jit;
+#endif
+
 class Context {
 // --- Structs and Typedefs ---
 public:
 	// Function signature for all cpu instruction handlers.
 	using InstrFunc = void(*)(Context&, Memory&);
 
+	// What the hardware says once it has caught up to an instruction.
+	enum class SyncResult : byte {
+		CONTINUE,
+		STOP,		// e.g. paused. Run stops early and returns true
+		FAILED		// the hardware can't keep going. Run returns false
+	};
+
+	// Called after every instruction with the mcycles it took so the rest of the hardware can catch up.
+	using SyncFunc = SyncResult(*)(void* owner, u64 mCycles);
+
+	// Called before an instruction in a page marked with MarkDebugPage runs.
+	// Returning true stops the update before the instruction, without running anything.
+	using BreakFunc = bool(*)(void* owner);
+
 	struct Flags {
 		// bytes instead of bools so they can all be set with a single number
 		byte Zero : 1;		// z
@@ -83,29 +129,68 @@ public:
 			HalfCarry = h;
 			Carry = c;
 		}
+
+		// Flags for lhs + rhs + carry.
+		constexpr void SetAdd(byte l, byte r, byte carry = 0) {
+			*this = alu::addTable[alu::AluIndex(l + r + carry, l, r)];
+		}
+
+		// Flags for lhs - rhs - carry.
+		constexpr void SetSub(byte l, byte r, byte carry = 0) {
+			*this = alu::subTable[alu::AluIndex(l - r - carry, l, r)];
+		}
+
+		// Flags for an 8-bit increment or decrement that gave result. Carry is left alone.
+		constexpr void SetInc(byte result) {
+			*this = static_cast<byte>(alu::incTable[result] | Carry << 4);
+		}
+
+		constexpr void SetDec(byte result) {
+			*this = static_cast<byte>(alu::decTable[result] | Carry << 4);
+		}
+
+		// Flags for and, or, and xor. Only and sets the half carry.
+		constexpr void SetLogic(byte result, bool halfCarry) {
+			SetAllBool(result == 0, 0, halfCarry, 0);
+		}
+	};
+
+	// bc, de, or hl stored as one 16-bit value in native byte order.
+	// Reading or writing the whole pair is a single 16-bit load or store, and each half is still a plain byte.
+	struct RegisterPair {
+		static constexpr std::size_t lowIndex = std::endian::native == std::endian::little ? 0 : 1;
+
+		alignas(u16) std::array<byte, 2> bytes{};
+
+		constexpr u16 Get() const { return std::bit_cast<u16>(bytes); }
+		constexpr void Set(u16 val) { bytes = std::bit_cast<std::array<byte, 2>>(val); }
+
+		constexpr byte& High() { return bytes[1 - lowIndex]; }
+		constexpr byte High() const { return bytes[1 - lowIndex]; }
+		constexpr byte& Low() { return bytes[lowIndex]; }
+		constexpr byte Low() const { return bytes[lowIndex]; }
 	};
 
 	struct RegisterFile {
+		// Indices into pairs. Same order as the 16-bit register bits in op codes.
+		static constexpr std::size_t bcIndex = 0;
+		static constexpr std::size_t deIndex = 1;
+		static constexpr std::size_t hlIndex = 2;
+
 		u16 pc;
 		u16 sp;
 		byte a;
 		Flags f;
 
-		byte b, c;
-		byte d, e;
-		byte h, l;
-
-		// const & non-const versions because of hl+ and hl- :/
-#define U16GETTERS(r1, r2) \
-		constexpr u16 r1##r2() const { return (static_cast<u16>(r1) << 8) + r2; } \
-		constexpr u16 r1##r2() { return (static_cast<u16>(r1) << 8) + r2; }
+		std::array<RegisterPair, 3> pairs{};
 
 #define REGISTER16(r1, r2) \
-		U16GETTERS(r1, r2) \
-		constexpr void r1##r2(u16 val) { \
-			r1 = static_cast<u8>((val & 0xFF00) >> 8); \
-			r2 = static_cast<u8>(val & 0x00FF); \
-		}
+		constexpr u16 r1##r2() const { return pairs[r1##r2##Index].Get(); } \
+		constexpr void r1##r2(u16 val) { pairs[r1##r2##Index].Set(val); } \
+		constexpr byte& r1() { return pairs[r1##r2##Index].High(); } \
+		constexpr byte r1() const { return pairs[r1##r2##Index].High(); } \
+		constexpr byte& r2() { return pairs[r1##r2##Index].Low(); } \
+		constexpr byte r2() const { return pairs[r1##r2##Index].Low(); }
 
 #define HLINDIRECT(suffix, expr) \
 		constexpr u16 hl##suffix() { \
@@ -115,17 +200,26 @@ public:
 		} \
 		constexpr void hl##suffix(u16 val) { hl(val expr 1); }
 
-		REGISTER16(a, f);
 		REGISTER16(b, c);
 		REGISTER16(d, e);
 		REGISTER16(h, l);
 
 		HLINDIRECT(Plus, +);
 		HLINDIRECT(Minus, -);
-#undef U16GETTER
 #undef REGISTER16
 #undef HLINDIRECT
 
+		// a and f aren't stored together, f has to be packed.
+		constexpr u16 af() const { return (static_cast<u16>(a) << 8) | f; }
+		constexpr void af(u16 val) {
+			a = static_cast<byte>(val >> 8);
+			f = static_cast<byte>(val & 0x00FF);
+		}
+
+		// Increment and decrement a pair by its index.
+		constexpr void Inc(std::size_t pair) { pairs[pair].Set(pairs[pair].Get() + 1); }
+		constexpr void Dec(std::size_t pair) { pairs[pair].Set(pairs[pair].Get() - 1); }
+
 		// Implementation requires a callable getter/setter for sp.
 		constexpr u16 spGet() const { return sp; }
 		constexpr void spSet(u16 val) { sp = val; }
@@ -138,6 +232,10 @@ public:
 	// Instruction register -- This holds the current op code
 	byte ir;
 
+	// Immediate data following the current op code. Filled in by Fetch.
+	// Fused instructions have the immediates of the whole sequence.
+	std::array<byte, 4> imm{};
+
 #ifdef DEBUG
 	// If the cpu should dump current state after each instruction
 	static inline bool shortDump = true;
@@ -148,12 +246,38 @@ public:
 public:
 	// Mimic booting up the cpu
 	explicit Context(Memory& memory);
+	~Context();
 
 	bool Update();
 
-	// Increment and Decrement functions for 16-bit addresses
-	void Inc(u16 reg16);
-	void Dec(u16 reg16);
+#ifdef THREADED_DISPATCH
+	// Runs instructions back to back until at least cycleBudget mcycles have passed or sync says to stop.
+	// Each handler jumps straight to the next one instead of returning to the caller. Like RunRecompiled,
+	// sync is only called once the hardware could have changed something the cpu sees.
+	// Returns false if the cpu or the hardware couldn't continue.
+	bool Run(u64 cycleBudget, SyncFunc sync, void* owner);
+#endif
+
+	// Uses code that was recompiled ahead of time for the loaded rom. Returns false if the rom doesn't match.
+	bool SetRecompiled(const RecompiledRom& rom);
+	inline bool HasRecompiled() const { return _recompiled != nullptr; }
+
+	// Same as Run, but uses the recompiled code wherever there is some.
+	bool RunRecompiled(u64 cycleBudget, SyncFunc sync, void* owner);
+
+#ifdef JIT
+	// Same as Run, but translates the code it runs into native code first. The translations are made
+	// the first time this is called.
+	bool RunJit(u64 cycleBudget, SyncFunc sync, void* owner);
+
+	// Turning the jit off makes RunJit use the interpreter instead.
+	inline void SetJit(bool enabled) { _jitEnabled = enabled; }
+	inline bool IsJitEnabled() const { return _jitEnabled; }
+
+	// Runs every translated block through the interpreter as well and compares the results.
+	// The jit turns itself off after the first mismatch.
+	void SetJitValidation(bool enabled);
+#endif
 
 	// Stack pop and push implementations.
 	void PushStack(u16 value);
@@ -164,29 +288,178 @@ public:
 	void Halt();
 	void Hang();
 
+	inline bool IsHalted() const { return _isHalted; }
+
+	// The next update while halted takes mCycles more mcycles without checking for interrupts in between.
+	// Set by the hardware when it knows nothing can be requested before then.
+	inline void SkipHalted(u64 mCycles) { _skipCycles = mCycles; }
+
+	// The next update skips iterations of the idle loop the cpu is at the start of, instead of running anything.
+	// Set by the hardware when it knows nothing the loop reads changes before then.
+	inline void SkipIdleLoop(u64 iterations, u64 mCycles) {
+		_skipCycles = mCycles;
+		_idleLoops.CountSkip(iterations, mCycles);
+	}
+
+	// Called by jumps to an earlier address after setting the pc. loopEnd is the address after the jump.
+	inline void JumpedBack(u16 loopEnd) {
+		if (_idleLoopsEnabled && loopEnd - reg.pc <= IdleLoopDetector::maxLoopBytes)
+			_idleLoops.JumpedBack(_memory, { reg.af(), reg.bc(), reg.de(), reg.hl(), reg.sp, _ime, _enablingIME }, reg.pc, loopEnd);
+	}
+
+	// Busy waiting loops are only found while enabled, so the hardware never skips through them.
+	inline void SetIdleLoops(bool enabled) { _idleLoopsEnabled = enabled; }
+
+	// The idle loop iteration that finished this update, unless an interrupt was dispatched right after it.
+	inline std::optional<IdleIteration> TakeIdleIteration() {
+		const std::optional<IdleIteration> iteration = _idleLoops.TakeIteration();
+		return iteration && iteration->head == reg.pc ? iteration : std::nullopt;
+	}
+
+	inline const IdleLoopStats& GetIdleLoopStats() const { return _idleLoops.GetStats(); }
+
+	// Mcycles the cpu can run past the last sync before the hardware could change anything it sees, other than
+	// through an access that catches it up. Set by the hardware after every sync, and back to 0 whenever the cpu
+	// catches it up, since the access may have changed what it does next.
+	inline void SetQuietCycles(u64 mCycles) { _quietCycles = mCycles; }
+
+	// If Run, RunRecompiled, or RunJit can keep adding up cycles instead of syncing after this instruction. The
+	// hardware still has to process every halt, skip, dma mcycle, and idle loop iteration on the instruction it happened.
+	inline bool CanDeferSync() const {
+		return _mCycles <= _quietCycles && !_isHalted && _skipCycles == 0 && !_memory.IsDMAActive()
+			&& !_idleLoops.HasIteration();
+	}
+
+#ifdef OPCODE_PROFILER
+	inline OpcodeProfiler& GetProfiler() { return _profiler; }
+#endif
+
+	// Name of the handler for an op code, like ld_r8_r8. Unused op codes are "undefined".
+	static std::string_view InstrName(byte op, bool prefixed = false);
+
+	// Which instruction an op code is. Unused op codes are OpCode::undefined.
+	static OpCode InstrOp(byte op, bool prefixed = false);
+
 	inline void EnableInterrupts() { _enablingIME = true; }
 	inline void DisableInterrupts() { _enablingIME = false; _ime = false; }
 	inline void ForceEnableInterrupts() { _ime = true; }
+	inline bool InterruptsEnabled() const { return _ime; }
 
 	inline u64 GetUpdateCycles() const { return _mCycles; }
 
+	// Fused instructions run a whole sequence in one update with the same cycles and results.
+	// An interrupt can still be taken between any two of them, see EndFusedStep.
+	inline void SetFusion(bool enabled) { _fusionEnabled = enabled; }
+	inline void CountFusion(Fusion fusion) { ++_fusionCounts[static_cast<std::size_t>(fusion)]; }
+	inline const auto& GetFusionCounts() const { return _fusionCounts; }
+
+	// Called by fused handlers between two instructions. Does what the end of an update and the hardware
+	// processing it would, so interrupts are taken after the same instruction. Returns false if one was,
+	// which ends the sequence.
+	inline bool EndFusedStep() {
+		if (!(_ime | _enablingIME)) [[likely]]
+			return true;
+
+		if (_ime & (_memory.PendingInterrupts() != 0)) {
+			InterruptHandler();
+			return false;
+		}
+
+		if (_enablingIME)
+			_ime = true;
+
+		// The next check has to see anything the hardware requested during this instruction.
+		_memory.CatchUpNow();
+		return true;
+	}
+
+	// Breakpoints and watchpoints mark the 256 byte page they're in.
+	// Sequences that run code or access memory in a marked page are never fused.
+	inline void MarkDebugPage(u16 addr) { _debugPages.set(addr >> 8); }
+	inline void ClearDebugPages() { _debugPages.reset(); }
+
+	// Nothing is checked unless a break check is set. While one is, Run, RunJit, and RunRecompiled go through
+	// Update for every instruction so none get skipped. nullptr to stop checking.
+	inline void SetBreakCheck(BreakFunc check, void* owner) { _breakCheck = check; _breakOwner = owner; }
+	inline bool HasBreakCheck() const { return _breakCheck != nullptr; }
+
 #ifdef DEBUG
 	// Dumps current state of the cpu to console or a file
 	void LongDump() const;
 	void ShortDump() const;
+
+	// Compares the state before every instruction against a gameboy-doctor log. Update returns false once it
+	// diverges or the log ends. nullptr to stop comparing.
+	inline void SetDoctorLog(DoctorLog* log) { _doctorLog = log; }
+#endif
+
+#ifdef CALL_PROFILER
+	// Every call, rst, interrupt dispatch, and return is reported to the profiler while one is set. nullptr to stop.
+	inline void SetCallProfiler(CallProfiler* profiler) { _callProfiler = profiler; }
+#endif
+
+	// Called by the call, rst, and return handlers right after they've moved the pc.
+	// Compiled out without CALL_PROFILER.
+	inline void Called() {
+#ifdef CALL_PROFILER
+		if (_callProfiler) [[unlikely]]
+			ProfileCall();
+#endif
+	}
+
+	inline void Returned() {
+#ifdef CALL_PROFILER
+		if (_callProfiler) [[unlikely]]
+			ProfileReturn();
+#endif
+	}
+
+#ifdef INSTR_TRACE
+	// Set while the hardware records the state before every instruction into a trace.
+	inline void SetTracing(bool tracing) { _tracing = tracing; }
+#endif
+
+	// Something needs the state before every instruction, so nothing can be fused, translated, or recompiled.
+	inline bool IsTracing() const {
+#ifdef DEBUG
+		if (longDump || shortDump || _doctorLog != nullptr)
+			return true;
+#endif
+#ifdef INSTR_TRACE
+		return _tracing;
+#else
+		return false;
 #endif
+	}
 
 // --- Functions ---
 private:
-	// Translate memory from specified address to an op code.
+	// Translate memory from specified address to an op code and its immediate data.
+	// Code that was already decoded comes from the decode cache.
 	// If the memory holds an invalid op code, the cpu hangs.
 	bool Fetch();
 
 	// Execute instruction from op code.
 	bool Exec();
 
+#ifdef DEBUG
+	bool CheckDoctorLog();
+#endif
+
+	// Dispatches the highest priority pending interrupt. Only called when one is pending and ime is set.
 	void InterruptHandler();
 
+#ifdef CALL_PROFILER
+	void ProfileCall();
+	void ProfileReturn();
+#endif
+
+	// Checks if the fused sequence in a decoded instruction can be used right now.
+	bool CanFuse(const DecodedInstr& decoded) const;
+
+	// Handler for a non-prefixed op code. nullptr for unused op codes.
+	static InstrFunc MainHandler(byte op);
+
 // --- Vars ---
 private:
 	Memory& _memory;
@@ -197,13 +470,61 @@ private:
 	// Next instruction to be executed.
 	InstrFunc _handler = nullptr;
 
+	DecodeCache _decodeCache;
+
+	bool _fusionEnabled = true;
+	std::array<u64, static_cast<std::size_t>(Fusion::COUNT)> _fusionCounts{};
+	std::bitset<256> _debugPages{};
+
+	BreakFunc _breakCheck = nullptr;
+	void* _breakOwner = nullptr;
+
+#ifdef CALL_PROFILER
+	CallProfiler* _callProfiler = nullptr;
+#endif
+
+	// If the handler from the last fetch is a fused sequence.
+	bool _isFused = false;
+
 	bool _isHalted = false;
 
+	// Mcycles the next update takes without running anything, while halted or in an idle loop.
+	u64 _skipCycles = 0;
+
+	// See SetQuietCycles.
+	u64 _quietCycles = 0;
+
+	bool _idleLoopsEnabled = true;
+	IdleLoopDetector _idleLoops;
+
+#ifdef OPCODE_PROFILER
+	OpcodeProfiler _profiler;
+#endif
+
+#ifdef DEBUG
+	DoctorLog* _doctorLog = nullptr;
+#endif
+
+#ifdef INSTR_TRACE
+	bool _tracing = false;
+#endif
+
 	// Interrupt enable flag
 	bool _ime = false;
 
 	// IME interrupt enable needs to happen one update apart from actual interrupt handling
 	bool _enablingIME = false;
+
+	friend class Recompiled;
+	std::unique_ptr<Recompiled> _recompiled;
+
+#ifdef JIT
+	friend class Jit;
+
+	std::unique_ptr<Jit> _jit;
+	bool _jitEnabled = true;
+	bool _jitValidation = false;
+#endif
 };
 
 /*
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Core.hpp"
+#include "Symbols.hpp"
+
+namespace gb {
+
+/*
+	Keeps a shadow of the call stack from every call, rst, interrupt dispatch, and return, to find out how many
+	mcycles each function takes on its own (exclusive) and together with everything it calls (inclusive).
+	Functions are told apart by bank and entry address, and named with the rom's rgbds symbols when there are any.
+
+	The real stack isn't always used the way call and ret use it. Frames are matched to returns by the sp their
+	return address was pushed to, so a ret that doesn't match any frame (push then ret to jump) is ignored, one that
+	matches a frame further down drops the frames above it (popping the return address and jumping away), and a
+	call that pushes at or above a frame's return address drops that frame too (the stack pointer being reset).
+*/
+class CallProfiler {
+public:
+	explicit CallProfiler(std::optional<SymbolTable> symbols);
+
+	inline const std::optional<SymbolTable>& Symbols() const { return _symbols; }
+
+	// The cpu calls these right after pc moved into or back out of a function. sp is where the return address is,
+	// and offset is how many mcycles of the current update have already passed.
+	void Call(u16 bank, u16 addr, u16 sp, u64 offset);
+	void Return(u16 sp, u64 offset);
+
+	// Called by the hardware once it has processed an update.
+	inline void Advance(u64 mCycles) { _now += mCycles; }
+
+	void Reset();
+
+	// Calls, inclusive, and exclusive mcycles of every function, most inclusive mcycles first.
+	// Functions that haven't returned yet are counted up to now.
+	void WriteText(std::ostream& out) const;
+
+	// Callgrind format, for KCachegrind and qcachegrind. One file per rom bank, so functions are grouped by bank.
+	void WriteCallgrind(std::ostream& out, std::string_view command) const;
+
+private:
+	// Bank << 16 | addr, with code before the first call as its own function.
+	using Key = u32;
+	static constexpr Key rootKey = ~0u;
+
+	static constexpr Key MakeKey(u16 bank, u16 addr) { return static_cast<Key>(bank) << 16 | addr; }
+
+	struct Frame {
+		Key key;
+		u32 sp;			// one past the top of the stack for the root, so every call is above it
+		u64 entered;
+		u64 children = 0;
+	};
+
+	struct Edge {
+		u64 calls = 0;
+		u64 inclusive = 0;
+	};
+
+	struct Function {
+		u64 calls = 0;
+		u64 inclusive = 0;	// only counted for the outermost of recursive calls
+		u64 exclusive = 0;
+		u32 active = 0;		// frames of it on the stack
+
+		std::unordered_map<Key, Edge> callees;
+	};
+
+	using Functions = std::unordered_map<Key, Function>;
+
+	// Adds the top frame's time up to now to its function and the frame under it, then drops it.
+	static void Pop(std::vector<Frame>& stack, Functions& functions, u64 now);
+
+	// Every function as if all of the frames still on the stack returned now.
+	Functions Snapshot() const;
+
+	std::string Name(Key key) const;
+
+private:
+	std::optional<SymbolTable> _symbols;
+
+	u64 _now = 0;
+	std::vector<Frame> _stack;
+	Functions _functions;
+};
+
+} // namespace gb
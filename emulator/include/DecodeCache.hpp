@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "Core.hpp"
+#include "Memory.hpp"
+
+namespace gb::cpu {
+
+class Context;
+
+// Sequences of instructions that can be run as a single handler (superinstructions).
+enum class Fusion : byte {
+	POLL,		// ldh a, [imm8]; cp/and imm8; jr z/nz, imm8 -- waiting on LY or STAT
+	DEC_JR,		// dec r8; jr nz, imm8 -- countdown loops
+	COPY,		// ld a, [hl+]; ld [de], a -- memory copies
+
+	COUNT
+};
+
+static constexpr std::array<std::string_view, static_cast<std::size_t>(Fusion::COUNT)> fusionNames = {
+	"ldh a, [n]; cp/and n; jr z/nz",
+	"dec r8; jr nz",
+	"ld a, [hl+]; ld [de], a"
+};
+
+// An instruction that has already been fetched and decoded.
+struct DecodedInstr {
+	void(*handler)(Context&, Memory&) = nullptr;	// null if nothing has been decoded yet
+	void(*fused)(Context&, Memory&) = nullptr;		// handler for the whole sequence starting here, if any
+	u32 version = 0;								// code page version when decoded. always 0 for rom
+	std::array<byte, 4> imm{};						// immediate bytes following the op code. for fused
+													// sequences, the immediates of every instruction in order
+	byte ir = 0;
+	byte length = 0;
+	byte fusedLength = 0;
+	Fusion fusion = Fusion::COUNT;
+};
+
+/*
+	Caches decoded instructions so running the same code doesn't go through Memory::Read again.
+	Rom code is keyed by its physical address (bank, pc), so switching banks never returns a stale entry.
+	Wram and hram code is checked against the version of its code page, which changes on every write.
+	Instructions that cross a rom bank or code page aren't cached.
+*/
+class DecodeCache {
+public:
+	explicit DecodeCache(std::size_t romSize);
+
+	// Finds the slot for the instruction at addr and the version it needs to be valid.
+	// Returns nullptr for code that can't be cached (vram, cartridge ram, io, during dma...).
+	inline std::tuple<DecodedInstr*, u32> Slot(const Memory& mem, u16 addr);
+
+	// Checks if an instruction of the given length at addr fits in a single slot.
+	bool CanStore(const Memory& mem, u16 addr, byte length) const;
+
+private:
+	static constexpr u32 romPageSize = 256;
+	using RomPage = std::array<DecodedInstr, romPageSize>;
+
+	// Allocated on first use, most of a rom is usually data.
+	std::vector<std::unique_ptr<RomPage>> _romPages;
+	std::vector<DecodedInstr> _ram;
+	std::size_t _romSize;
+};
+
+inline std::tuple<DecodedInstr*, u32> DecodeCache::Slot(const Memory& mem, u16 addr) {
+	// the cpu can only read hram during dma, everything else returns garbage
+	if (mem.IsDMAActive())
+		return { nullptr, 0 };
+
+#if defined(DEBUG) && defined(TESTS)
+	// all of flat ram can change between tests, rom included
+	if (mem.IsFlat()) [[unlikely]]
+		return { nullptr, 0 };
+#endif
+
+	if (addr < romNEnd) {
+		const u32 physicalAddr = mem.RomPhysicalAddr(addr);
+		if (physicalAddr >= _romSize) [[unlikely]]
+			return { nullptr, 0 };
+
+		auto& page = _romPages[physicalAddr / romPageSize];
+		if (!page) [[unlikely]]
+			page = std::make_unique<RomPage>();
+
+		return { &(*page)[physicalAddr % romPageSize], 0 };
+	}
+
+	const u16 index = Memory::CodeRamIndex(addr);
+	if (index == Memory::noCodeRamIndex)
+		return { nullptr, 0 };
+
+	return { &_ram[index], mem.CodePageVersion(index) };
+}
+
+} // namespace gb::cpu
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Core.hpp"
+#include "Memory.hpp"
+
+namespace gb::disasm {
+
+struct Line {
+	u16 addr;
+	byte length;				// in bytes, including the op code
+	std::array<byte, 3> bytes;	// only the first length are part of the instruction
+	std::string text;			// in rgbds syntax, like "ldh a, [$FF44]"
+};
+
+// Disassembles the instruction starting with bytes[0]. addr is only used to work out where jr jumps to.
+Line Disassemble(u16 addr, const std::array<byte, 3>& bytes);
+
+/*
+	Disassembly of whole rom banks, wram, and hram, so debugging tools don't have to disassemble anything
+	every frame. Every area is disassembled in one linear sweep from its start.
+	Rom never changes, so each bank is only disassembled the first time it's asked for. Wram and hram are
+	checked for writes through the code page versions memory keeps for the cpu's decode cache, and only
+	redone from the first written page until the sweep lines up with the old instructions after the last one.
+	Reads memory without locking, the same as the vram viewer, so an area can be a frame behind.
+*/
+class Cache {
+public:
+	explicit Cache(const Memory& mem);
+
+	// At the addresses the bank gets mapped to, $0000 for bank 0 and $4000 for the rest.
+	// Empty if the rom doesn't have the bank.
+	const std::vector<Line>& RomBank(u16 bank);
+
+	const std::vector<Line>& Wram();
+	const std::vector<Line>& Hram();
+
+	inline u16 RomBanks() const { return static_cast<u16>(_mem.RomSize() / romBankSize); }
+
+	// Index of the line addr is in, or the last one before it.
+	static std::size_t Find(const std::vector<Line>& lines, u16 addr);
+
+private:
+	struct RamArea {
+		u16 start;
+		u16 end;
+		std::vector<Line> lines{};
+		std::vector<u32> pageVersions{};
+	};
+
+	void Refresh(RamArea& area);
+
+private:
+	const Memory& _mem;
+
+	std::unordered_map<u16, std::vector<Line>> _romBanks;
+
+	RamArea _wram{ ramCartEnd, ramNEnd };
+	RamArea _hram{ ioEnd, hramEnd };
+};
+
+} // namespace gb::disasm
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifdef DEBUG
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Core.hpp"
+
+namespace gb::cpu {
+
+/*
+	Compares the cpu against a gameboy-doctor log while it runs, instead of dumping every instruction and
+	diffing the logs afterwards. https://github.com/robert-koch/gameboy-doctor
+	Each line of the log is the state before an instruction runs, in the same format as Context::ShortDump.
+	Stops at the first line that doesn't match and keeps the lines before it to show what led up to it.
+*/
+class DoctorLog {
+public:
+	enum class Status {
+		RUNNING,
+		MATCHED,	// every line of the log matched
+		DIVERGED,
+		NO_LOG		// the log couldn't be opened
+	};
+
+	explicit DoctorLog(const std::filesystem::path& logPath, std::size_t contextLines = 8);
+
+	// Checks the state before an instruction against the next line of the log.
+	// Returns false once the cpu shouldn't keep going, either because it diverged or the log ended.
+	bool Check(const std::array<byte, 12>& regs, const std::array<byte, 4>& pcMem);
+
+	inline Status GetStatus() const { return _status; }
+	inline u64 MatchedLines() const { return _lineNum; }
+
+	// What happened. On a divergence, the lines before it, which fields are different, and what the log does next.
+	void PrintReport() const;
+
+	// A line in the same format as the log. regs is a f b c d e h l, then sp and pc big endian.
+	static std::string FormatLine(const std::array<byte, 12>& regs, const std::array<byte, 4>& pcMem);
+
+private:
+	std::ifstream _log;
+	Status _status = Status::RUNNING;
+
+	// Lines of the log that matched so far, and the last few of them. Lines are read into _line.
+	u64 _lineNum = 0;
+	std::string _line;
+	std::vector<std::string> _context;
+
+	// Only set once the cpu diverged.
+	std::string _actual;
+	std::vector<std::string> _after;
+};
+
+} // namespace gb::cpu
+#endif // DEBUG
@@ -1,20 +1,61 @@
 #pragma once
 
+#include <atomic>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
 
 #include "Core.hpp"
 #include "HardwareRegisters.hpp"
 #include "Memory.hpp"
 #include "CPU.hpp"
 #include "PPU.hpp"
+#include "RomAnalysis.hpp"
 #include "Screen.hpp"
+#include "Symbols.hpp"
+
+#ifdef SAMPLING_PROFILER
+#include "SamplingProfiler.hpp"
+#endif
+
+#ifdef CALL_PROFILER
+#include "CallProfiler.hpp"
+#endif
+
+#ifdef INSTR_TRACE
+#include "Trace.hpp"
+#endif
 
 namespace gb {
 
+// Pauses the emulator before the instruction at addr runs.
+struct Breakpoint {
+	static constexpr u16 anyBank = 0xFFFF;
+
+	using Condition = std::function<bool(const cpu::Context&)>;
+
+	u16 addr;
+	u16 bank = anyBank;		// numbered the same way rgbds does
+
+	// Only pauses when this returns true, if there is one. Called on the emulator thread with the cpu as it is
+	// before the instruction runs.
+	Condition condition{};
+};
+
 class Emu {
 public:
 	explicit Emu(const std::filesystem::path& romPath);
 
+	// No window, for running from tests and tools. Run can't be used, and Update only updates the core.
+	struct Headless {};
+	Emu(const std::filesystem::path& romPath, Headless);
+
 	// For stepping through instead of running
 	void Start() { _isRunning = true; _isMultithreaded = false; }
 
@@ -25,12 +66,104 @@ public:
 	// Is public so the cpu can be easily stepped through from outside the class.
 	[[nodiscard]] bool Update();
 
+	// Runs code gbrecomp generated for this rom instead of the interpreter where it can.
+	// Returns false if the code was generated from a different rom.
+	inline bool SetRecompiled(const cpu::RecompiledRom& rom) { return _cpuCtx.SetRecompiled(rom); }
+
+	// Skipping through busy waiting loops can be turned off to see how much time it saves.
+	inline void SetIdleLoops(bool enabled) { _cpuCtx.SetIdleLoops(enabled); }
+	inline const cpu::IdleLoopStats& GetIdleLoopStats() const { return _cpuCtx.GetIdleLoopStats(); }
+
+	// Accesses to vram, oam, and io partway through an instruction see the hardware as of the mcycle they
+	// happen on, instead of as of the start of the instruction. Can be turned off to see what it costs.
+	void SetCatchUp(bool enabled);
+
+#ifdef SAMPLING_PROFILER
+	// Records where the cpu is every interval mcycles. Symbols are read from the rgbds .sym file next to the
+	// rom if there is one. Starting again throws away the samples taken so far.
+	void StartSampling(u64 interval = SamplingProfiler::defaultInterval);
+	void StopSampling();
+
+	// nullptr if sampling was never started.
+	inline SamplingProfiler* GetSampler() { return _sampler.get(); }
+#endif
+
+#ifdef CALL_PROFILER
+	// Keeps a shadow call stack to add up the mcycles spent in and under every function. Symbols come from the
+	// .sym file the same way as for sampling. Starting again throws away what was recorded so far.
+	void StartCallProfiling();
+	void StopCallProfiling();
+
+	// nullptr if call profiling was never started.
+	inline CallProfiler* GetCallProfiler() { return _callProfiler.get(); }
+#endif
+
+	// Can be called from any thread. The emulator thread stops before its next instruction, and the screen keeps going.
+	inline void Pause() { _isPaused = true; }
+	void Resume();
+	inline bool IsPaused() const { return _isPaused; }
+
+	// Breakpoints can be changed from any thread, and the emulator thread picks the changes up before its next
+	// update. Hitting one pauses the emulator, and resuming runs the instruction it stopped at.
+	// Nothing is checked while there are none, and only instructions in the same 256 byte page as one after.
+	u32 AddBreakpoint(Breakpoint breakpoint);
+
+	// At a label from the rgbds .sym file next to the rom, in its bank. nullopt if there's no such label.
+	std::optional<u32> AddBreakpoint(std::string_view label, Breakpoint::Condition condition = {});
+
+	void RemoveBreakpoint(u32 id);
+	void ClearBreakpoints();
+
+	static constexpr u32 noBreakpoint = 0;
+
+	// The breakpoint the emulator last paused at, or noBreakpoint.
+	inline u32 LastBreakpoint() const { return _lastBreakpoint; }
+
+	// Finds the rom's code and basic blocks on other threads, sharing the result with every other Emu running the
+	// same rom. Never waits for it, GetRomAnalysis is nullptr until it's done.
+	void StartRomAnalysis();
+	rom::SharedAnalysis GetRomAnalysis() const;
+
+#ifdef INSTR_TRACE
+	// Records the state before every instruction into a binary trace, which gbtrace turns back into
+	// ShortDump text. Returns false if the file couldn't be created. Starting again closes the last trace.
+	bool StartTrace(const std::filesystem::path& tracePath);
+	void StopTrace();
+#endif
+
+#ifdef OPCODE_PROFILER
+	inline cpu::OpcodeProfiler& GetOpcodeProfiler() { return _cpuCtx.GetProfiler(); }
+#endif
+
+#ifdef JIT
+	// Falls back to the interpreter when disabled. Validation runs both and compares them.
+	inline void SetJit(bool enabled) { _cpuCtx.SetJit(enabled); }
+	inline void SetJitValidation(bool enabled) { _cpuCtx.SetJitValidation(enabled); }
+#endif
+
 #if defined(DEBUG) && defined(TESTS)
 	constexpr auto&& DebugMemory() noexcept { return _memory; }
+	constexpr auto&& DebugCpu() noexcept { return _cpuCtx; }
 	constexpr void SetDump(bool longDump, bool shortDump = false) noexcept { 
 		_cpuCtx.longDump = longDump;
 		_cpuCtx.shortDump = shortDump;
 	}
+
+	// Checks every instruction against a gameboy-doctor log instead of dumping it. The log has every
+	// iteration of idle loops in it, so they aren't skipped.
+	inline void SetDoctorLog(const std::filesystem::path& logPath) {
+		_doctorLog = std::make_unique<cpu::DoctorLog>(logPath);
+		_cpuCtx.SetDoctorLog(_doctorLog.get());
+		_cpuCtx.SetIdleLoops(false);
+	}
+
+	inline const cpu::DoctorLog& GetDoctorLog() const { return *_doctorLog; }
+
+	// Runs the cpu and hardware for one update without touching the screen. Used for benchmarks.
+	[[nodiscard]] bool DebugCoreUpdate() { return CoreUpdate(); }
+
+	// Total mcycles the hardware has processed since starting.
+	constexpr u64 DebugCycles() const noexcept { return _cycles; }
 #endif
 private:
 	using Clock = std::chrono::high_resolution_clock;
@@ -39,26 +172,143 @@ private:
 	using TargetSpeed = std::chrono::duration<double, std::ratio<1, 60>>;
 	static constexpr TargetSpeed oneFrame = TargetSpeed{ 1 };
 
+	// How many mcycles the cpu runs before returning to the update loop. One frame.
+	static constexpr u64 cpuBudget = 70224 / 4;
+
 private:
 	bool CoreUpdate();
 	bool ScreenUpdate();
 
+	// Runs the cpu for one update, letting it catch the hardware up partway through.
+	bool StepCpu();
+
 	bool ProcessCycles(u64 mCycles);
+	void TickHardware(u64 mCycles);
+
+	// TickHardware, skipping through whatever's left of the quiet cycles first.
+	void AdvanceHardware(u64 mCycles);
+
+	// Mcycles the timer and ppu can run for without requesting an interrupt or changing anything else but counters.
+	// With countTima, tima changing counts too.
+	u64 QuietCycles(bool countTima = false) const;
+
+	// QuietCycles, or 0 if something needs the hardware ticked and synced after every instruction anyway.
+	u64 DeferrableCycles() const;
+
+	// Mcycles a halted cpu can skip. The ppu can change modes and lines in the meantime, since that can't be
+	// seen until something wakes the cpu up.
+	u64 HaltedCycles() const;
+
+	// Lets the cpu skip the iterations of an idle loop that nothing will change the outcome of.
+	void SkipIdleLoop(const cpu::IdleIteration& iteration);
 	void LimitSpeed();
 
+	// Bank of the code at the pc, numbered the same way rgbds does.
+	u16 PcBank() const;
+
+#ifdef SAMPLING_PROFILER
+	void TakeSample();
+#endif
+
+#ifdef INSTR_TRACE
+	void TraceInstr();
+#endif
+
+	// Passed to the cpu so hardware is kept in sync after every instruction, or every few when the cpu runs by itself.
+	static cpu::Context::SyncResult SyncHardware(void* emu, u64 mCycles);
+
+	// Gives the cpu the breakpoints added since the last update.
+	void ApplyBreakpoints();
+
+	// Passed to the cpu while there are breakpoints.
+	static bool CheckBreakpoints(void* emu);
+
+	// Passed to memory so the hardware catches up to the cpu before it's touched partway through an instruction.
+	static void CatchUpHardware(void* emu);
+
+#ifdef DEBUG // TODO: REMOVE
+	void DebugSerial();
+#endif
+
 private:
 	Time _frameStart;
 
+	std::filesystem::path _romPath;
+
 	Timer _timer;
 	Memory _memory;
 
 	cpu::Context _cpuCtx;
 	ppu::GContext _ppuCtx;
 
-	Screen _screen{};
+	// nullptr when headless.
+	std::unique_ptr<Screen> _screen;
 
 	bool _isRunning = false;
-	bool _isPaused = false;
+	std::atomic<bool> _isPaused = false;
+
+	// Mcycles the cpu was told to skip while halted or in an idle loop. Nothing happens in them, so they're
+	// processed all at once.
+	u64 _skipCycles = 0;
+
+	// Mcycles processed since starting.
+	u64 _cycles = 0;
+
+	// Mcycles of the cpu's current update the hardware has already been caught up to.
+	u64 _caughtUp = 0;
+
+	// Mcycles from the last sync that only move the hardware's counters, unless the cpu touches it first.
+	// Given to the cpu so it can run that long without syncing, and skipped through instead of ticked.
+	u64 _quietCycles = 0;
+
+	// The last identical iteration of an idle loop, when it ended, and how many quiet cycles there were then.
+	cpu::IdleIteration _lastIdleIteration{};
+	u64 _lastIdleIterationEnd = 0;
+	u64 _lastIdleQuiet = 0;
+
+#ifdef SAMPLING_PROFILER
+	static constexpr u64 noSample = std::numeric_limits<u64>::max();
+
+	// Kept after stopping so the samples can still be read.
+	std::unique_ptr<SamplingProfiler> _sampler;
+	u64 _nextSample = noSample;
+#endif
+
+#ifdef CALL_PROFILER
+	// Also kept after stopping.
+	std::unique_ptr<CallProfiler> _callProfiler;
+	bool _callProfiling = false;
+#endif
+
+#ifdef INSTR_TRACE
+	std::unique_ptr<TraceWriter> _trace;
+#endif
+
+	// Invalid until StartRomAnalysis. Destroying the last copy waits for the analysis to finish.
+	std::shared_future<rom::SharedAnalysis> _romAnalysis;
+
+	struct IdBreakpoint {
+		u32 id;
+		Breakpoint breakpoint;
+	};
+
+	// Changed by any thread while holding the mutex.
+	std::mutex _breakpointMutex;
+	std::vector<IdBreakpoint> _breakpointEdits;
+	u32 _nextBreakpointId = noBreakpoint + 1;
+	std::optional<SymbolTable> _breakpointSymbols;
+	std::atomic<bool> _breakpointsChanged = false;
+
+	// Only used by the emulator thread. Sorted by address.
+	std::vector<IdBreakpoint> _breakpoints;
+
+	// When the emulator last paused at a breakpoint.
+	u64 _breakCycle = std::numeric_limits<u64>::max();
+	std::atomic<u32> _lastBreakpoint = noBreakpoint;
+
+#if defined(DEBUG) && defined(TESTS)
+	std::unique_ptr<cpu::DoctorLog> _doctorLog;
+#endif
 
 	static inline bool _isMultithreaded = false;
 };
@@ -22,6 +22,15 @@ BITFIELD_UNION_BYTE(InterruptFlags, flags,
 	byte _ : 3; // unused
 );
 
+// Bits of the if and ie registers. Lower bits have higher priority.
+enum class Interrupt : byte {
+	VBLANK = 1 << 0,
+	LCD = 1 << 1,
+	TIMER = 1 << 2,
+	SERIAL = 1 << 3,
+	JOYPAD = 1 << 4
+};
+
 BITFIELD_UNION_BYTE(LCDControl, flags,
 	byte BGWindowEnable : 1;
 	byte OBJEnable : 1;
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <optional>
+
+#include "Core.hpp"
+
+namespace gb {
+
+class Memory;
+
+namespace cpu {
+
+// How much time was saved by skipping through busy waiting loops.
+struct IdleLoopStats {
+	u64 detected = 0;			// times the cpu was confirmed to be in an idle loop
+	u64 skips = 0;				// times the hardware skipped ahead while in one
+	u64 skippedIterations = 0;
+	u64 skippedCycles = 0;
+};
+
+// An iteration of an idle loop that left the cpu exactly as it found it.
+struct IdleIteration {
+	u16 head = 0;			// start of the loop, where the pc is now
+	u64 count = 0;			// identical iterations in a row so far
+	bool readsTima = false;	// tima changes more often than anything else an idle loop can read
+};
+
+/*
+	Finds loops that busy wait on the hardware instead of halting, like ldh a, [$44]; cp n; jr nz, or
+	waiting for an interrupt handler to set a flag in ram.
+	A loop is idle if it's straight line code ending in a jump back to its start, it only writes a and f,
+	and everything it reads can only be changed by the ppu, the timer, or an interrupt.
+	Once an iteration leaves the cpu exactly as it found it, every iteration after it will do the same
+	until something changes, so the hardware can skip as many of them as it knows nothing will change for.
+*/
+class IdleLoopDetector {
+public:
+	// Everything in the cpu an iteration could change.
+	struct State {
+		u16 af, bc, de, hl, sp;
+		bool ime, enablingIME;
+
+		bool operator==(const State&) const = default;
+	};
+
+	static constexpr u16 maxLoopBytes = 16;
+
+	// Called by jumps to an earlier address, once the pc is at the start of the loop.
+	// loopEnd is the address after the jump instruction.
+	void JumpedBack(Memory& mem, const State& state, u16 head, u16 loopEnd);
+
+	// If TakeIteration has one to return.
+	inline bool HasIteration() const { return _hasIteration; }
+
+	// The iteration that just finished if it was an identical iteration of an idle loop. Only returned once.
+	inline std::optional<IdleIteration> TakeIteration() {
+		if (!_hasIteration) [[likely]]
+			return std::nullopt;
+
+		_hasIteration = false;
+		return _iteration;
+	}
+
+	inline void CountSkip(u64 iterations, u64 mCycles) {
+		++_stats.skips;
+		_stats.skippedIterations += iterations;
+		_stats.skippedCycles += mCycles;
+	}
+
+	inline const IdleLoopStats& GetStats() const { return _stats; }
+
+private:
+	// Checks every instruction in [head, loopEnd). Returns if the loop reads tima, or nothing if it isn't idle.
+	static std::optional<bool> Analyze(Memory& mem, const State& state, u16 head, u16 loopEnd);
+
+private:
+	// The last loop that was jumped back to, and the cpu when it was.
+	u16 _head = 0;
+	State _state{};
+
+	// Only analyzed once the loop repeats itself.
+	bool _analyzed = false;
+	std::optional<bool> _readsTima;
+
+	IdleIteration _iteration{};
+	bool _hasIteration = false;
+
+	IdleLoopStats _stats{};
+};
+
+} // namespace cpu
+} // namespace gb
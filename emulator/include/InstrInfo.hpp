@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+
+#include "Core.hpp"
+
+namespace gb::cpu {
+
+// How an instruction changes the program counter.
+enum class Flow : byte {
+	NEXT,			// falls through to the next instruction
+	JUMP,			// jp imm16, jr imm8
+	COND_JUMP,		// jp cc imm16, jr cc imm8
+	JUMP_INDIRECT,	// jp hl
+	CALL,			// call imm16, rst
+	COND_CALL,		// call cc imm16
+	RET,			// ret, reti
+	COND_RET,		// ret cc
+	HALT,
+	STOP,
+	INVALID			// unused op code, hangs the cpu
+};
+
+// Static information about a non-prefixed op code. cb prefixed instructions are all 2 bytes long
+// and fall through.
+struct InstrInfo {
+	byte length;	// in bytes, including the op code
+	Flow flow;
+};
+
+constexpr InstrInfo MakeInstrInfo(byte op) {
+	switch (op) {
+	// unused op codes
+	case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB:
+	case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+		return { 1, Flow::INVALID };
+
+	case 0xC3: return { 3, Flow::JUMP };		// jp imm16
+	case 0x18: return { 2, Flow::JUMP };		// jr imm8
+	case 0xE9: return { 1, Flow::JUMP_INDIRECT };	// jp hl
+	case 0xCD: return { 3, Flow::CALL };		// call imm16
+	case 0xC9: case 0xD9: return { 1, Flow::RET };	// ret, reti
+	case 0x76: return { 1, Flow::HALT };
+	case 0x10: return { 2, Flow::STOP };
+
+	case 0x08: case 0xEA: case 0xFA:			// ld [imm16], sp; ld [imm16], a; ld a, [imm16]
+		return { 3, Flow::NEXT };
+	case 0xCB: case 0xE0: case 0xF0:			// cb prefix; ldh [imm8], a; ldh a, [imm8]
+	case 0xE8: case 0xF8:						// add sp, imm8; ld hl, sp + imm8
+		return { 2, Flow::NEXT };
+	default:
+		break;
+	}
+
+	if ((op & 0b11'00'1111) == 0b00'00'0001)	// ld r16, imm16
+		return { 3, Flow::NEXT };
+	if ((op & 0b111'00'111) == 0b110'00'010)	// jp cc, imm16
+		return { 3, Flow::COND_JUMP };
+	if ((op & 0b111'00'111) == 0b001'00'000)	// jr cc, imm8
+		return { 2, Flow::COND_JUMP };
+	if ((op & 0b111'00'111) == 0b110'00'100)	// call cc, imm16
+		return { 3, Flow::COND_CALL };
+	if ((op & 0b111'00'111) == 0b110'00'000)	// ret cc
+		return { 1, Flow::COND_RET };
+	if ((op & 0b11'000'111) == 0b11'000'111)	// rst tgt3
+		return { 1, Flow::CALL };
+	if ((op & 0b11'000'111) == 0b00'000'110)	// ld r8, imm8
+		return { 2, Flow::NEXT };
+	if ((op & 0b11'000'111) == 0b11'000'110)	// alu a, imm8
+		return { 2, Flow::NEXT };
+
+	return { 1, Flow::NEXT };
+}
+
+static constexpr std::array<InstrInfo, 256> instrInfo = [] {
+	std::array<InstrInfo, 256> info{};
+
+	for (std::size_t op = 0; op < info.size(); ++op)
+		info[op] = MakeInstrInfo(static_cast<byte>(op));
+
+	return info;
+}();
+
+static_assert(instrInfo[0x01].length == 3 && instrInfo[0x3E].length == 2 && instrInfo[0x7E].length == 1);
+static_assert(instrInfo[0xFF].flow == Flow::CALL && instrInfo[0xC0].flow == Flow::COND_RET);
+
+// True if execution can't simply continue with the next instruction in memory.
+constexpr bool EndsBlock(Flow flow) {
+	return flow != Flow::NEXT;
+}
+
+} // namespace gb::cpu
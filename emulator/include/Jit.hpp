@@ -0,0 +1,184 @@
+#pragma once
+
+#ifdef JIT
+
+#include <array>
+#include <deque>
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+#include "Core.hpp"
+#include "CPU.hpp"
+#include "Memory.hpp"
+
+namespace gb::cpu {
+
+/*
+	Dynamic recompiler for x86-64 linux.
+	Translates basic blocks of SM83 code into native code. Register loads, 8-bit alu ops on registers and
+	immediates, and jp/jr are translated inline. Everything else calls the same specialized handlers the
+	interpreter uses, with the fetch, decode, and dispatch work done ahead of time.
+
+	Like recompiled code, blocks add up mcycles and only sync the hardware when it could be seen changing
+	(see Context::CanDeferSync) or at the end of the run. Handlers still go through Retire after every
+	instruction. Inline instructions only compare the cycles they added up against _inlineLimit, which Retire
+	sets to 0 whenever the next instruction has to go through it too.
+
+	Rom blocks are keyed by their physical address and linked directly to each other. A link into a
+	switchable rom window checks the bank before jumping.
+	Wram and hram blocks never cross a code page and are checked against its version when entered and
+	after every handler, so writing to code that was translated throws the translation away.
+*/
+class Jit {
+public:
+	Jit(Context& ctx, Memory& mem);
+	~Jit();
+
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+
+	// Same contract as Context::Run.
+	bool Run(u64 cycleBudget, Context::SyncFunc sync, void* owner);
+
+	// Runs every block a second time through Context::Update and compares the results.
+	// The hardware only catches up after each block while validating.
+	inline void SetValidation(bool enabled) { _validate = enabled; }
+
+	inline u64 GetBlocksCompiled() const { return _blocksCompiled; }
+
+private:
+	// A static successor of a block that can be linked straight to the block it jumps to.
+	struct Exit {
+		byte* jump = nullptr;		// rel32 of the jmp to patch
+		byte* bankCheck = nullptr;	// imm32 of the rom bank check, if the target is in rom
+		u16 target = 0;
+		bool linked = false;
+	};
+
+	struct Block {
+		byte* code = nullptr;
+		u16 pc = 0;
+		u16 codeRamIndex = Memory::noCodeRamIndex;	// for wram and hram blocks
+		u32 version = 0;
+		u32 instrCount = 0;
+	};
+
+	// Called from translated code after every handler, and after inline instructions that went past
+	// _inlineLimit. Returns true to leave the block.
+	static bool Retire(Jit* jit);
+
+	// Cycles inline instructions can add up before the next one has to call Retire.
+	u64 InlineLimit() const;
+
+	// Syncs the hardware for the cycles Retire put off. Returns false if the sync said to stop.
+	bool SyncDeferred();
+
+	// Context::JumpedBack for inline jumps. Returns true if it finished an idle loop iteration.
+	static bool JumpedBack(Context* ctx, u16 loopEnd);
+
+	// Runs a single instruction through the interpreter.
+	bool Step();
+
+	// Finds or translates the block starting at the current pc. Returns nullptr for code that can't
+	// be translated.
+	Block* Lookup();
+	Block* Compile(u16 pc, u32 key, u16 codeRamIndex);
+
+	// Points an exit straight at the block that was just entered through it, if it's safe to.
+	void Link(Exit& exit, const Block& target);
+
+	// Throws away every translation once the code buffer is full.
+	void Flush();
+
+	// The code buffer is either writable or executable, never both. Switched only when it has to be.
+	void SetExecutable(bool executable);
+
+	// Runs a block with lockstep validation and then lets the hardware catch up.
+	bool RunValidated(const Block& block);
+
+	// Writes raw machine code into the code buffer.
+	void Emit(std::initializer_list<byte> bytes);
+	void Emit16(u16 val);
+	void Emit32(u32 val);
+	void Emit64(u64 val);
+	void EmitAddress(const void* ptr);
+
+	// If an op code is translated inline instead of calling its handler.
+	static bool CanInline(byte op);
+
+	// Translates an inline instruction. next is the address after it. Returns the rel32 of a jump that
+	// has to go to Retire instead of the usual check, or nullptr.
+	byte* EmitInline(byte op, u16 imm16, u16 next);
+
+	// Emits a jump with an empty rel32 and returns where the rel32 is.
+	byte* EmitJump(std::initializer_list<byte> op);
+	static void PatchJump(byte* rel32, const byte* target);
+
+private:
+	Context& _ctx;
+	Memory& _mem;
+
+	// Every translation. Read and write while emitting or patching, read and execute while running.
+	byte* _codeBegin = nullptr;
+	byte* _codeEnd = nullptr;
+	byte* _emit = nullptr;
+	bool _executable = false;
+
+	// Shared entry and exit stubs at the start of the code buffer.
+	using EnterFunc = void(*)(Context*, Memory*, Jit*, const byte* code);
+	EnterFunc _enter = nullptr;
+	byte* _leave = nullptr;
+
+	// Rom blocks are keyed by physical address, wram and hram blocks by their code ram index with the top bit set.
+	std::unordered_map<u32, Block> _blocks;
+	std::deque<Exit> _exits;
+
+	// The exit translated code left through, if it can be linked.
+	Exit* _lastExit = nullptr;
+
+	// Offsets of the fields translated code touches.
+	u32 _irOffset = 0;
+	u32 _immOffset = 0;
+	u32 _pcOffset = 0;
+	u32 _mCyclesOffset = 0;
+	u32 _lastExitOffset = 0;
+	u32 _inlineLimitOffset = 0;
+	u32 _fOffset = 0;
+	std::array<u32, 8> _r8Offsets{};	// b, c, d, e, h, l, [hl], a like the op code bits, [hl] is unused
+
+	// Flags for the inline alu ops, already packed like Context::Flags is stored.
+	// add, sub, inc, and dec are indexed by what lahf gives after the x86 version of the op, since its zero,
+	// half carry, and carry flags mean the same thing. The logic ops are indexed by the result.
+	struct FlagTables {
+		std::array<byte, 256> add;
+		std::array<byte, 256> sub;
+		std::array<byte, 256> inc;		// without the carry, it's kept
+		std::array<byte, 256> dec;
+		std::array<byte, 256> logic;	// or and xor
+		std::array<byte, 256> andLogic;
+	};
+	FlagTables _flagTables{};
+	byte _zeroMask = 0;
+	byte _carryMask = 0;
+	byte _carryBit = 0;
+
+	// State of the current Run for Retire.
+	Context::SyncFunc _sync = nullptr;
+	void* _owner = nullptr;
+	u64 _cyclesRan = 0;
+	u64 _cycleBudget = 0;
+	std::array<u32, 2> _entryBanks{};
+	u32 _instrsRan = 0;
+	u64 _inlineLimit = 0;
+	Context::SyncResult _synced = Context::SyncResult::CONTINUE;
+
+	bool _validate = false;
+	std::vector<u64> _validateCycles;
+
+	u64 _blocksCompiled = 0;
+};
+
+} // namespace gb::cpu
+
+#endif // JIT
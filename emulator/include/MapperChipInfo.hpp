@@ -67,7 +67,7 @@ class NoMBC : public IMapperInfo {
 public:
 	explicit NoMBC(byte ramSizeCode = 0);
 
-	byte Bank(u16 addr) const override { return 0; }
+	byte Bank(u16 addr) const override { return addr < rom0End ? 0 : 1; }
 
 	OptByteRef ReadRom(Memory& mem, u16 addr) override;
 
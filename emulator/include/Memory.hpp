@@ -3,6 +3,7 @@
 #include <array>
 #include <tuple>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "Core.hpp"
@@ -16,6 +17,13 @@ namespace gb {
 
 class Memory {
 public:
+	// Writes to wram and hram are tracked in pages of this many bytes so cached code can be invalidated.
+	static constexpr u16 codePageSize = 16;
+
+	// wram followed by hram, the only writable places code can be cached from.
+	static constexpr u16 codeRamSize = 0x2000 + 0x80;
+	static constexpr u16 noCodeRamIndex = 0xFFFF;
+
 	// TODO: have hwregs live in memory and make just the timer live in emu?
 	explicit Memory(rom::RomData&& data, Timer& timerRegsRef);
 
@@ -25,20 +33,134 @@ public:
 	byte& Read(u16 addr);
 
 	// Used by mapper chips to avoid infinite indirect recursion.
-	inline byte& ReadRom(u16 physicalAddr) { return _romData[physicalAddr]; }
+	// Banks past the end of the rom wrap around, the same as the unused bank bits being ignored.
+	inline byte& ReadRom(u32 physicalAddr) { return _romData[physicalAddr & _romAddrMask]; }
+
+	inline std::size_t RomSize() const { return _romData.size(); }
+	inline const rom::RomData& GetRom() const { return _romData; }
+
+	// Reads without any side effects, for tools like the disassembler.
+	inline byte PeekRom(u32 physicalAddr) const { return _romData[physicalAddr & _romAddrMask]; }
+	inline byte PeekCodeRam(u16 codeRamIndex) const {
+		return codeRamIndex < 0x2000 ? _ramInternal[codeRamIndex] : _hram[codeRamIndex - 0x2000];
+	}
+
+	// Translates addr in [$0000, $7FFF] into an index into the rom with the currently mapped banks.
+	inline u32 RomPhysicalAddr(u16 addr) const { return _romBankBase[addr / romBankSize] | (addr & (romBankSize - 1)); }
+
+	// Bank of the code at addr, numbered the same way rgbds does.
+	inline u16 CodeBank(u16 addr) const {
+		if (addr < romNEnd)
+			return static_cast<u16>(RomPhysicalAddr(addr) / romBankSize);
+		else if (addr >= ram0End && addr < ramNEnd)
+			return 1;
+
+		return 0;
+	}
+
+	// Physical rom address of the start of [$0000, $3FFF] and [$4000, $7FFF].
+	inline const std::array<u32, 2>& RomBankBases() const { return _romBankBase; }
+
+	// Translates a wram, echo ram, or hram address into an index in [0, codeRamSize).
+	// Returns noCodeRamIndex for everything else.
+	static constexpr u16 CodeRamIndex(u16 addr) {
+		if (addr >= ramCartEnd && addr < ramNEnd)
+			return addr - 0xC000;
+		else if (addr >= ramNEnd && addr < echoRamEnd)
+			return addr - 0xE000;
+		else if (addr >= ioEnd && addr < hramEnd)
+			return 0x2000 + (addr - ioEnd);
+
+		return noCodeRamIndex;
+	}
+
+	// Changes every time a byte in the code page is written to.
+	inline u32 CodePageVersion(u16 codeRamIndex) const { return _codePageVersions[codeRamIndex / codePageSize]; }
+	inline const u32* CodePageVersionPtr(u16 codeRamIndex) const { return &_codePageVersions[codeRamIndex / codePageSize]; }
+
+#ifdef JIT
+	struct WriteRecord {
+		u16 addr;
+		byte oldVal;
+		byte newVal;
+	};
+
+	// Every write gets recorded into the journal while one is set. Used to validate the jit.
+	inline void SetWriteJournal(std::vector<WriteRecord>* journal) { _writeJournal = journal; }
+#endif
 
 	void Write(u16 addr, byte val);
 
+	// Called before anything touches vram, oam, or io, so the hardware can catch up to a cpu that's partway
+	// through an instruction first. Nothing else the cpu can touch changes on its own.
+	struct CatchUp {
+		void (*func)(void* owner) = nullptr;
+		void* owner = nullptr;
+	};
+
+	inline void SetCatchUp(CatchUp catchUp) {
+		_catchUp = catchUp;
+		_catchUpArmed = _cpuAhead && _catchUp.func;
+	}
+
+	inline CatchUp GetCatchUp() const { return _catchUp; }
+
+	// Catches the hardware up without touching it, e.g. between the instructions of a fused sequence.
+	inline void CatchUpNow() const {
+		if (_catchUpArmed)
+			_catchUp.func(_catchUp.owner);
+	}
+
+	// If the hardware can catch up partway through an update right now.
+	inline bool CanCatchUp() const { return _catchUpArmed; }
+
+	// Only set while the cpu is partway through an update, the only time the hardware can be behind it.
+	// Nothing is caught up the rest of the time, so the hardware's own accesses never call out.
+	inline void SetCpuAhead(bool ahead) {
+		_cpuAhead = ahead;
+		_catchUpArmed = _cpuAhead && _catchUp.func;
+	}
+
 	inline bool IsDMAActive() const { return _dmaTransfer.active; }
 	void DMATransferTick();
 
 	std::vector<byte> Dump() const; // TODO
 
-	inline auto GetInterruptRegs() { return std::tie(_io.ie, _io.iF); }
-	inline InterruptFlags& GetInterruptFlag() { return _io.iF; }
+	inline std::pair<InterruptFlags, InterruptFlags> GetInterruptRegs() const { return { _io.ie, _io.iF }; }
+
+	// ie & if, kept up to date by everything that changes either of them.
+	inline byte PendingInterrupts() const { return _pendingInterrupts; }
+
+	inline void RequestInterrupt(Interrupt interrupt) {
+		_io.iF = _io.iF | static_cast<byte>(interrupt);
+		UpdatePendingInterrupts();
+	}
+
+	inline void ClearInterrupt(byte interruptBit) {
+		_io.iF = _io.iF & ~interruptBit;
+		UpdatePendingInterrupts();
+	}
 
 	inline byte GetPPUMode() const { return _io.stat.flags.PPUMode; }
 
+#if defined(DEBUG) && defined(TESTS)
+	using FlatRam = std::array<byte, 0x10000>;
+
+	struct FlatWrite {
+		u16 addr;
+		byte val;
+	};
+
+	// Replaces the whole address space with plain ram for testing the cpu on its own. Nothing is mapped, nothing
+	// catches up, no interrupt is ever pending, and every write is appended to writes. nullptr goes back to normal.
+	inline void SetFlatRam(FlatRam* ram, std::vector<FlatWrite>* writes) {
+		_flatRam = ram;
+		_flatWrites = writes;
+	}
+
+	inline bool IsFlat() const { return _flatRam != nullptr; }
+#endif
+
 #ifdef DEBUG
 	// Normally, reading VRAM during either a DMA transfer or ppu mode 3 will return
 	// garbage data; however, that hurts my eyes when trying to use the VRAM Viewer.
@@ -63,6 +185,21 @@ private:
 		u16 _addr;
 	};
 
+private:
+	// Caches where each rom window currently points to. Must be called whenever the mapper chip changes banks.
+	void UpdateRomBanks();
+
+	inline void MarkCodeWrite(u16 codeRamIndex) { ++_codePageVersions[codeRamIndex / codePageSize]; }
+
+	inline void UpdatePendingInterrupts() { _pendingInterrupts = _io.ie & _io.iF & 0x1F; }
+
+	// Before vram [$8000, $9FFF], oam, or io [$FE00, $FF7F] get touched.
+	inline void CatchUpHardware(u16 addr) const {
+		const bool isHardware = (addr >= romNEnd && addr < vramEnd) || (addr >= echoRamEnd && addr < ioEnd);
+		if (_catchUpArmed && isHardware) [[unlikely]]
+			_catchUp.func(_catchUp.owner);
+	}
+
 private:	
 	std::array<byte, 0x2000> _vram{};		// video ram -- split into character ram, and bg map data.
 	std::array<byte, 0x80> _hram{};			// high ram / zero page.
@@ -76,6 +213,27 @@ private:
 
 	oam::TransferData _dmaTransfer{};
 
+	// Physical rom address of the start of [$0000, $3FFF] and [$4000, $7FFF].
+	std::array<u32, 2> _romBankBase{ 0, romBankSize };
+	u32 _romAddrMask = 0;
+
+	std::array<u32, codeRamSize / codePageSize> _codePageVersions{};
+
+	byte _pendingInterrupts = 0;
+
+	CatchUp _catchUp{};
+	bool _cpuAhead = false;
+	bool _catchUpArmed = false;	// the cpu is ahead and there's something to catch up with
+
+#ifdef JIT
+	std::vector<WriteRecord>* _writeJournal = nullptr;
+#endif
+
+#if defined(DEBUG) && defined(TESTS)
+	FlatRam* _flatRam = nullptr;
+	std::vector<FlatWrite>* _flatWrites = nullptr;
+#endif
+
 	// Bytes to return in Read when an invalid value needs to be returned
 	// Should never be changed, but Read returns a non-const byte&
 	static inline constinit std::array<byte, 2> InvalidRead = { 0x00, 0xFF };
@@ -0,0 +1,56 @@
+#pragma once
+
+#ifdef OPCODE_PROFILER
+#include <array>
+#include <ostream>
+#include <vector>
+
+#include "Core.hpp"
+
+namespace gb::cpu {
+
+/*
+	Counts how many times every op code ran and how many mcycles it took, including its fetch.
+	cb prefixed op codes are counted on their own, the prefix isn't counted separately.
+	Only instructions that go through Context::Exec are counted, so the threaded interpreter, the jit,
+	and recompiled code all fall back to it while profiling, and nothing is fused.
+	Compiled out unless OPCODE_PROFILER is defined.
+*/
+class OpcodeProfiler {
+public:
+	struct Entry {
+		u64 count = 0;
+		u64 mCycles = 0;
+	};
+
+	inline void Count(byte op, byte cbOp, u64 mCycles) {
+		Entry& entry = op == 0xCB ? _cb[cbOp] : _main[op];
+		++entry.count;
+		entry.mCycles += mCycles;
+	}
+
+	void Reset();
+
+	// Every op code that ran, sorted by the mcycles spent in it.
+	void WriteText(std::ostream& out) const;
+	void WriteJson(std::ostream& out) const;
+
+	inline const std::array<Entry, 256>& GetMain() const { return _main; }
+	inline const std::array<Entry, 256>& GetCb() const { return _cb; }
+
+private:
+	struct Row {
+		byte op;
+		bool prefixed;
+		Entry entry;
+	};
+
+	std::vector<Row> SortedRows() const;
+
+private:
+	std::array<Entry, 256> _main{};
+	std::array<Entry, 256> _cb{};
+};
+
+} // namespace gb::cpu
+#endif // OPCODE_PROFILER
@@ -72,6 +72,16 @@ public:
 
 	State Update();
 
+	// Dots that only count up before the next mode or line change.
+	u32 QuietDots() const;
+
+	// Dots before the next mode or line change that requests an interrupt enabled in IE, or the start of vblank.
+	// A halted cpu can't see anything else the ppu changes.
+	u32 HaltedDots() const;
+
+	// Same as calling Update dots times, as long as it's no more than QuietDots or HaltedDots.
+	void Skip(u32 dots);
+
 	Mode GetMode() const;
 	void SetMode(Mode newMode);
 
@@ -81,6 +91,10 @@ public:
 private:
 	void UpdateLine(byte& ly, bool zero = false);
 
+	// The dot the update that leaves a mode happens on, and the first dot counted in it.
+	u16 ModeEnd(Mode mode) const;
+	u16 ModeStart(Mode mode) const;
+
 private:
 	static constexpr u16 lineMax = 153;
 	static constexpr u16 vBlankStart = 144;
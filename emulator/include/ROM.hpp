@@ -2,6 +2,7 @@
 
 #include <filesystem>
 #include <optional>
+#include <span>
 #include <vector>
 
 #include "Core.hpp"
@@ -11,5 +12,16 @@ namespace gb::rom {
 using RomData = std::vector<byte>;
 std::optional<RomData> Load(const std::filesystem::path& romPath);
 
+// 64 bit FNV-1a. Header only, since gbrecomp hashes the banks it generates code from without the emulator.
+constexpr u64 Hash(std::span<const byte> data) {
+	u64 hash = 0xCBF29CE484222325;
+	for (byte b : data) {
+		hash ^= b;
+		hash *= 0x100000001B3;
+	}
+
+	return hash;
+}
+
 }
 
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Core.hpp"
+#include "CPU.hpp"
+#include "Memory.hpp"
+
+namespace gb::cpu {
+
+class Recompiled;
+
+// A basic block that was translated into C++ ahead of time by gbrecomp.
+struct RecompiledBlock {
+	u32 romAddr;	// physical rom address of the first instruction
+	void(*run)(Context&, Memory&, Recompiled&);
+};
+
+// A rom bank some of the blocks were generated from.
+struct RecompiledBank {
+	u32 bank;
+	u64 hash;	// rom::Hash of the whole bank
+};
+
+// Everything gbrecomp generates for a single rom.
+struct RecompiledRom {
+	std::string_view title;
+	u16 globalChecksum;		// from the rom header, a quick check before hashing anything
+	std::span<const RecompiledBank> banks;	// to make sure the blocks are run with the bytes they came from
+	std::span<const RecompiledBlock> blocks;
+};
+
+/*
+	Runs code that gbrecomp translated ahead of time, using the interpreter for everything it couldn't find
+	(code reached through indirect jumps, ram, banks that couldn't be traced...).
+	Blocks are looked up by the physical address of the pc, so switching banks always finds the right code.
+	Cycles add up across instructions and blocks, and the hardware is only synced once the cpu could have
+	run past something it would see (see Context::CanDeferSync), before the interpreter runs anything, and
+	at the end of Run. Interrupts are still checked after every instruction.
+*/
+class Recompiled {
+public:
+	Recompiled(Context& ctx, Memory& mem, const RecompiledRom& rom);
+
+	// Checks the rom header and every bank the code was generated from against the loaded rom.
+	static bool Matches(const Memory& mem, const RecompiledRom& rom);
+
+	// Same contract as Context::Run.
+	bool Run(u64 cycleBudget, Context::SyncFunc sync, void* owner);
+
+	// Called by generated code after every instruction. Returns true if the block has to stop.
+	// Generated code also stops if the pc isn't where it expects, e.g. after an interrupt.
+	inline bool Retire();
+
+	inline u64 GetRecompiledInstrs() const { return _recompiledInstrs; }
+	inline u64 GetInterpretedInstrs() const { return _interpretedInstrs; }
+
+private:
+	using BlockFunc = void(*)(Context&, Memory&, Recompiled&);
+
+	static constexpr u32 blockPageSize = 256;
+	using BlockPage = std::array<BlockFunc, blockPageSize>;
+
+	// Runs a single instruction through the interpreter.
+	bool Step();
+
+	// Syncs the cycles run since the last sync, if there are any. Returns false if the run has to stop.
+	inline bool Flush();
+
+	// Finds the block starting at the current pc, if there is one.
+	BlockFunc Lookup() const;
+
+private:
+	Context& _ctx;
+	Memory& _mem;
+
+	// Indexed by physical rom address. Pages without any blocks aren't allocated.
+	std::vector<std::unique_ptr<BlockPage>> _blocks;
+
+	// State of the current Run.
+	Context::SyncFunc _sync = nullptr;
+	void* _owner = nullptr;
+	u64 _cyclesRan = 0;
+	u64 _cycleBudget = 0;
+	std::array<u32, 2> _entryBanks{};
+	Context::SyncResult _synced = Context::SyncResult::CONTINUE;
+
+	u64 _recompiledInstrs = 0;
+	u64 _interpretedInstrs = 0;
+};
+
+inline bool Recompiled::Retire() {
+	// The end of Context::Update.
+	if (_ctx._ime & (_mem.PendingInterrupts() != 0)) [[unlikely]]
+		_ctx.InterruptHandler();
+	else if (_ctx._enablingIME)
+		_ctx._ime = true;
+
+	++_recompiledInstrs;
+
+	// Blocks were generated for the banks that were mapped when they were entered.
+	if (_ctx.CanDeferSync() && _cyclesRan + _ctx._mCycles < _cycleBudget) [[likely]]
+		return _mem.RomBankBases() != _entryBanks;
+
+	if (!Flush()) [[unlikely]]
+		return true;
+
+	return _cyclesRan >= _cycleBudget || _ctx._isHalted || _ctx._skipCycles != 0 || _mem.IsDMAActive()
+		|| _mem.RomBankBases() != _entryBanks;
+}
+
+inline bool Recompiled::Flush() {
+	if (_ctx._mCycles != 0) {
+		const u64 mCycles = std::exchange(_ctx._mCycles, 0);
+		_cyclesRan += mCycles;
+		_synced = _sync(_owner, mCycles);
+	}
+
+	return _synced == Context::SyncResult::CONTINUE;
+}
+
+} // namespace gb::cpu
@@ -0,0 +1,16 @@
+#pragma once
+
+// Included by the code gbrecomp generates.
+
+#include "CPU.hpp"
+#include "Memory.hpp"
+#include "Recompiled.hpp"
+
+namespace gb::cpu::recomp {
+
+// Runs an instruction the same way Fetch and Exec would, with the immediates known ahead of time.
+// Defined next to the handlers in CPUInstructions.cpp, for every op code.
+template <byte Op>
+void Exec(Context& cpu, Memory& mem, u16 immediate);
+
+} // namespace gb::cpu::recomp
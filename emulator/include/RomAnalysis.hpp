@@ -0,0 +1,71 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "Core.hpp"
+#include "ROM.hpp"
+
+namespace gb::rom {
+
+/*
+	Which bytes of a rom are code and how its basic blocks flow into each other, found by tracing it from the
+	entry point, rst vectors, and interrupt vectors through every call, jp, jr, and rst target.
+	[$4000, $7FFF] is followed into the bank a constant bank switch (ld a, n; ld [$2000-$3FFF], a) maps there,
+	and banked code keeps going in its own bank. Anything that can't be found statically (jp hl, jump tables,
+	targets in a bank nothing switches to...) is left as unknown, which is usually data.
+	Addresses are physical offsets into the rom, bank * $4000 + (addr - $4000) for banked code.
+*/
+class Analysis {
+public:
+	enum class Byte : byte {
+		UNKNOWN,	// never reached, data or code only reached indirectly
+		OPCODE,		// first byte of an instruction
+		OPERAND		// rest of an instruction, including the op code after a cb prefix
+	};
+
+	struct Block {
+		u32 start;
+		u32 end;	// one past the last byte
+		u16 bank;	// numbered the same way rgbds does
+		u16 addr;	// where the cpu sees start
+
+		// Starts of the blocks control can go to next, sorted. Calls have both the callee and the return address.
+		std::vector<u32> successors;
+	};
+
+	// Traces the rom one bank per thread, on up to threads threads. threads of 0 uses one per hardware thread.
+	Analysis(const RomData& rom, u64 hash, std::size_t threads = 0);
+
+	// Of the rom's contents, the same for every copy of the same rom.
+	static u64 Hash(const RomData& rom);
+
+	inline u64 Hash() const { return _hash; }
+
+	inline Byte At(u32 physicalAddr) const { return physicalAddr < _map.size() ? _map[physicalAddr] : Byte::UNKNOWN; }
+	inline bool IsCode(u32 physicalAddr) const { return At(physicalAddr) != Byte::UNKNOWN; }
+
+	// Sorted by start. No two overlap unless one jumps into the middle of another's instruction.
+	inline const std::vector<Block>& Blocks() const { return _blocks; }
+
+	// The block physicalAddr is in, or nullptr if it isn't code.
+	const Block* BlockAt(u32 physicalAddr) const;
+
+	inline std::size_t CodeBytes() const { return _codeBytes; }
+
+private:
+	u64 _hash;
+	std::vector<Byte> _map;
+	std::vector<Block> _blocks;
+	std::size_t _codeBytes = 0;
+};
+
+using SharedAnalysis = std::shared_ptr<const Analysis>;
+
+// Starts analysing the rom on another thread and returns straight away, without even hashing it there.
+// Roms with the same contents share one analysis for as long as the program runs, so starting it again for
+// another copy of the same rom just waits on the first one.
+std::shared_future<SharedAnalysis> AnalyseAsync(RomData rom);
+
+} // namespace gb::rom
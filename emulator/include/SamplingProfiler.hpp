@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+
+#include "Core.hpp"
+#include "Symbols.hpp"
+
+namespace gb {
+
+/*
+	Records which bank and pc the cpu is at every interval mcycles, to find out where a game spends its time.
+	Samples go into a fixed size buffer that's folded into per address counts whenever it fills up, so
+	taking one is only a couple of stores.
+	Reports resolve addresses with the rom's rgbds symbols when there are any.
+*/
+class SamplingProfiler {
+public:
+	// Not a multiple of any common loop length, so samples don't keep landing on the same instruction.
+	static constexpr u64 defaultInterval = 101;
+
+	static constexpr std::size_t bufferSize = 4096;
+
+	SamplingProfiler(u64 interval, std::optional<SymbolTable> symbols);
+
+	inline u64 Interval() const { return _interval; }
+	inline const std::optional<SymbolTable>& Symbols() const { return _symbols; }
+
+	// count is how many samples were due at once, e.g. while the hardware skipped through a halt.
+	inline void Record(u16 bank, u16 pc, u32 count) {
+		_buffer[_size++] = { bank, pc, count };
+
+		if (_size == bufferSize) [[unlikely]]
+			Flush();
+	}
+
+	void Reset();
+
+	// Time spent in every symbol and the hottest addresses, in samples, percent, and mcycles per frame.
+	void WriteText(std::ostream& out);
+
+	// One line per symbol, "bank;Global;Global.local samples", for flamegraph.pl and speedscope.
+	void WriteCollapsed(std::ostream& out);
+
+private:
+	struct Sample {
+		u16 bank;
+		u16 pc;
+		u32 count;
+	};
+
+	static constexpr u32 Key(u16 bank, u16 pc) { return static_cast<u32>(bank) << 16 | pc; }
+
+	void Flush();
+
+private:
+	u64 _interval;
+	std::optional<SymbolTable> _symbols;
+
+	std::array<Sample, bufferSize> _buffer{};
+	std::size_t _size = 0;
+
+	// Keyed by bank << 16 | pc.
+	std::unordered_map<u32, u64> _counts;
+	u64 _total = 0;
+};
+
+} // namespace gb
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Core.hpp"
+
+namespace gb {
+
+/*
+	Labels from an rgbds symbol file (rgblink -n). Every line is "bank:addr name" in hex, and anything after
+	a ';' is a comment. Local labels keep their scope, e.g. "Main.loop".
+	Banks are numbered the same way rgbds does: rom and sram banks from 0, wramx from 1.
+*/
+class SymbolTable {
+public:
+	struct Symbol {
+		u16 bank;
+		u16 addr;
+		std::string name;
+	};
+
+	static std::optional<SymbolTable> Load(const std::filesystem::path& path);
+
+	// The closest symbol at or before addr in the same bank and memory region, or nullptr if there isn't one.
+	const Symbol* Find(u16 bank, u16 addr) const;
+
+	// "name", "name+$offset", or "$bank:addr" if there is no symbol for it.
+	std::string Resolve(u16 bank, u16 addr) const;
+
+	// The label with exactly this name, like "Main.loop", or nullptr if there isn't one.
+	const Symbol* Lookup(std::string_view name) const;
+
+	inline std::size_t Size() const { return _symbols.size(); }
+
+private:
+	// Sorted by bank, then address. Only the first label at an address is kept.
+	std::vector<Symbol> _symbols;
+
+	// Every label, including ones at the same address as another, sorted by name.
+	std::vector<Symbol> _byName;
+};
+
+} // namespace gb
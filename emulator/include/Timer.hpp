@@ -34,10 +34,22 @@ struct Timer {
 	// true == interrupt request needed, false == no interrupt request needed
 	bool Tick();
 
+	// Ticks that can pass before the one that requests an interrupt.
+	u32 QuietTicks() const;
+
+	// Ticks that can pass before the one that changes tima.
+	u32 QuietTimaTicks() const;
+
+	// Same as calling Tick ticks times, as long as it's no more than QuietTicks.
+	void Skip(u32 ticks);
+
 	byte& Read(u16 addr);
 	void Write(u16 addr, byte data);
 
 private:
+	// The bit of div that increments tima when it falls, for each clock select. 4 tcycles per mcycle.
+	static constexpr u16 incRate[4] = { 256 << 1, 4 << 1, 16 << 1, 64 << 1 };
+
 	bool Update();
 };
 
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Core.hpp"
+
+namespace gb {
+
+// The state before an instruction, the same as Context::ShortDump prints, plus when and in which bank it ran.
+struct TraceRecord {
+	u64 cycle;		// mcycles since the emulator started
+	u16 pc;
+	u16 bank;		// rom bank of the pc, numbered the same way rgbds does
+	u16 sp;
+	byte a, f, b, c, d, e, h, l;
+	std::array<byte, 4> pcMem;	// the op code and the three bytes after it
+
+	bool operator==(const TraceRecord&) const = default;
+};
+
+/*
+	Binary instruction traces. A trace is a header, then blocks of records, then an index of the blocks.
+	Every record is packed into recordSize bytes, and every byte but the cycle's is xored with the record
+	before it in the same block. The cycle is stored as the mcycles since the record before it.
+	Almost every byte ends up as 0, so blocks are compressed by run length encoding the zeros.
+	Every block starts from scratch, so the index lets a reader start at any cycle without decoding the
+	blocks before it.
+*/
+namespace trace {
+
+inline constexpr std::array<char, 8> fileMagic = { 'G', 'B', 'T', 'R', 'A', 'C', 'E', '\0' };
+inline constexpr std::array<char, 8> indexMagic = { 'G', 'B', 'T', 'I', 'N', 'D', 'E', 'X' };
+inline constexpr u32 version = 1;
+
+inline constexpr std::size_t recordSize = 26;
+inline constexpr std::size_t blockRecords = 4096;
+
+struct IndexEntry {
+	u64 firstCycle;
+	u64 firstRecord;
+	u64 offset;		// of the block in the file
+};
+
+// In the same format as Context::ShortDump, which is also gameboy-doctor's.
+std::string FormatShortDump(const TraceRecord& record);
+
+} // namespace trace
+
+// Records are packed and compressed on a separate thread so recording only costs a copy.
+class TraceWriter {
+public:
+	explicit TraceWriter(const std::filesystem::path& path);
+	~TraceWriter();
+
+	TraceWriter(const TraceWriter&) = delete;
+	TraceWriter& operator=(const TraceWriter&) = delete;
+
+	inline bool IsOpen() const { return _isOpen; }
+
+	inline void Record(const TraceRecord& record) {
+		_block.push_back(record);
+
+		if (_block.size() == trace::blockRecords) [[unlikely]]
+			Submit();
+	}
+
+	// Writes everything recorded so far and the index. Nothing can be recorded after.
+	void Close();
+
+	inline u64 RecordCount() const { return _recordCount; }
+
+private:
+	// Hands the current block to the writing thread.
+	void Submit();
+
+	void WriteBlocks(std::stop_token stop);
+
+private:
+	std::ofstream _file;
+	bool _isOpen = false;
+
+	std::vector<TraceRecord> _block;
+	u64 _recordCount = 0;
+
+	// Only touched by the writing thread until it's joined.
+	std::vector<trace::IndexEntry> _index;
+	u64 _writtenRecords = 0;
+
+	std::mutex _mutex;
+	std::condition_variable_any _blockReady;
+	std::deque<std::vector<TraceRecord>> _queue;
+
+	// Declared last so it's joined before anything it uses is destroyed.
+	std::jthread _writer;
+};
+
+class TraceReader {
+public:
+	explicit TraceReader(const std::filesystem::path& path);
+
+	// If the file could be opened and has a valid header and index.
+	inline bool IsOpen() const { return _isOpen; }
+
+	inline u64 RecordCount() const { return _recordCount; }
+	inline const std::vector<trace::IndexEntry>& Index() const { return _index; }
+
+	// Calls visit for every record in [firstCycle, lastCycle] in order, until it returns false.
+	// Only the blocks the range is in get decoded. Returns false if the file is corrupt.
+	bool Read(u64 firstCycle, u64 lastCycle, const std::function<bool(const TraceRecord&)>& visit);
+
+private:
+	bool ReadBlock(std::size_t block, std::vector<TraceRecord>& records);
+
+private:
+	std::ifstream _file;
+	bool _isOpen = false;
+
+	std::vector<trace::IndexEntry> _index;
+	u64 _recordCount = 0;
+};
+
+} // namespace gb
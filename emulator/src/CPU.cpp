@@ -1,6 +1,17 @@
+#include <utility>
+
 #include "CPU.hpp"
 #include "ConstexprAdditions.hpp"
 #include "Memory.hpp"
+#include "Recompiled.hpp"
+
+#ifdef CALL_PROFILER
+#include "CallProfiler.hpp"
+#endif
+
+#ifdef JIT
+#include "Jit.hpp"
+#endif
 
 namespace gb::cpu {
 
@@ -8,33 +19,82 @@ namespace gb::cpu {
 // DMG -- todo?: allow for different cpus: DMG0, MGB, maybe CGB support later?
 Context::Context(Memory& memory)
 	: reg{ .pc = 0x0100, .sp = 0xFFFE,
-		   .a = 0x01, .f = { 1, 0, 1, 1 },
-		   .b = 0x00, .c = 0x13, .d = 0x00, .e = 0xD8, .h = 0x01, .l = 0x4D }
+		   .a = 0x01, .f = { 1, 0, 1, 1 } }
 	, ir(memory[0x0100])
 	, _memory(memory)
+	, _decodeCache(memory.RomSize())
 {
+	reg.bc(0x0013);
+	reg.de(0x00D8);
+	reg.hl(0x014D);
+
 	// TODO
 }
 
+Context::~Context() = default;
+
+bool Context::SetRecompiled(const RecompiledRom& rom) {
+	if (!Recompiled::Matches(_memory, rom)) {
+		debug::cexpr::println(stderr, "Recompiled code for {} doesn't match the loaded rom.", rom.title);
+		return false;
+	}
+
+	_recompiled = std::make_unique<Recompiled>(*this, _memory, rom);
+	return true;
+}
+
+bool Context::RunRecompiled(u64 cycleBudget, SyncFunc sync, void* owner) {
+	if (!_recompiled)
+		return false;
+
+	return _recompiled->Run(cycleBudget, sync, owner);
+}
+
+#ifdef JIT
+bool Context::RunJit(u64 cycleBudget, SyncFunc sync, void* owner) {
+	if (!_jit) {
+		_jit = std::make_unique<Jit>(*this, _memory);
+		_jit->SetValidation(_jitValidation);
+	}
+
+	return _jit->Run(cycleBudget, sync, owner);
+}
+
+void Context::SetJitValidation(bool enabled) {
+	_jitValidation = enabled;
+
+	if (_jit)
+		_jit->SetValidation(enabled);
+}
+#endif // JIT
+
 bool Context::Update() {
 	_mCycles = 0;
 
 	if (_isHalted) {
-		MCycle();
+		_mCycles += 1 + std::exchange(_skipCycles, 0);
 
-		auto [ie, ieReq] = _memory.GetInterruptRegs();
 		// cpu wakes when bitwise and of ie and if != 0
 		// TODO: implement halt bug (gbdev 9.2)
-		if (ie & ieReq)
+		if (_memory.PendingInterrupts() != 0)
 			_isHalted = false;
 	}
+	else if (_skipCycles != 0) [[unlikely]] {
+		// Every skipped iteration of the idle loop would have left the cpu exactly like this.
+		_mCycles = std::exchange(_skipCycles, 0);
+	}
 	else {
+		if (_breakCheck && _debugPages.test(reg.pc >> 8) && _breakCheck(_breakOwner)) [[unlikely]]
+			return true;
+
 #if defined(DEBUG)
 // print current state of cpu
 		if (longDump)
 			LongDump();
 		else if (shortDump)
 			ShortDump();
+		else if (_doctorLog != nullptr && !CheckDoctorLog())
+			return false;
 #endif
 
 		// fetch and execute overlap on the SM83.
@@ -49,7 +109,8 @@ bool Context::Update() {
 		}
 	}
 
-	if (_ime)
+	// Nothing is pending almost all the time, so this is one branch that's almost never taken.
+	if (_ime & (_memory.PendingInterrupts() != 0)) [[unlikely]]
 		InterruptHandler();
 	else if (_enablingIME)
 		_ime = true;
@@ -58,58 +119,26 @@ bool Context::Update() {
 }
 
 void Context::InterruptHandler() {
+	const byte pending = _memory.PendingInterrupts();
+	assert(pending != 0);
+
 	_enablingIME = false;
 	MCycle(1); // simulate "2" nops. second nop happens at top of PushStack
 
 	// TODO: NMI (0x80) is 2nd highest priority after bugged interrupt (0x00)
-	auto [ie, iF] = _memory.GetInterruptRegs();
-	for (byte i = 0, interrupt = 1; i < 5; ++i, interrupt <<= 1) {
-		if (ie & interrupt && iF & interrupt) {
-			_ime = false;
-			_isHalted = false;
+	// only handle one interrupt at a time, lower bits have higher priority
+	const int i = std::countr_zero(pending);
 
-			PushStack(reg.pc);
-			reg.pc = 0x40 + (i * 8);
+	_ime = false;
+	_isHalted = false;
 
-			iF = static_cast<byte>(iF) & ~interrupt;
+	PushStack(reg.pc);
+	reg.pc = static_cast<u16>(0x40 + (i * 8));
 
-			MCycle();
+	_memory.ClearInterrupt(static_cast<byte>(1 << i));
 
-			return; // only handle one interrupt at a time
-		}
-	}
-}
-
-void Context::Inc(u16 reg16) {
-	u16 val;
-	if (val = reg.bc(); reg16 == val)
-		reg.bc(val + 1);
-	else if (val = reg.de(); reg16 == val)
-		reg.de(val + 1);
-	else if (val = reg.hl(); reg16 == val)
-		reg.hl(val + 1);
-#ifdef DEBUG
-	else {
-		debug::cexpr::println(stderr, "Unknown register!");
-		BREAKPOINT;
-	}
-#endif
-}
-
-void Context::Dec(u16 reg16) {
-	u16 val;
-	if (val = reg.bc(); reg16 == val)
-		reg.bc(val - 1);
-	else if (val = reg.de(); reg16 == val)
-		reg.de(val - 1);
-	else if (val = reg.hl(); reg16 == val)
-		reg.hl(val - 1);
-#ifdef DEBUG
-	else {
-		debug::cexpr::println(stderr, "Unknown register!");
-		BREAKPOINT;
-	}
-#endif // DEBUG
+	MCycle();
+	Called();
 }
 
 void Context::PushStack(u16 value) {
@@ -137,6 +166,17 @@ void Context::MCycle(u8 cycles) {
 	_mCycles += cycles;
 }
 
+#ifdef CALL_PROFILER
+void Context::ProfileCall() {
+	_callProfiler->Call(_memory.CodeBank(reg.pc), reg.pc, reg.sp, _mCycles);
+}
+
+void Context::ProfileReturn() {
+	// where the return address was before it got popped
+	_callProfiler->Return(static_cast<u16>(reg.sp - 2), _mCycles);
+}
+#endif // CALL_PROFILER
+
 void Context::Halt() {
 	_isHalted = true;
 	//--reg.pc; // IR doesn't increment on halt
@@ -170,9 +210,22 @@ void Context::ShortDump() const {
 	byte p4 = _memory.Read(reg.pc + 3);
 
 	debug::cexpr::println("A:{:02X} F:{:02X} B:{:02X} C:{:02X} D:{:02X} E:{:02X} H:{:02X} L:{:02X} SP:{:04X} PC:{:04X} PCMEM:{:02X},{:02X},{:02X},{:02X}",
-						  reg.a, static_cast<byte>(reg.f), reg.b, reg.c, reg.d, reg.e, reg.h, reg.l,
+						  reg.a, static_cast<byte>(reg.f), reg.b(), reg.c(), reg.d(), reg.e(), reg.h(), reg.l(),
 						  reg.sp, reg.pc, p1, p2, p3, p4);
 }
+
+bool Context::CheckDoctorLog() {
+	const std::array<byte, 12> regs = {
+		reg.a, static_cast<byte>(reg.f), reg.b(), reg.c(), reg.d(), reg.e(), reg.h(), reg.l(),
+		static_cast<byte>(reg.sp >> 8), static_cast<byte>(reg.sp), static_cast<byte>(reg.pc >> 8), static_cast<byte>(reg.pc)
+	};
+
+	const std::array<byte, 4> pcMem = {
+		_memory.Read(reg.pc), _memory.Read(reg.pc + 1), _memory.Read(reg.pc + 2), _memory.Read(reg.pc + 3)
+	};
+
+	return _doctorLog->Check(regs, pcMem);
+}
 #endif // DEBUG
 
 } // namespace gb::cpu
\ No newline at end of file
@@ -1,5 +1,8 @@
-#include <mapbox/eternal.hpp>
+#include <algorithm>
 #include <array>
+#include <string_view>
+#include <tuple>
+#include <utility>
 
 #ifdef DEBUG
 #include <cstdlib>
@@ -8,7 +11,9 @@
 #include "ConstexprAdditions.hpp"
 
 #include "CPU.hpp"
+#include "InstrInfo.hpp"
 #include "Memory.hpp"
+#include "RecompiledSupport.hpp"
 
 namespace gb::cpu {
 
@@ -44,186 +49,105 @@ constexpr static void PrintFuncName(std::source_location loc = std::source_locat
 
 #pragma endregion debug functions
 
-using Addr16Getter = u16(Context::RegisterFile::*)() const;
-using Addr16MemGetter = u16(Context::RegisterFile::*)();
-using Addr16Setter = void(Context::RegisterFile::*)(u16);
-
 #define INSTR static void
 
-// Wrapper struct so that indirect hl access gets handled properly for 8-bit registers
-struct [[nodiscard]] R8Reg {
-	Context& cpu;
-	Memory& mem;
-	byte& reg;
-	const bool isIndirectHL;
-
-	constexpr R8Reg(Context& ctx, Memory& memory, byte& val, bool isHL = false)
-		: cpu(ctx)
-		, mem(memory)
-		, reg(val)
-		, isIndirectHL(isHL)
-	{}
-
-	constexpr R8Reg& operator=(byte data) {
-		if (isIndirectHL) {
-			mem.Write(cpu.reg.hl(), data);
-			cpu.MCycle();
-		}
-		else
-			reg = data;
-
-		return *this;
-	}
-
-	constexpr R8Reg& operator=(const R8Reg& other) {
-		if (other.isIndirectHL)
-			return operator=(mem.Read(cpu.reg.hl()));
-		else
-			return operator=(other.reg);
-	}
-
-	// postfix operators not supported
-	constexpr R8Reg& operator++() { return operator=(reg + 1); }
-	constexpr R8Reg& operator--() { return operator=(reg - 1); }
-
-	constexpr bool operator==(byte val) const { return reg == val; }
-
-	constexpr byte operator+(byte val) const { return reg + val; }
-	constexpr byte operator-(byte val) const { return reg - val; }
-	constexpr byte operator&(byte val) const { return reg & val; }
-	constexpr byte operator|(byte val) const { return reg | val; }
-	constexpr byte operator^(byte val) const { return reg ^ val; }
-	constexpr byte operator<<(byte val) const { return reg << val; }
-	constexpr byte operator>>(byte val) const { return reg >> val; }
-
-	constexpr R8Reg& operator&=(byte val) { return operator=(reg & val); }
-	constexpr R8Reg& operator|=(byte val) { return operator=(reg | val); }
-	constexpr R8Reg& operator^=(byte val) { return operator=(reg ^ val); }
-	constexpr R8Reg& operator<<=(byte val) { return operator=(reg << val); }
-	constexpr R8Reg& operator>>=(byte val) { return operator=(reg >> val); }
-
-	constexpr friend byte operator+(byte a, const R8Reg& b) { return a + b.reg; }
-	constexpr friend byte operator-(byte a, const R8Reg& b) { return a - b.reg; }
-	constexpr friend byte operator&(byte a, const R8Reg& b) { return a & b.reg; }
-	constexpr friend byte operator|(byte a, const R8Reg& b) { return a | b.reg; }
-	constexpr friend byte operator^(byte a, const R8Reg& b) { return a ^ b.reg; }
-	constexpr friend byte operator<<(byte a, const R8Reg& b) { return a >> b.reg; }
-	constexpr friend byte operator>>(byte a, const R8Reg& b) { return a << b.reg; }
-
-	constexpr friend byte& operator&=(byte& a, const R8Reg& b) { a &= b.reg; return a; }
-	constexpr friend byte& operator|=(byte& a, const R8Reg& b) { a |= b.reg; return a; }
-	constexpr friend byte& operator^=(byte& a, const R8Reg& b) { a ^= b.reg; return a; }
-	constexpr friend byte& operator<<=(byte& a, const R8Reg& b) { a <<= b.reg; return a; }
-	constexpr friend byte& operator>>=(byte& a, const R8Reg& b) { a >>= b.reg; return a; }
-
-	// will only happen on accumulator, no overloads for all registers
-	constexpr friend byte& operator+=(byte& a, const R8Reg& b) { a += b.reg; return a; }
-	constexpr friend byte& operator-=(byte& a, const R8Reg& b) { a -= b.reg; return a; }
-};
-
 #pragma region helper functions
-// Transform value [0, 7] into an 8-bit register for use.
-constexpr static R8Reg R8_FromBits(Context& cpu, Memory& mem, byte val) {
-	assert(val < 8);
-
-	switch (val) {
-	case 0: return { cpu, mem, cpu.reg.b };
-	case 1: return { cpu, mem, cpu.reg.c };
-	case 2: return { cpu, mem, cpu.reg.d };
-	case 3: return { cpu, mem, cpu.reg.e };
-	case 4: return { cpu, mem, cpu.reg.h };
-	case 5: return { cpu, mem, cpu.reg.l };
-		  
-	// Load byte stored in the location pointed to by hl
-	case 6: return { cpu, mem, mem[cpu.reg.hl()], true };
-
-	case 7: return { cpu, mem, cpu.reg.a };
-	default: std::unreachable();
+// Variable op codes store their operands in the op code bits. Every handler for a variable
+// op code is a template on its op code, so operand selection is done at compile time.
+
+// Transform bits [0, 7] into an 8-bit register for use.
+// 6 is the byte pointed to by hl, which isn't a register. Use R8Read/R8Write for that instead.
+template <byte Bits>
+constexpr static byte& R8(Context& cpu) {
+	static_assert(Bits < 8 && Bits != 6, "Indirect hl has to go through R8Read or R8Write");
+
+	if constexpr (Bits == 0) return cpu.reg.b();
+	else if constexpr (Bits == 1) return cpu.reg.c();
+	else if constexpr (Bits == 2) return cpu.reg.d();
+	else if constexpr (Bits == 3) return cpu.reg.e();
+	else if constexpr (Bits == 4) return cpu.reg.h();
+	else if constexpr (Bits == 5) return cpu.reg.l();
+	else return cpu.reg.a;
+}
+
+// Reads an 8-bit operand. 6 loads the byte stored in the location pointed to by hl, which takes an mcycle.
+template <byte Bits>
+constexpr static byte R8Read(Context& cpu, Memory& mem) {
+	if constexpr (Bits == 6) {
+		const byte data = mem.Read(cpu.reg.hl());
+		cpu.MCycle();
+
+		return data;
 	}
+	else
+		return R8<Bits>(cpu);
 }
 
-// Transform value [0, 3] into a function pointer to a 16-bit register setter for use.
-constexpr static Addr16Setter R16_SetFromBits(byte val) {
-	assert(val < 4);
-	using rf = Context::RegisterFile;
-
-	switch (val) {
-	case 0: return &rf::bc;
-	case 1: return &rf::de;
-	case 2: return &rf::hl;
-	case 3: return &rf::spSet;
-	default: std::unreachable();
+// Writes an 8-bit operand. Writing to the location pointed to by hl takes an mcycle.
+template <byte Bits>
+constexpr static void R8Write(Context& cpu, Memory& mem, byte data) {
+	if constexpr (Bits == 6) {
+		mem.Write(cpu.reg.hl(), data);
+		cpu.MCycle();
 	}
+	else
+		R8<Bits>(cpu) = data;
 }
 
-// Transforms a value [0, 3] into a function pointer to a 16-bit register getter
-constexpr static Addr16Getter R16_GetFromBits(byte val) {
-	assert(val < 4);
-	using rf = Context::RegisterFile;
+// Transform bits [0, 3] into a 16-bit register value: bc, de, hl, sp.
+template <byte Bits>
+constexpr static u16 R16Get(const Context::RegisterFile& reg) {
+	static_assert(Bits < 4);
 
-	switch (val) {
-	case 0: return &rf::bc;
-	case 1: return &rf::de;
-	case 2: return &rf::hl;
-	case 3: return &rf::spGet;
-	default: std::unreachable();
-	}
+	if constexpr (Bits == 0) return reg.bc();
+	else if constexpr (Bits == 1) return reg.de();
+	else if constexpr (Bits == 2) return reg.hl();
+	else return reg.sp;
 }
 
-// Transforms a value [0, 3] into a function pointer to a 16-bit register getter (memory).
-constexpr static Addr16Setter R16Mem_SetFromBits(byte val) {
-	assert(val < 4);
-	using rf = Context::RegisterFile;
+// Transform bits [0, 3] into a 16-bit register to set: bc, de, hl, sp.
+template <byte Bits>
+constexpr static void R16Set(Context::RegisterFile& reg, u16 val) {
+	static_assert(Bits < 4);
 
-	switch (val) {
-	case 0: return &rf::bc;
-	case 1: return &rf::de;
-	case 2: return &rf::hlPlus;
-	case 3: return &rf::hlMinus;
-	default: std::unreachable();
-	}
+	if constexpr (Bits == 0) reg.bc(val);
+	else if constexpr (Bits == 1) reg.de(val);
+	else if constexpr (Bits == 2) reg.hl(val);
+	else reg.sp = val;
 }
 
-// Transforms a value [0, 3] into a function pointer to a 16-bit register getter (memory).
-constexpr static Addr16MemGetter R16Mem_GetFromBits(byte val) {
-	assert(val < 4);
-	using rf = Context::RegisterFile;
+// Transform bits [0, 3] into an address from a 16-bit register (memory): bc, de, hl+, hl-.
+// hl is incremented/decremented after its value is taken.
+template <byte Bits>
+constexpr static u16 R16MemAddr(Context::RegisterFile& reg) {
+	static_assert(Bits < 4);
 
-	switch (val) {
-	case 0: return &rf::bc;
-	case 1: return &rf::de;
-	case 2: return &rf::hlPlus;
-	case 3: return &rf::hlMinus;
-	default: std::unreachable();
-	}
+	if constexpr (Bits == 0) return reg.bc();
+	else if constexpr (Bits == 1) return reg.de();
+	else if constexpr (Bits == 2) return reg.hlPlus();
+	else return reg.hlMinus();
 }
 
-// Transforms a value [0, 3] into a function pointer to a 16-bit register getter (stack).
-constexpr static Addr16Setter R16Stk_SetFromBits(byte val) {
-	assert(val < 4);
-	using rf = Context::RegisterFile;
+// Transform bits [0, 3] into a 16-bit register value (stack): bc, de, hl, af.
+template <byte Bits>
+constexpr static u16 R16StkGet(const Context::RegisterFile& reg) {
+	static_assert(Bits < 4);
 
-	switch (val) {
-	case 0: return &rf::bc;
-	case 1: return &rf::de;
-	case 2: return &rf::hl;
-	case 3: return &rf::af;
-	default: std::unreachable();
-	}
+	if constexpr (Bits == 0) return reg.bc();
+	else if constexpr (Bits == 1) return reg.de();
+	else if constexpr (Bits == 2) return reg.hl();
+	else return reg.af();
 }
 
-// Transforms a value [0, 3] into a function pointer to a 16-bit register getter (stack).
-constexpr static Addr16Getter R16Stk_GetFromBits(byte val) {
-	assert(val < 4);
-	using rf = Context::RegisterFile;
+// Transform bits [0, 3] into a 16-bit register to set (stack): bc, de, hl, af.
+template <byte Bits>
+constexpr static void R16StkSet(Context::RegisterFile& reg, u16 val) {
+	static_assert(Bits < 4);
 
-	switch (val) {
-	case 0: return &rf::bc;
-	case 1: return &rf::de;
-	case 2: return &rf::hl;
-	case 3: return &rf::af;
-	default: std::unreachable();
-	}
+	if constexpr (Bits == 0) reg.bc(val);
+	else if constexpr (Bits == 1) reg.de(val);
+	else if constexpr (Bits == 2) reg.hl(val);
+	else reg.af(val);
 }
 
 // Adds two bytes and checks if there was a carry or if the lower nibble overflowed (half carry)
@@ -249,40 +173,15 @@ constexpr static [[nodiscard]] std::tuple<byte, bool, bool> AddBytes(byte b1, by
 	};
 }
 
-// Subtracts two bytes and checks if there was a carry or if the lower nibble overflowed (half carry)
-// Returns a tuple of the half-carry result and the carry result
-constexpr static [[nodiscard]] std::tuple<bool, bool> SubBytesFlags(byte b1, byte b2, byte carry = 0) {
-	assert(carry == 0 || carry == 1);
-
-	return {
-		static_cast<s16>(b1 & 0x0F) - (b2 & 0x0F) - carry < 0,	// h
-		b2 + carry > b1	// c
-	};
-}
-
-// Does the same thing as SubBytesFlags except returns the result of the addition as well
-constexpr static [[nodiscard]] std::tuple<byte, bool, bool> SubBytes(byte b1, byte b2, byte carry = 0) {
-	assert(carry == 0 || carry == 1);
-	auto [h, c] = SubBytesFlags(b1, b2, carry);
+// Transforms bits [0, 3] into a check for a certain value in the flags.
+template <byte Bits>
+constexpr static bool FlagCond(Context::Flags flags) {
+	static_assert(Bits < 4);
 
-	return {
-		b1 - b2 - carry,
-		h,
-		c
-	};
-}
-
-// Transforms a value [0, 3] into a check for a certain value in the flags.
-constexpr static bool FlagCond(Context::Flags flags, byte val) {
-	assert(val < 4);
-
-	switch (val) {
-	case 0: return !static_cast<bool>(flags.Zero);	// NZ
-	case 1: return static_cast<bool>(flags.Zero);	// Z
-	case 2: return !static_cast<bool>(flags.Carry);	// NC
-	case 3: return static_cast<bool>(flags.Carry);	// C
-	default: std::unreachable();
-	}
+	if constexpr (Bits == 0) return !static_cast<bool>(flags.Zero);		// NZ
+	else if constexpr (Bits == 1) return static_cast<bool>(flags.Zero);	// Z
+	else if constexpr (Bits == 2) return !static_cast<bool>(flags.Carry);	// NC
+	else return static_cast<bool>(flags.Carry);							// C
 }
 
 constexpr static void SetCarryFlags(Context& cpu, bool h, bool c) {
@@ -291,23 +190,21 @@ constexpr static void SetCarryFlags(Context& cpu, bool h, bool c) {
 	f.Carry = static_cast<byte>(c);
 }
 
-// Reads one byte from the memory, increments the program counter
-// and adds an mcycle.
-static byte Read(Context& cpu, const Memory& mem) {
+// Reads one immediate byte, increments the program counter
+// and adds an mcycle. The byte was already fetched by Context::Fetch.
+static byte Read(Context& cpu, [[maybe_unused]] const Memory&) {
 	cpu.MCycle();
-	return mem[cpu.reg.pc++];
+	++cpu.reg.pc;
+	return cpu.imm[0];
 }
 
-// Reads two bytes from memory and returns the data as a 16-bit value.
+// Reads two immediate bytes and returns the data as a 16-bit value.
 // Increments program counter twice and adds two mcycles.
-static u16 Read2(Context& cpu, const Memory& mem) {
-	const byte lo = mem[cpu.reg.pc++];
-	cpu.MCycle();
-
-	const u16 hi = mem[cpu.reg.pc++];
-	cpu.MCycle();
+static u16 Read2(Context& cpu, [[maybe_unused]] const Memory&) {
+	cpu.MCycle(2);
+	cpu.reg.pc += 2;
 
-	return hi << 8 | lo;
+	return static_cast<u16>(cpu.imm[1]) << 8 | cpu.imm[0];
 }
 #pragma endregion helper functions
 
@@ -322,6 +219,7 @@ INSTR nop([[maybe_unused]] Context&, [[maybe_unused]] Memory&) {
 }
 
 #pragma region 8-bit loads
+template <byte Op>
 INSTR ld_r8_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 	/*
@@ -331,44 +229,40 @@ INSTR ld_r8_r8(Context& cpu, Memory& mem) {
 	* a chance to run
 	*/
 
-	byte destVal = (cpu.ir & 0b00'111'000) >> 3;
-	byte srcVal = cpu.ir & 0b00000'111;
+	constexpr byte destVal = (Op & 0b00'111'000) >> 3;
+	constexpr byte srcVal = Op & 0b00000'111;
 
-	R8Reg dest = R8_FromBits(cpu, mem, destVal);
-	R8Reg src = R8_FromBits(cpu, mem, srcVal);
-
-	dest = src;
+	R8Write<destVal>(cpu, mem, R8Read<srcVal>(cpu, mem));
 }
 
+template <byte Op>
 INSTR ld_r8_imm8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	byte destVal = (cpu.ir & 0b00'111'000) >> 3;
-	R8Reg reg = R8_FromBits(cpu, mem, destVal);
+	constexpr byte destVal = (Op & 0b00'111'000) >> 3;
 
-	reg = Read(cpu, mem);
-	cpu.MCycle();
+	R8Write<destVal>(cpu, mem, Read(cpu, mem));
 }
 
+template <byte Op>
 INSTR ld_acc_r16mem(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	byte destVal = (cpu.ir & 0b00'11'0000) >> 4;
-	Addr16MemGetter handle = R16Mem_GetFromBits(destVal);
+	constexpr byte destVal = (Op & 0b00'11'0000) >> 4;
 
-	byte data = mem[(cpu.reg.*handle)()];
+	byte data = mem[R16MemAddr<destVal>(cpu.reg)];
 	cpu.MCycle();
 
 	cpu.reg.a = data;
 }
 
+template <byte Op>
 INSTR ld_r16mem_acc(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	byte destVal = (cpu.ir & 0b00'11'0000) >> 4;
-	Addr16MemGetter handle = R16Mem_GetFromBits(destVal);
+	constexpr byte destVal = (Op & 0b00'11'0000) >> 4;
 
-	mem[(cpu.reg.*handle)()] = cpu.reg.a;
+	mem[R16MemAddr<destVal>(cpu.reg)] = cpu.reg.a;
 	cpu.MCycle();
 }
 
@@ -391,14 +285,14 @@ INSTR ld_imm16_acc(Context& cpu, Memory& mem) {
 INSTR ldh_acc_ffc(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	cpu.reg.a = mem[0xFF00 | cpu.reg.c];
+	cpu.reg.a = mem[0xFF00 | cpu.reg.c()];
 	cpu.MCycle();
 }
 
 INSTR ldh_ffc_acc(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	mem[0xFF00 | cpu.reg.c] = cpu.reg.a;
+	mem[0xFF00 | cpu.reg.c()] = cpu.reg.a;
 	cpu.MCycle();
 }
 
@@ -422,15 +316,14 @@ INSTR ldh_ffimm8_acc(Context& cpu, Memory& mem) {
 #pragma endregion 8-bit loads
 
 #pragma region 16-bit loads
+template <byte Op>
 INSTR ld_r16_imm16(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
 	u16 data = Read2(cpu, mem);
 
-	byte destVal = (cpu.ir & 0b00'11'0000) >> 4;
-	Addr16Setter handle = R16_SetFromBits(destVal);
-	
-	(cpu.reg.*handle)(data);
+	constexpr byte destVal = (Op & 0b00'11'0000) >> 4;
+	R16Set<destVal>(cpu.reg, data);
 }
 
 INSTR ld_imm16_sp(Context& cpu, Memory& mem) {
@@ -462,50 +355,49 @@ INSTR ld_hl_spimm8(Context& cpu, Memory& mem) {
 	byte lsb = cpu.reg.sp & 0x00FF;
 
 	auto [lReg, h, c] = AddBytes(lsb, e);
-	cpu.reg.l = lReg;
+	cpu.reg.l() = lReg;
 	cpu.reg.f.SetAllBool(0, 0, h, c);
 
 	cpu.MCycle();
 
 	// effectively subtract one if the byte was signed: signed(0xFF) == -1
 	byte minus1 = (e & 0b10000000) ? 0xFF : 0x00;
-	cpu.reg.h = msb + minus1 + cpu.reg.f.Carry;
+	cpu.reg.h() = msb + minus1 + cpu.reg.f.Carry;
 
 	// flags aren't set after reg h is set
 }
 
+template <byte Op>
 INSTR push_r16stk(Context& cpu, [[maybe_unused]] Memory&) {
 	PRINTFUNC();
 
-	byte destVal = (cpu.ir & 0b00'11'0000) >> 4;
-	Addr16Getter handle = R16Stk_GetFromBits(destVal);
+	constexpr byte destVal = (Op & 0b00'11'0000) >> 4;
 
-	u16 data = (cpu.reg.*handle)();
+	u16 data = R16StkGet<destVal>(cpu.reg);
 	cpu.PushStack(data);
 }
 
+template <byte Op>
 INSTR pop_r16stk(Context& cpu, [[maybe_unused]] Memory&) {
 	PRINTFUNC();
 
-	byte destVal = (cpu.ir & 0b00'11'0000) >> 4;
-	Addr16Setter handle = R16Stk_SetFromBits(destVal);
+	constexpr byte destVal = (Op & 0b00'11'0000) >> 4;
 
 	u16 data = cpu.PopStack();
-	(cpu.reg.*handle)(data);
+	R16StkSet<destVal>(cpu.reg, data);
 }
 #pragma endregion 16-bit loads
 
 #pragma region 8-bit arithmetic/logical instrucitons
+template <byte Op>
 INSTR add_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = cpu.ir & 0b00000'111;
-	R8Reg reg = R8_FromBits(cpu, mem, destVal);
-
-	auto [h, c] = AddBytesFlags(cpu.reg.a, reg.reg);
-	cpu.reg.a += reg;
+	constexpr byte srcVal = Op & 0b00000'111;
+	const byte data = R8Read<srcVal>(cpu, mem);
 
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, h, c);
+	cpu.reg.f.SetAdd(cpu.reg.a, data);
+	cpu.reg.a += data;
 }
 
 INSTR add_imm8(Context& cpu, Memory& mem) {
@@ -513,23 +405,20 @@ INSTR add_imm8(Context& cpu, Memory& mem) {
 
 	byte data = Read(cpu, mem);
 
-	auto [res, h, c] = AddBytes(cpu.reg.a, data);
-	cpu.reg.a = res;
-
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, h, c);
+	cpu.reg.f.SetAdd(cpu.reg.a, data);
+	cpu.reg.a += data;
 }
 
+template <byte Op>
 INSTR adc_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = cpu.ir & 0b00000'111;
-	R8Reg reg = R8_FromBits(cpu, mem, destVal);
-	
-	auto& flags = cpu.reg.f;
-	auto [h, c] = AddBytesFlags(cpu.reg.a, reg.reg, flags.Carry);
-	cpu.reg.a += reg + flags.Carry;
+	constexpr byte srcVal = Op & 0b00000'111;
+	const byte data = R8Read<srcVal>(cpu, mem);
 	
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, h, c);
+	const byte carry = cpu.reg.f.Carry;
+	cpu.reg.f.SetAdd(cpu.reg.a, data, carry);
+	cpu.reg.a += data + carry;
 }
 
 INSTR adc_imm8(Context& cpu, Memory& mem) {
@@ -537,24 +426,20 @@ INSTR adc_imm8(Context& cpu, Memory& mem) {
 
 	byte data = Read(cpu, mem);
 
-	auto& flags = cpu.reg.f;
-	auto [res, h, c] = AddBytes(cpu.reg.a, data, flags.Carry);
-	
-	cpu.reg.a += data + flags.Carry;
-
-	flags.SetAllBool(cpu.reg.a == 0, 0, h, c);
+	const byte carry = cpu.reg.f.Carry;
+	cpu.reg.f.SetAdd(cpu.reg.a, data, carry);
+	cpu.reg.a += data + carry;
 }
 
+template <byte Op>
 INSTR sub_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = cpu.ir & 0b00000'111;
-	R8Reg reg = R8_FromBits(cpu, mem, destVal);
+	constexpr byte srcVal = Op & 0b00000'111;
+	const byte data = R8Read<srcVal>(cpu, mem);
 
-	auto [h, c] = SubBytesFlags(cpu.reg.a, reg.reg);
-	cpu.reg.a -= reg;
-
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 1, h, c);
+	cpu.reg.f.SetSub(cpu.reg.a, data);
+	cpu.reg.a -= data;
 }
 
 INSTR sub_imm8(Context& cpu, Memory& mem) {
@@ -562,24 +447,20 @@ INSTR sub_imm8(Context& cpu, Memory& mem) {
 
 	byte data = Read(cpu, mem);
 
-	auto [res, h, c] = SubBytes(cpu.reg.a, data);
-	cpu.reg.a = res;
-
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 1, h, c);
+	cpu.reg.f.SetSub(cpu.reg.a, data);
+	cpu.reg.a -= data;
 }
 
+template <byte Op>
 INSTR sbc_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = cpu.ir & 0b00000'111;
-	R8Reg reg = R8_FromBits(cpu, mem, destVal);
+	constexpr byte srcVal = Op & 0b00000'111;
+	const byte data = R8Read<srcVal>(cpu, mem);
 
-	auto& flags = cpu.reg.f;
-	
-	auto [h, c] = SubBytesFlags(cpu.reg.a, reg.reg, flags.Carry);
-	cpu.reg.a = cpu.reg.a - reg - flags.Carry;
-
-	flags.SetAllBool(cpu.reg.a == 0, 1, h, c);
+	const byte carry = cpu.reg.f.Carry;
+	cpu.reg.f.SetSub(cpu.reg.a, data, carry);
+	cpu.reg.a = cpu.reg.a - data - carry;
 }
 
 INSTR sbc_imm8(Context& cpu, Memory& mem) {
@@ -587,21 +468,19 @@ INSTR sbc_imm8(Context& cpu, Memory& mem) {
 
 	byte data = Read(cpu, mem);
 
-	auto& flags = cpu.reg.f;
-	auto [res, h, c] = SubBytes(cpu.reg.a, data, flags.Carry);
-	
-	cpu.reg.a = res;
-	flags.SetAllBool(cpu.reg.a == 0, 1, h, c);
+	const byte carry = cpu.reg.f.Carry;
+	cpu.reg.f.SetSub(cpu.reg.a, data, carry);
+	cpu.reg.a = cpu.reg.a - data - carry;
 }
 
+template <byte Op>
 INSTR cp_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = cpu.ir & 0b00000'111;
-	R8Reg reg = R8_FromBits(cpu, mem, destVal);
+	constexpr byte srcVal = Op & 0b00000'111;
+	const byte data = R8Read<srcVal>(cpu, mem);
 
-	auto [h, c] = SubBytesFlags(cpu.reg.a, reg.reg);
-	cpu.reg.f.SetAllBool(cpu.reg.a - reg == 0, 1, h, c);
+	cpu.reg.f.SetSub(cpu.reg.a, data);
 }
 
 INSTR cp_imm8(Context& cpu, Memory& mem) {
@@ -609,43 +488,44 @@ INSTR cp_imm8(Context& cpu, Memory& mem) {
 
 	byte data = Read(cpu, mem);
 
-	auto [h, c] = SubBytesFlags(cpu.reg.a, data);
-	cpu.reg.f.SetAllBool(cpu.reg.a - data == 0, 1, h, c);
+	cpu.reg.f.SetSub(cpu.reg.a, data);
 }
 
+template <byte Op>
 INSTR inc_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = (cpu.ir & 0b00'111'000) >> 3;
+	constexpr byte destVal = (Op & 0b00'111'000) >> 3;
 	
-	R8Reg reg = R8_FromBits(cpu, mem, destVal);
-	byte oldVal = reg.reg;
-	++reg;
+	const byte oldVal = R8Read<destVal>(cpu, mem);
+	const byte newVal = oldVal + 1;
+	R8Write<destVal>(cpu, mem, newVal);
 
-	cpu.reg.f.SetAllBool(reg == 0, 0, (oldVal & 0x0F) + 1 >= 0x10, cpu.reg.f.Carry);
+	cpu.reg.f.SetInc(newVal);
 }
 
+template <byte Op>
 INSTR dec_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = (cpu.ir & 0b00'111'000) >> 3;
+	constexpr byte destVal = (Op & 0b00'111'000) >> 3;
 	
-	R8Reg reg = R8_FromBits(cpu, mem, destVal);
-	byte oldVal = reg.reg;
-	--reg;
+	const byte oldVal = R8Read<destVal>(cpu, mem);
+	const byte newVal = oldVal - 1;
+	R8Write<destVal>(cpu, mem, newVal);
 
-	cpu.reg.f.SetAllBool(reg == 0, 1, static_cast<s16>(oldVal & 0x0F) - 1 < 0, cpu.reg.f.Carry);
+	cpu.reg.f.SetDec(newVal);
 }
 
+template <byte Op>
 INSTR and_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = cpu.ir & 0b00000'111;
-	const R8Reg reg = R8_FromBits(cpu, mem, destVal);
+	constexpr byte srcVal = Op & 0b00000'111;
 
-	cpu.reg.a &= reg;
+	cpu.reg.a &= R8Read<srcVal>(cpu, mem);
 
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, 1, 0);
+	cpu.reg.f.SetLogic(cpu.reg.a, true);
 }
 
 INSTR and_imm8(Context& cpu, Memory& mem) {
@@ -654,18 +534,18 @@ INSTR and_imm8(Context& cpu, Memory& mem) {
 	byte data = Read(cpu, mem);
 	cpu.reg.a &= data;
 
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, 1, 0);
+	cpu.reg.f.SetLogic(cpu.reg.a, true);
 }
 
+template <byte Op>
 INSTR or_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = cpu.ir & 0b00000'111;
-	const R8Reg reg = R8_FromBits(cpu, mem, destVal);
+	constexpr byte srcVal = Op & 0b00000'111;
 
-	cpu.reg.a |= reg;
+	cpu.reg.a |= R8Read<srcVal>(cpu, mem);
 
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, 0, 0);
+	cpu.reg.f.SetLogic(cpu.reg.a, false);
 }
 
 INSTR or_imm8(Context& cpu, Memory& mem) {
@@ -674,18 +554,18 @@ INSTR or_imm8(Context& cpu, Memory& mem) {
 	byte data = Read(cpu, mem);
 	cpu.reg.a |= data;
 
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, 0, 0);
+	cpu.reg.f.SetLogic(cpu.reg.a, false);
 }
 
+template <byte Op>
 INSTR xor_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const byte destVal = cpu.ir & 0b00000'111;
-	const R8Reg reg = R8_FromBits(cpu, mem, destVal);
+	constexpr byte srcVal = Op & 0b00000'111;
 
-	cpu.reg.a ^= reg;
+	cpu.reg.a ^= R8Read<srcVal>(cpu, mem);
 
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, 0, 0);
+	cpu.reg.f.SetLogic(cpu.reg.a, false);
 }
 
 INSTR xor_imm8(Context& cpu, Memory& mem) {
@@ -694,7 +574,7 @@ INSTR xor_imm8(Context& cpu, Memory& mem) {
 	byte data = Read(cpu, mem);
 	cpu.reg.a ^= data;
 
-	cpu.reg.f.SetAllBool(cpu.reg.a == 0, 0, 0, 0);
+	cpu.reg.f.SetLogic(cpu.reg.a, false);
 }
 
 INSTR ccf(Context& cpu, [[maybe_unused]] Memory&) {
@@ -714,31 +594,10 @@ INSTR daa(Context& cpu, [[maybe_unused]] Memory&) {
 	PRINTFUNC();
 
 	auto& flags = cpu.reg.f;
-	byte adjustment = 0;
-	
-	if (flags.Subtract == 1) {
-		if (flags.HalfCarry == 1)
-			adjustment += 0x6;
+	const u16 res = alu::daaTable[alu::DaaIndex(cpu.reg.a, flags.Subtract, flags.HalfCarry, flags.Carry)];
 
-		if (flags.Carry == 1)
-			adjustment += 0x60;
-
-		cpu.reg.a -= adjustment;
-	}
-	else {
-		if (flags.HalfCarry == 1 || (cpu.reg.a & 0xF) > 0x9)
-			adjustment += 0x6;
-
-		if (flags.Carry == 1 || cpu.reg.a > 0x99) {
-			adjustment += 0x60;
-			flags.Carry = 1;
-		}
-
-		cpu.reg.a += adjustment;
-	}
-
-	flags.Zero = (cpu.reg.a == 0);
-	flags.HalfCarry = 0;
+	cpu.reg.a = static_cast<byte>(res >> 8);
+	flags = static_cast<byte>(res & 0xFF);
 }
 
 INSTR cpl(Context& cpu, [[maybe_unused]] Memory&) {
@@ -753,38 +612,45 @@ INSTR cpl(Context& cpu, [[maybe_unused]] Memory&) {
 #pragma endregion 8-bit arithmetic/logical instrucitons
 
 #pragma region 16-bit arithmetic
+template <byte Op>
 INSTR inc_r16(Context& cpu, [[maybe_unused]] Memory&) {
 	PRINTFUNC();
 
-	const byte destVal = (cpu.ir & 0b00'11'0000) >> 4;
-	Addr16Setter setter = R16_SetFromBits(destVal);
-	Addr16Getter getter = R16_GetFromBits(destVal);
+	constexpr byte destVal = (Op & 0b00'11'0000) >> 4;
+
+	if constexpr (destVal == 3)
+		++cpu.reg.sp;
+	else
+		cpu.reg.Inc(destVal);
 
-	u16 plus1 = (cpu.reg.*getter)() + 1;
-	(cpu.reg.*setter)(plus1);
+	// the 16-bit inc/dec unit takes an mcycle of its own
+	cpu.MCycle();
 }
 
+template <byte Op>
 INSTR dec_r16(Context& cpu, [[maybe_unused]] Memory&) {
 	PRINTFUNC();
 
-	const byte destVal = (cpu.ir & 0b00'11'0000) >> 4;
-	Addr16Setter setter = R16_SetFromBits(destVal);
-	Addr16Getter getter = R16_GetFromBits(destVal);
+	constexpr byte destVal = (Op & 0b00'11'0000) >> 4;
+
+	if constexpr (destVal == 3)
+		--cpu.reg.sp;
+	else
+		cpu.reg.Dec(destVal);
 
-	u16 minus1 = (cpu.reg.*getter)() - 1;
-	(cpu.reg.*setter)(minus1);
+	cpu.MCycle();
 }
 
+template <byte Op>
 INSTR add_hl_r16(Context& cpu, [[maybe_unused]] Memory&) {
 	PRINTFUNC();
 
-	const byte destVal = (cpu.ir & 0b00'11'0000) >> 4;
-	Addr16Getter handle = R16_GetFromBits(destVal);
+	constexpr byte destVal = (Op & 0b00'11'0000) >> 4;
 
-	u16 reg = (cpu.reg.*handle)();
+	u16 reg = R16Get<destVal>(cpu.reg);
 
-	auto [resL, h1, c1] = AddBytes(cpu.reg.l, reg & 0x00FF);
-	cpu.reg.l = resL;
+	auto [resL, h1, c1] = AddBytes(cpu.reg.l(), reg & 0x00FF);
+	cpu.reg.l() = resL;
 
 	auto& flags = cpu.reg.f;
 	flags.Subtract = 0;
@@ -792,8 +658,8 @@ INSTR add_hl_r16(Context& cpu, [[maybe_unused]] Memory&) {
 
 	cpu.MCycle();
 
-	auto [resH, h2, c2] = AddBytes(cpu.reg.h, ((reg & 0xFF00) >> 8), flags.Carry);
-	cpu.reg.h = resH;
+	auto [resH, h2, c2] = AddBytes(cpu.reg.h(), ((reg & 0xFF00) >> 8), flags.Carry);
+	cpu.reg.h() = resH;
 	SetCarryFlags(cpu, h2, c2);
 }
 
@@ -817,7 +683,9 @@ INSTR add_sp_imm8(Context& cpu, Memory& mem) {
 	byte minus1 = (e & 0b10000000) ? 0xFF : 0x00;
 	msb += minus1 + cpu.reg.f.Carry;
 
+	// unlike ld hl, sp + e8, the result takes another mcycle to get written back to sp
 	cpu.reg.sp = (static_cast<u16>(msb) << 8) | lsb;
+	cpu.MCycle();
 }
 #pragma endregion 16-bit arithmetic
 
@@ -861,9 +729,13 @@ INSTR jp_imm16(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
 	u16 addr = Read2(cpu, mem);
+	const u16 end = cpu.reg.pc;
 
 	cpu.reg.pc = addr;
 	cpu.MCycle();
+
+	if (addr < end)
+		cpu.JumpedBack(end);
 }
 
 INSTR jp_hl(Context& cpu, Memory& mem) {
@@ -872,15 +744,21 @@ INSTR jp_hl(Context& cpu, Memory& mem) {
 	cpu.reg.pc = cpu.reg.hl();
 }
 
+template <byte Op>
 INSTR jp_cond_imm16(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
 	u16 addr = Read2(cpu, mem);
-	const byte condVal = (cpu.ir & 0b000'11'000) >> 3;
+	constexpr byte condVal = (Op & 0b000'11'000) >> 3;
+
+	if (FlagCond<condVal>(cpu.reg.f)) {
+		const u16 end = cpu.reg.pc;
 
-	if (FlagCond(cpu.reg.f, condVal)) {
 		cpu.reg.pc = addr;
 		cpu.MCycle();
+
+		if (addr < end)
+			cpu.JumpedBack(end);
 	}
 }
 
@@ -889,17 +767,25 @@ INSTR jr_imm8(Context& cpu, Memory& mem) {
 
 	sbyte relativeAddr = Read(cpu, mem);
 	cpu.reg.pc += relativeAddr;
+	cpu.MCycle();
+
+	if (relativeAddr < 0)
+		cpu.JumpedBack(static_cast<u16>(cpu.reg.pc - relativeAddr));
 }
 
+template <byte Op>
 INSTR jr_cond_imm8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
 	sbyte relativeAddr = Read(cpu, mem);
-	const byte condVal = (cpu.ir & 0b000'11'000) >> 3;
+	constexpr byte condVal = (Op & 0b000'11'000) >> 3;
 
-	if (FlagCond(cpu.reg.f, condVal)) {
+	if (FlagCond<condVal>(cpu.reg.f)) {
 		cpu.reg.pc += relativeAddr;
 		cpu.MCycle();
+
+		if (relativeAddr < 0)
+			cpu.JumpedBack(static_cast<u16>(cpu.reg.pc - relativeAddr));
 	}
 }
 
@@ -910,17 +796,20 @@ INSTR call_imm16(Context& cpu, Memory& mem) {
 
 	cpu.PushStack(cpu.reg.pc);
 	cpu.reg.pc = fnAddr;
+	cpu.Called();
 }
 
+template <byte Op>
 INSTR call_cond_imm16(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
 	u16 fnAddr = Read2(cpu, mem);
-	const byte condVal = (cpu.ir & 0b000'11'000) >> 3;
+	constexpr byte condVal = (Op & 0b000'11'000) >> 3;
 
-	if (FlagCond(cpu.reg.f, condVal)) {
+	if (FlagCond<condVal>(cpu.reg.f)) {
 		cpu.PushStack(cpu.reg.pc);
 		cpu.reg.pc = fnAddr;
+		cpu.Called();
 	}
 }
 
@@ -931,21 +820,24 @@ INSTR ret(Context& cpu, [[maybe_unused]] Memory&) {
 	
 	cpu.reg.pc = retAddr;
 	cpu.MCycle();
+	cpu.Returned();
 }
 
+template <byte Op>
 INSTR ret_cond(Context& cpu, [[maybe_unused]] Memory&) {
 	PRINTFUNC();
 
-	const byte condVal = (cpu.ir & 0b000'11'000) >> 3;
+	constexpr byte condVal = (Op & 0b000'11'000) >> 3;
 
 	cpu.MCycle();
-	if (!FlagCond(cpu.reg.f, condVal))
+	if (!FlagCond<condVal>(cpu.reg.f))
 		return;
 	
 	u16 retAddr = cpu.PopStack();
 
 	cpu.reg.pc = retAddr;
 	cpu.MCycle();
+	cpu.Returned();
 }
 
 INSTR reti(Context& cpu, Memory& mem) {
@@ -956,15 +848,18 @@ INSTR reti(Context& cpu, Memory& mem) {
 	cpu.reg.pc = retAddr;
 	cpu.ForceEnableInterrupts();
 	cpu.MCycle();
+	cpu.Returned();
 }
 
+template <byte Op>
 INSTR rst_tgt3(Context& cpu, [[maybe_unused]] Memory&) {
 	PRINTFUNC();
 
 	cpu.PushStack(cpu.reg.pc);
 
-	byte rstAddr = cpu.ir & 0b00'111'000;
+	constexpr byte rstAddr = Op & 0b00'111'000;
 	cpu.reg.pc = rstAddr;
+	cpu.Called();
 }
 #pragma endregion control flow instructions
 
@@ -996,132 +891,165 @@ INSTR ei(Context& cpu, Memory& mem) {
 #pragma endregion non-prefixed instructions
 
 #pragma region prefixed (cb) instructions
+template <byte Op>
 INSTR cb_rlc_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00000'111);
+	constexpr byte regVal = Op & 0b00000'111;
 
-	reg = std::rotl(reg.reg, 1);
-	cpu.reg.f.SetAllBool(reg == 0, 0, 0, reg & 1);
+	const byte res = std::rotl(R8Read<regVal>(cpu, mem), 1);
+	R8Write<regVal>(cpu, mem, res);
+
+	cpu.reg.f.SetAllBool(res == 0, 0, 0, res & 1);
 }
 
+template <byte Op>
 INSTR cb_rrc_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00000'111);
+	constexpr byte regVal = Op & 0b00000'111;
+	const byte val = R8Read<regVal>(cpu, mem);
+
+	const bool carry = val & 1;
+	const byte res = std::rotr(val, 1);
+	R8Write<regVal>(cpu, mem, res);
 
-	const bool carry = reg & 1;
-	reg = std::rotr(reg.reg, 1);
-	cpu.reg.f.SetAllBool(reg == 0, 0, 0, carry);
+	cpu.reg.f.SetAllBool(res == 0, 0, 0, carry);
 }
 
+template <byte Op>
 INSTR cb_rl_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00000'111);
+	constexpr byte regVal = Op & 0b00000'111;
+	const byte val = R8Read<regVal>(cpu, mem);
 
-	bool carry = reg & 0b10000000;
-	reg = (reg << 1) | cpu.reg.f.Carry;
+	bool carry = val & 0b10000000;
+	const byte res = (val << 1) | cpu.reg.f.Carry;
+	R8Write<regVal>(cpu, mem, res);
 
-	cpu.reg.f.SetAllBool(reg == 0, 0, 0, carry);
+	cpu.reg.f.SetAllBool(res == 0, 0, 0, carry);
 }
 
+template <byte Op>
 INSTR cb_rr_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00000'111);
+	constexpr byte regVal = Op & 0b00000'111;
+	const byte val = R8Read<regVal>(cpu, mem);
 
-	bool carry = reg & 1;
-	reg = (reg >> 1) | (cpu.reg.f.Carry << 7);
+	bool carry = val & 1;
+	const byte res = (val >> 1) | (cpu.reg.f.Carry << 7);
+	R8Write<regVal>(cpu, mem, res);
 
-	cpu.reg.f.SetAllBool(reg == 0, 0, 0, carry);
+	cpu.reg.f.SetAllBool(res == 0, 0, 0, carry);
 }
 
+template <byte Op>
 INSTR cb_sla_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00000'111);
+	constexpr byte regVal = Op & 0b00000'111;
+	const byte val = R8Read<regVal>(cpu, mem);
 
-	bool carry = reg & 0b10000000;
-	reg <<= 1;
+	bool carry = val & 0b10000000;
+	const byte res = val << 1;
+	R8Write<regVal>(cpu, mem, res);
 
-	cpu.reg.f.SetAllBool(reg == 0, 0, 0, carry);
+	cpu.reg.f.SetAllBool(res == 0, 0, 0, carry);
 }
 
+template <byte Op>
 INSTR cb_sra_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00000'111);
+	constexpr byte regVal = Op & 0b00000'111;
+	const byte val = R8Read<regVal>(cpu, mem);
 
-	bool carry = reg & 1;
-	reg = static_cast<sbyte>(reg.reg) >> 1;
+	bool carry = val & 1;
+	const byte res = static_cast<sbyte>(val) >> 1;
+	R8Write<regVal>(cpu, mem, res);
 
-	cpu.reg.f.SetAllBool(reg == 0, 0, 0, carry);
+	cpu.reg.f.SetAllBool(res == 0, 0, 0, carry);
 }
 
+template <byte Op>
 INSTR cb_swap_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00000'111);
+	constexpr byte regVal = Op & 0b00000'111;
 
-	reg = std::rotl(reg.reg, 4);
-	cpu.reg.f.SetAllBool(reg == 0, 0, 0, 0);
+	const byte res = std::rotl(R8Read<regVal>(cpu, mem), 4);
+	R8Write<regVal>(cpu, mem, res);
+
+	cpu.reg.f.SetAllBool(res == 0, 0, 0, 0);
 }
 
+template <byte Op>
 INSTR cb_srl_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00000'111);
+	constexpr byte regVal = Op & 0b00000'111;
+	const byte val = R8Read<regVal>(cpu, mem);
 
-	bool carry = reg & 1;
-	reg >>= 1;
+	bool carry = val & 1;
+	const byte res = val >> 1;
+	R8Write<regVal>(cpu, mem, res);
 
-	cpu.reg.f.SetAllBool(reg == 0, 0, 0, carry);
+	cpu.reg.f.SetAllBool(res == 0, 0, 0, carry);
 }
 
+template <byte Op>
 INSTR cb_bit_b3_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	const R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00'000'111);
-	const byte bitNum = (cpu.ir & 0b00'111'000) >> 3;
+	constexpr byte regVal = Op & 0b00'000'111;
+	constexpr byte bitNum = (Op & 0b00'111'000) >> 3;
 
-	cpu.reg.f.SetAllBool(!(reg & (1 << bitNum)), 0, 1, cpu.reg.f.Carry);
+	const byte val = R8Read<regVal>(cpu, mem);
+	cpu.reg.f.SetAllBool(!(val & (1 << bitNum)), 0, 1, cpu.reg.f.Carry);
 }
 
+template <byte Op>
 INSTR cb_res_b3_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00'000'111);
-	const byte bitNum = (cpu.ir & 0b00'111'000) >> 3;
+	constexpr byte regVal = Op & 0b00'000'111;
+	constexpr byte bitNum = (Op & 0b00'111'000) >> 3;
 
-	reg &= ~(1 << bitNum);
+	R8Write<regVal>(cpu, mem, R8Read<regVal>(cpu, mem) & ~(1 << bitNum));
 }
 
+template <byte Op>
 INSTR cb_set_b3_r8(Context& cpu, Memory& mem) {
 	PRINTFUNC();
 
-	R8Reg reg = R8_FromBits(cpu, mem, cpu.ir & 0b00'000'111);
-	const byte bitNum = (cpu.ir & 0b00'111'000) >> 3;
+	constexpr byte regVal = Op & 0b00'000'111;
+	constexpr byte bitNum = (Op & 0b00'111'000) >> 3;
 
-	reg |= 1 << bitNum;
+	R8Write<regVal>(cpu, mem, R8Read<regVal>(cpu, mem) | (1 << bitNum));
 }
 #pragma endregion prefixed (cb) instructions
 
-#define INSTRMAP(x) { OpCode::##x, &x }
-
 // Contains the mapping of op code -> handler.
 // ignoreBits sets each bit that should effectively be ignored when looking up an op code.
+// specialize is a template lambda that returns the handler for a given op code. Handlers with
+// variable op codes are templates, so each op code gets its own copy with the operand bits
+// already decoded.
+template <typename Specializer>
 struct VariableInstrData {
-	Context::InstrFunc handler;
+	Specializer specialize;
 	OpCode op;
-	byte ignoreBits; 
+	byte ignoreBits;
+	std::string_view name;
 };
-#define INSTRDATA(op, byte) { &op, OpCode::##op, byte }
+
+#define INSTRMAP(x) VariableInstrData{ []<byte>() -> Context::InstrFunc { return &x; }, OpCode::x, 0, #x }
+#define INSTRDATA(op, bits) VariableInstrData{ []<byte Op>() -> Context::InstrFunc { return &op<Op>; }, OpCode::op, bits, #op }
 
 // A mapping of all the instructions that do not have multiple different possible op codes
 // such as ld_r8_r8, where 6 bits can differ.
-static constexpr auto constInstrMap = mapbox::eternal::map<OpCode, Context::InstrFunc>(
-{
+static constexpr auto constInstrMap = std::make_tuple(
 	INSTRMAP(nop),
 	INSTRMAP(ld_acc_imm16),
 	INSTRMAP(ld_imm16_acc),
@@ -1147,7 +1075,6 @@ static constexpr auto constInstrMap = mapbox::eternal::map<OpCode, Context::Inst
 	INSTRMAP(add_sp_imm8),
 	INSTRMAP(rlca),
 	INSTRMAP(rrca),
-	INSTRMAP(rrca),
 	INSTRMAP(rla),
 	INSTRMAP(rra),
 	INSTRMAP(cb_prefix),
@@ -1160,14 +1087,13 @@ static constexpr auto constInstrMap = mapbox::eternal::map<OpCode, Context::Inst
 	INSTRMAP(stop),
 	INSTRMAP(halt),
 	INSTRMAP(di),
-	INSTRMAP(ei),
-});
+	INSTRMAP(ei)
+);
 
-// A mapping of all the instructions that have many possible op codes
-// Stored as an array because find_if is used on this collection, which removes any benefit
-// of using a map.
-static constexpr auto variableInstrMap = std::to_array<VariableInstrData>(
-{
+// A mapping of all the instructions that have many possible op codes.
+// Only used to generate the dispatch tables below. Stored as a tuple since every entry
+// has its own specializer type.
+static constexpr auto variableInstrMap = std::make_tuple(
 	INSTRDATA(ld_r8_r8, 0b00'111'111),
 	INSTRDATA(ld_r8_imm8, 0b00'111'000),
 	INSTRDATA(ld_acc_r16mem, 0b00'11'0000),
@@ -1192,13 +1118,12 @@ static constexpr auto variableInstrMap = std::to_array<VariableInstrData>(
 	INSTRDATA(jr_cond_imm8, 0b000'11'000),
 	INSTRDATA(call_cond_imm16, 0b000'11'000),
 	INSTRDATA(ret_cond, 0b000'11'000),
-	INSTRDATA(rst_tgt3, 0b00'111'000),
-});
+	INSTRDATA(rst_tgt3, 0b00'111'000)
+);
 
 // A mapping of all the cb instructions that have many possible op codes.
-// Stored as an array for the same reason as variableInstrMap
-static constexpr auto cbInstrMap = std::to_array<VariableInstrData>(
-{
+// Stored as a tuple for the same reason as variableInstrMap
+static constexpr auto cbInstrMap = std::make_tuple(
 	INSTRDATA(cb_rlc_r8, 0b00000'111),
 	INSTRDATA(cb_rrc_r8, 0b00000'111),
 	INSTRDATA(cb_rl_r8, 0b00000'111),
@@ -1209,8 +1134,11 @@ static constexpr auto cbInstrMap = std::to_array<VariableInstrData>(
 	INSTRDATA(cb_srl_r8, 0b00000'111),
 	INSTRDATA(cb_bit_b3_r8, 0b00'111'111),
 	INSTRDATA(cb_res_b3_r8, 0b00'111'111),
-	INSTRDATA(cb_set_b3_r8, 0b00'111'111),
-});
+	INSTRDATA(cb_set_b3_r8, 0b00'111'111)
+);
+
+// cb instructions all have variable op codes.
+static constexpr std::tuple<> noInstrs{};
 
 // A list of unused op codes. If an op code in this list is somehow chosen,
 // the cpu should hang.
@@ -1219,123 +1147,567 @@ static constexpr auto InvalidInstrs = std::to_array<byte>(
 	0xD3, 0xDB, 0xDD, 0xE3, 0xE4, 0xEB, 0xEC, 0xED, 0xF4, 0xFC, 0xFD
 });
 
-// Uses cbInstrMap, similar to Context::Fetch but just for cb prefixed instructions.
-INSTR cb_prefix(Context& cpu, Memory& mem) {
-	PRINTFUNC();
-	namespace rng = std::ranges;
+#pragma region dispatch table generation
+// One slot of a dispatch table. Unused op codes are left with a null handler.
+struct InstrEntry {
+	Context::InstrFunc handler = nullptr;
+	OpCode op = OpCode::undefined;
+	std::string_view name = "undefined";
+};
 
-	cpu.ir = mem[cpu.reg.pc++];
-	cpu.MCycle();
+using InstrTable = std::array<InstrEntry, 256>;
+
+// Checks if an op code belongs to an instruction once its variable bits are ignored.
+/* ex:		ir == 0b00'01'0001
+*			op == 0b00'00'0001
+*	ignoreBits == 0b00'11'0000 (2s complement: 0b11'00'1111)
+* irWithIgnore == 0b00'00'0001
+*		   res == 0b00'00'0001
+* res == op <-- instruction found
+*/
+template <typename Specializer>
+constexpr static bool Matches(const VariableInstrData<Specializer>& data, byte ir) {
+	byte irWithIgnore = ir & ~data.ignoreBits;
+	return irWithIgnore == static_cast<byte>(data.op);
+}
+
+template <typename... Instrs>
+constexpr static std::size_t CountMatches(const std::tuple<Instrs...>& instrs, byte ir) {
+	return std::apply([ir](const auto&... data) {
+		return (static_cast<std::size_t>(Matches(data, ir)) + ... + 0);
+	}, instrs);
+}
+
+constexpr static std::size_t noMatch = static_cast<std::size_t>(-1);
+
+// Returns the index of the first instruction in the tuple that matches, or noMatch.
+template <typename... Instrs>
+constexpr static std::size_t FindMatch(const std::tuple<Instrs...>& instrs, byte ir) {
+	return std::apply([ir](const auto&... data) {
+		std::size_t index = 0;
+		const bool found = ((Matches(data, ir) || (++index, false)) || ...);
+		return found ? index : noMatch;
+	}, instrs);
+}
+
+// Looks up a single op code and instantiates its handler.
+// Non-variable instructions take priority, which is how halt wins over ld [hl], [hl] (see ld_r8_r8).
+template <const auto& ConstInstrs, const auto& VarInstrs, byte Op>
+consteval static InstrEntry SpecializeEntry() {
+	constexpr std::size_t constIndex = FindMatch(ConstInstrs, Op);
+	constexpr std::size_t varIndex = FindMatch(VarInstrs, Op);
+
+	if constexpr (constIndex != noMatch) {
+		const auto& data = std::get<constIndex>(ConstInstrs);
+		return { data.specialize.template operator()<Op>(), data.op, data.name };
+	}
+	else if constexpr (varIndex != noMatch) {
+		const auto& data = std::get<varIndex>(VarInstrs);
+		return { data.specialize.template operator()<Op>(), data.op, data.name };
+	}
+	else
+		return {};
+}
 
-	auto it = rng::find_if(
-		cbInstrMap,
-		[&cpu](const VariableInstrData& data) {
-			// Explanation in CPU::Fetch
-			byte opAsByte = static_cast<byte>(data.op);
-			byte irWithIgnore = cpu.ir & ~data.ignoreBits;
+// Builds a flat op code -> handler table with one specialized handler per op code.
+template <const auto& ConstInstrs, const auto& VarInstrs, std::size_t... Ops>
+consteval static InstrTable MakeInstrTable(std::index_sequence<Ops...>) {
+	return { SpecializeEntry<ConstInstrs, VarInstrs, static_cast<byte>(Ops)>()... };
+}
 
-			return irWithIgnore == opAsByte;
+template <const auto& ConstInstrs, const auto& VarInstrs>
+consteval static InstrTable MakeInstrTable() {
+	return MakeInstrTable<ConstInstrs, VarInstrs>(std::make_index_sequence<256>{});
+}
+
+// Every op code must resolve to exactly one handler, except the unused ones which must
+// resolve to none. The only allowed overlap is halt, which replaces ld [hl], [hl].
+template <typename ConstInstrs, typename VarInstrs, std::size_t K>
+consteval static bool ResolvesUniquely(const ConstInstrs& constInstrs, const VarInstrs& varInstrs,
+									   const std::array<byte, K>& invalidInstrs)
+{
+	for (std::size_t i = 0; i < 256; ++i) {
+		const byte ir = static_cast<byte>(i);
+
+		const std::size_t constCount = CountMatches(constInstrs, ir);
+		const std::size_t varCount = CountMatches(varInstrs, ir);
+
+		if (std::ranges::find(invalidInstrs, ir) != invalidInstrs.end()) {
+			if (constCount + varCount != 0)
+				return false;
+
+			continue;
 		}
-	);
 
-	// Couldn't find a valid instruction, something went wrong.
-	if (it == cbInstrMap.end()) {
-		debug::cexpr::forceprinterr("Couldn't find instruction! ");
-		debug::cexpr::forceprinterr("Op Code (ir): {:#010b} ({:#04x})\n", cpu.ir, cpu.ir);
+		if (constCount > 1 || (constCount == 1 && varCount != 0 && ir != OpCode::halt))
+			return false;
 
-		cpu.Hang();
-		return;
+		if (constCount == 0 && varCount != 1)
+			return false;
 	}
 
+	return true;
+}
+
+static_assert(ResolvesUniquely(constInstrMap, variableInstrMap, InvalidInstrs),
+			  "An op code doesn't resolve to exactly one handler!");
+static_assert(ResolvesUniquely(noInstrs, cbInstrMap, std::array<byte, 0>{}),
+			  "A cb op code doesn't resolve to exactly one handler!");
+
+// Decoding an instruction is a single indexed load into one of these tables.
+static constexpr InstrTable mainInstrTable = MakeInstrTable<constInstrMap, variableInstrMap>();
+static constexpr InstrTable cbInstrTable = MakeInstrTable<noInstrs, cbInstrMap>();
+#pragma endregion dispatch table generation
+
+// Uses cbInstrTable, similar to Context::Fetch but just for cb prefixed instructions.
+INSTR cb_prefix(Context& cpu, Memory& mem) {
+	PRINTFUNC();
+
+	cpu.ir = Read(cpu, mem);
+
+	// Every cb op code is valid, there's no need to check for a missing handler.
+	const InstrEntry& entry = cbInstrTable[cpu.ir];
+
 #ifdef DEBUG
 	if (cpu.longDump)
 		debug::cexpr::println("Op Code (ir): {:#010b} ({:#04x})\tFound: {:#010b} ({:#04x})",
-							cpu.ir, cpu.ir, static_cast<byte>(it->op), static_cast<byte>(it->op));
+							cpu.ir, cpu.ir, static_cast<byte>(entry.op), static_cast<byte>(entry.op));
 #endif // DEBUG
 
-	auto handler = it->handler;
-	handler(cpu, mem);
+	entry.handler(cpu, mem);
 }
 
-#undef INSTR
-#undef INSTRMAP
 
-bool Context::Fetch() {
-	namespace rng = std::ranges;
+#pragma region alu tables
+// The alu tables replace the formulas in AluTables.hpp, so they have to give the same flags for every possible input.
+// Split up by lhs since compilers limit how much work a single constant expression can do.
+consteval static bool AddSubTablesMatch(byte carry, byte lhs) {
+	for (int rhs = 0; rhs < 0x100; ++rhs) {
+		const byte r = static_cast<byte>(rhs);
 
-	ir = _memory[reg.pc++];
-	MCycle();
+		if (alu::addTable[alu::AluIndex(lhs + r + carry, lhs, r)] != alu::AddFlags(lhs, r, carry))
+			return false;
 
-	OpCode opCode = static_cast<OpCode>(ir);
+		if (alu::subTable[alu::AluIndex(lhs - r - carry, lhs, r)] != alu::SubFlags(lhs, r, carry))
+			return false;
+	}
 
-	// Make sure it's not a undefined op code
-	if (rng::contains(InvalidInstrs, ir)) {
-		Hang();
+	return true;
+}
+
+template <byte Carry, std::size_t... Lhs>
+consteval static bool AddSubTablesMatch(std::index_sequence<Lhs...>) {
+	return (AddSubTablesMatch(Carry, static_cast<byte>(Lhs)) && ...);
+}
+
+consteval static bool IncDecTablesMatch() {
+	for (int val = 0; val < 0x100; ++val) {
+		const byte inc = static_cast<byte>(val + 1);
+		const byte dec = static_cast<byte>(val - 1);
+
+		if (alu::incTable[inc] != alu::MakeFlags(inc == 0, false, (val & 0x0F) + 1 >= 0x10, false))
+			return false;
+
+		if (alu::decTable[dec] != alu::MakeFlags(dec == 0, true, (val & 0x0F) - 1 < 0, false))
+			return false;
+	}
+
+	return true;
+}
+
+consteval static bool DaaTableMatches() {
+	for (int a = 0; a < 0x100; ++a) {
+		for (byte nhc = 0; nhc < 8; ++nhc) {
+			const bool n = nhc & 0b100, h = nhc & 0b010, c = nhc & 0b001;
+			const auto [resA, resF] = alu::Daa(static_cast<byte>(a), n, h, c);
+
+			if (alu::daaTable[alu::DaaIndex(static_cast<byte>(a), n, h, c)] != (resA << 8 | resF))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static_assert(AddSubTablesMatch<0>(std::make_index_sequence<0x100>{}), "add/sub flag tables don't match the formulas without a carry!");
+static_assert(AddSubTablesMatch<1>(std::make_index_sequence<0x100>{}), "add/sub flag tables don't match the formulas with a carry!");
+static_assert(IncDecTablesMatch(), "inc/dec flag table doesn't match the formulas!");
+static_assert(DaaTableMatches(), "daa table doesn't match the formula!");
+#pragma endregion alu tables
+
+#pragma region fused instructions
+// Runs one instruction of a fused sequence the same way Fetch and Exec would, after finishing the one before it.
+// The first instruction of a sequence was already fetched normally. Returns false if an interrupt was taken instead.
+template <byte Op>
+static bool ExecFused(Context& cpu, Memory& mem, byte immediate) {
+	static_assert(mainInstrTable[Op].handler != nullptr && instrInfo[Op].length <= 2);
+
+	if (!cpu.EndFusedStep())
 		return false;
+
+	cpu.ir = Op;
+	cpu.imm[0] = immediate;
+	++cpu.reg.pc;
+	cpu.MCycle();
+
+	mainInstrTable[Op].handler(cpu, mem);
+	return true;
+}
+
+// ldh a, [imm8]; cp/and imm8; jr z/nz, imm8
+// Only the first instruction reads memory, so the hardware can't tell the difference.
+template <byte AluOp, byte JrOp>
+INSTR fused_poll(Context& cpu, Memory& mem) {
+	PRINTFUNC();
+
+	const byte aluImm = cpu.imm[1];
+	const byte jrImm = cpu.imm[2];
+
+	ldh_acc_ffimm8(cpu, mem);
+	if (!ExecFused<AluOp>(cpu, mem, aluImm) || !ExecFused<JrOp>(cpu, mem, jrImm))
+		return;
+
+	cpu.CountFusion(Fusion::POLL);
+}
+
+// dec r8; jr nz, imm8
+template <byte DecOp>
+INSTR fused_dec_jr(Context& cpu, Memory& mem) {
+	PRINTFUNC();
+
+	const byte jrImm = cpu.imm[0];
+
+	dec_r8<DecOp>(cpu, mem);
+	if (!ExecFused<0x20>(cpu, mem, jrImm))
+		return;
+
+	cpu.CountFusion(Fusion::DEC_JR);
+}
+
+// ld a, [hl+]; ld [de], a
+// Only used when de is in ram that nothing but the cpu touches, see CanFuse.
+INSTR fused_copy(Context& cpu, Memory& mem) {
+	PRINTFUNC();
+
+	ld_acc_r16mem<0x2A>(cpu, mem);
+	if (!ExecFused<0x12>(cpu, mem, 0))
+		return;
+
+	cpu.CountFusion(Fusion::COPY);
+}
+
+struct FusedInstr {
+	Context::InstrFunc handler = nullptr;
+	Fusion fusion = Fusion::COUNT;
+	byte length = 0;
+	std::array<byte, 4> imm{};
+};
+
+// Looks for a sequence starting at addr that can be fused.
+// The whole sequence has to fit in one cache slot so a write to any part of it invalidates it.
+static FusedInstr FindFusion(const DecodeCache& cache, Memory& mem, u16 addr) {
+	const auto fits = [&](byte length) { return cache.CanStore(mem, addr, length); };
+	const auto peek = [&](byte offset) -> byte { return mem[static_cast<u16>(addr + offset)]; };
+
+	static constexpr auto decJrHandlers = std::to_array<Context::InstrFunc>({
+		&fused_dec_jr<0x05>, &fused_dec_jr<0x0D>, &fused_dec_jr<0x15>, &fused_dec_jr<0x1D>,
+		&fused_dec_jr<0x25>, &fused_dec_jr<0x2D>, nullptr /* dec [hl] */, &fused_dec_jr<0x3D>
+	});
+
+	const byte op = peek(0);
+
+	// ldh a, [imm8]; cp/and imm8; jr z/nz, imm8
+	if (op == 0xF0 && fits(6)) {
+		const byte aluOp = peek(2);
+		const byte jrOp = peek(4);
+
+		Context::InstrFunc handler = nullptr;
+		if (aluOp == 0xFE && jrOp == 0x20) handler = &fused_poll<0xFE, 0x20>;
+		else if (aluOp == 0xFE && jrOp == 0x28) handler = &fused_poll<0xFE, 0x28>;
+		else if (aluOp == 0xE6 && jrOp == 0x20) handler = &fused_poll<0xE6, 0x20>;
+		else if (aluOp == 0xE6 && jrOp == 0x28) handler = &fused_poll<0xE6, 0x28>;
+
+		if (handler)
+			return { handler, Fusion::POLL, 6, { peek(1), peek(3), peek(5) } };
+	}
+	// dec r8; jr nz, imm8
+	else if ((op & 0b11'000'111) == 0b00'000'101 && fits(3) && peek(1) == 0x20) {
+		if (Context::InstrFunc handler = decJrHandlers[(op >> 3) & 0b111]; handler)
+			return { handler, Fusion::DEC_JR, 3, { peek(2) } };
 	}
+	// ld a, [hl+]; ld [de], a
+	else if (op == 0x2A && fits(2) && peek(1) == 0x12)
+		return { &fused_copy, Fusion::COPY, 2 };
 
-	// First, check if it's a non-variable instruction
-	if (auto it = constInstrMap.find(opCode); it != constInstrMap.end()) {
-#ifdef DEBUG
-		if (longDump)
-			debug::cexpr::println("Op Code (ir): {:#010b} ({:#04x})\tFound: {:#010b} ({:#04x})",
-								ir, ir, static_cast<byte>(it->first), static_cast<byte>(it->first));
-#endif // DEBUG
+	return {};
+}
+
+bool Context::CanFuse([[maybe_unused]] const DecodedInstr& decoded) const {
+#ifdef OPCODE_PROFILER
+	// Every instruction is counted on its own.
+	return false;
+#else
+	if (!_fusionEnabled || IsTracing())
+		return false;
+
+	// Interrupts are checked between every instruction. That only sees what the hardware requested in the
+	// middle of a sequence if it can catch up there.
+	if ((_ime || _enablingIME) && !_memory.CanCatchUp())
+		return false;
 
-		_handler = it->second;
+	// The write happens before the rest of the hardware catches up, which can only go unnoticed in
+	// ram that nothing but the cpu touches.
+	if (decoded.fusion == Fusion::COPY && Memory::CodeRamIndex(reg.de()) == Memory::noCodeRamIndex)
+		return false;
+
+	if (_debugPages.none()) [[likely]]
 		return true;
+
+	const u16 last = reg.pc + decoded.fusedLength - 1;
+	if (_debugPages.test(reg.pc >> 8) || _debugPages.test(last >> 8))
+		return false;
+
+	switch (decoded.fusion) {
+	case Fusion::POLL: return !_debugPages.test(0xFF);
+	case Fusion::COPY: return !_debugPages.test(reg.h()) && !_debugPages.test(reg.d());
+	default: return true;
 	}
+#endif // OPCODE_PROFILER
+}
+#pragma endregion fused instructions
 
-	// If not found, it's a variable instruction.
-	auto it = rng::find_if(
-		variableInstrMap,
-		[this](const VariableInstrData& data) {
-			byte opAsByte = static_cast<byte>(data.op);
-			byte irWithIgnore = ir & ~data.ignoreBits;
-
-			/* ex:		ir == 0b00'01'0001
-			*			op == 0b00'00'0001
-			*	ignoreBits == 0b00'11'0000 (2s complement: 0b11'00'1111)
-			* irWithIgnore == 0b00'00'0001
-			*		   res == 0b00'00'0001
-			* res == op <-- instruction found
-			*/
-			return irWithIgnore == opAsByte;
+#undef INSTR
+#undef INSTRMAP
+#undef INSTRDATA
+
+bool Context::Fetch() {
+	auto [slot, version] = _decodeCache.Slot(_memory, reg.pc);
+
+	_isFused = false;
+
+	if (slot && slot->handler && slot->version == version) [[likely]] {
+		ir = slot->ir;
+		imm = slot->imm;
+		_handler = slot->handler;
+
+		if (slot->fused && CanFuse(*slot)) {
+			_handler = slot->fused;
+			_isFused = true;
 		}
-	);
+	}
+	else {
+		ir = _memory[reg.pc];
 
-	// Couldn't find a valid instruction, something went wrong.
-	if (it == variableInstrMap.end()) {
-		debug::cexpr::forceprinterr("Couldn't find instruction! ");
-		debug::cexpr::forceprinterr("Op Code (ir): {:#010b} ({:#04x})\n", ir, ir);
+		const InstrEntry& entry = mainInstrTable[ir];
 
-		Hang();
-		return false;
+		// Unused op codes don't have a handler. The cpu should hang.
+		if (!entry.handler) [[unlikely]] {
+			debug::cexpr::forceprinterr("Couldn't find instruction! ");
+			debug::cexpr::forceprinterr("Op Code (ir): {:#010b} ({:#04x})\n", ir, ir);
+
+			Hang();
+			return false;
+		}
+
+		// Immediates are read here instead of in the handlers so they can be cached with the op code.
+		const byte length = instrInfo[ir].length;
+		for (byte i = 1; i < length; ++i)
+			imm[i - 1] = _memory[static_cast<u16>(reg.pc + i)];
+
+		_handler = entry.handler;
+
+		if (slot && _decodeCache.CanStore(_memory, reg.pc, length)) {
+			*slot = { entry.handler, nullptr, version, imm, ir, length };
+
+			// Fused sequences only get used once the code runs again from the cache.
+			if (FusedInstr fused = FindFusion(_decodeCache, _memory, reg.pc); fused.handler) {
+				slot->fused = fused.handler;
+				slot->imm = fused.imm;
+				slot->fusedLength = fused.length;
+				slot->fusion = fused.fusion;
+			}
+		}
 	}
 
 #ifdef DEBUG
-	if (longDump)
-		debug::cexpr::println("Op Code (ir): {:#010b} ({:#04x})\tFound: {:#010b} ({:#04x})",
-							  ir, ir, static_cast<byte>(it->op), static_cast<byte>(it->op));
+	if (longDump) {
+		const byte op = static_cast<byte>(mainInstrTable[ir].op);
+		debug::cexpr::println("Op Code (ir): {:#010b} ({:#04x})\tFound: {:#010b} ({:#04x})", ir, ir, op, op);
+	}
 #endif // DEBUG
 
-	// Store a function pointer rather than updating the ir
-	// because some instructions have variable op codes. The ir still holds the bits
-	// to determine what register / data / condition needs to be used.
-	_handler = it->handler;
+	++reg.pc;
+	MCycle();
 
 	return true;
 }
 
+Context::InstrFunc Context::MainHandler(byte op) {
+	return mainInstrTable[op].handler;
+}
+
+std::string_view Context::InstrName(byte op, bool prefixed) {
+	return prefixed ? cbInstrTable[op].name : mainInstrTable[op].name;
+}
+
+OpCode Context::InstrOp(byte op, bool prefixed) {
+	return prefixed ? cbInstrTable[op].op : mainInstrTable[op].op;
+}
+
 bool Context::Exec() {
 	if (!_handler) {
 		debug::cexpr::println("Invalid instruction!");
 		return false;
 	}
 
+#ifdef OPCODE_PROFILER
+	const byte op = ir;
 	_handler(*this, _memory);
 
+	// cb_prefix leaves the cb op code in ir.
+	_profiler.Count(op, ir, _mCycles);
+#else
+	_handler(*this, _memory);
+#endif
+
+	return true;
+}
+
+// Expands X(hi, lo) for every op code from 0x00 to 0xFF.
+#define OPROW(X, hi) \
+	X(hi, 0) X(hi, 1) X(hi, 2) X(hi, 3) X(hi, 4) X(hi, 5) X(hi, 6) X(hi, 7) \
+	X(hi, 8) X(hi, 9) X(hi, A) X(hi, B) X(hi, C) X(hi, D) X(hi, E) X(hi, F)
+#define OPTABLE(X) \
+	OPROW(X, 0) OPROW(X, 1) OPROW(X, 2) OPROW(X, 3) OPROW(X, 4) OPROW(X, 5) OPROW(X, 6) OPROW(X, 7) \
+	OPROW(X, 8) OPROW(X, 9) OPROW(X, A) OPROW(X, B) OPROW(X, C) OPROW(X, D) OPROW(X, E) OPROW(X, F)
+
+#pragma region recompiled code
+namespace recomp {
+
+template <byte Op>
+void Exec(Context& cpu, Memory& mem, u16 immediate) {
+	constexpr Context::InstrFunc handler = mainInstrTable[Op].handler;
+
+	// gbrecomp leaves unused op codes to the interpreter, this is only here so every op code can be instantiated.
+	if constexpr (!handler)
+		cpu.Hang();
+	else {
+		cpu.ir = Op;
+		cpu.imm[0] = static_cast<byte>(immediate & 0xFF);
+		cpu.imm[1] = static_cast<byte>(immediate >> 8);
+		++cpu.reg.pc;
+		cpu.MCycle();
+
+		handler(cpu, mem);
+	}
+}
+
+#define RECOMPEXEC(hi, lo) template void Exec<0x##hi##lo>(Context& cpu, Memory& mem, u16 immediate);
+OPTABLE(RECOMPEXEC)
+#undef RECOMPEXEC
+
+} // namespace recomp
+#pragma endregion recompiled code
+
+#ifdef THREADED_DISPATCH
+#pragma region threaded dispatch
+#define OPLABEL(hi, lo) op_##hi##lo
+#define OPADDRESS(hi, lo) &&OPLABEL(hi, lo),
+
+// Finishes the current instruction the same way Update does, then fetches the next one and
+// jumps straight to its label. Cycles add up across instructions until the hardware could have
+// changed something the cpu sees (see CanDeferSync), so it's synced every few instructions at most.
+#define DISPATCHNEXT() \
+	do { \
+		if (_ime & (_memory.PendingInterrupts() != 0)) [[unlikely]] \
+			InterruptHandler(); \
+		else if (_enablingIME) \
+			_ime = true; \
+		\
+		if (!CanDeferSync() || cyclesRan + _mCycles >= cycleBudget) [[unlikely]] { \
+			cyclesRan += _mCycles; \
+			if (const SyncResult synced = sync(owner, std::exchange(_mCycles, 0)); synced != SyncResult::CONTINUE) [[unlikely]] \
+				return synced == SyncResult::STOP; \
+			\
+			if (cyclesRan >= cycleBudget || _isHalted || _skipCycles != 0) [[unlikely]] \
+				goto leave; \
+		} \
+		\
+		if (!Fetch()) [[unlikely]] \
+			return false; \
+		goto *(_isFused ? &&op_fused : labels[ir]); \
+	} while (false)
+
+// Every handler is known at compile time, so it can be inlined straight into its label.
+#define OPHANDLER(hi, lo) \
+	OPLABEL(hi, lo): \
+		if constexpr (constexpr Context::InstrFunc handler = mainInstrTable[0x##hi##lo].handler; handler) { \
+			handler(*this, _memory); \
+			DISPATCHNEXT(); \
+		} \
+		else \
+			goto invalid;
+
+bool Context::Run(u64 cycleBudget, SyncFunc sync, void* owner) {
+	static void* const labels[256] = { OPTABLE(OPADDRESS) };
+
+	u64 cyclesRan = 0;
+
+	// The hardware was synced at the end of the last update. What it said was quiet then may not be anymore.
+	// Nothing is ever left unsynced at the top of the loop, DISPATCHNEXT only defers when it keeps going.
+	_quietCycles = 0;
+
+	while (cyclesRan < cycleBudget) {
+		// Halting, skipping, breakpoints, and dumping or checking state all go through the regular update path.
+		bool useUpdate = _isHalted || _skipCycles != 0 || IsTracing() || HasBreakCheck();
+#ifdef OPCODE_PROFILER
+		useUpdate = true;
+#endif
+
+		if (useUpdate) {
+			if (!Update())
+				return false;
+
+			cyclesRan += _mCycles;
+			if (const SyncResult synced = sync(owner, _mCycles); synced != SyncResult::CONTINUE)
+				return synced == SyncResult::STOP;
+
+			continue;
+		}
+
+		_mCycles = 0;
+		if (!Fetch())
+			return false;
+		goto *(_isFused ? &&op_fused : labels[ir]);
+
+		OPTABLE(OPHANDLER)
+
+	op_fused:
+		_handler(*this, _memory);
+		DISPATCHNEXT();
+
+	leave:
+		continue;
+
+	invalid:
+		debug::cexpr::forceprinterr("Couldn't find instruction! ");
+		debug::cexpr::forceprinterr("Op Code (ir): {:#010b} ({:#04x})\n", ir, ir);
+
+		Hang();
+		return false;
+	}
+
 	return true;
 }
 
+#undef OPLABEL
+#undef OPADDRESS
+#undef DISPATCHNEXT
+#undef OPHANDLER
+#pragma endregion threaded dispatch
+#endif // THREADED_DISPATCH
+
+#undef OPROW
+#undef OPTABLE
+
 } // namespace gb::cpu
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <format>
+#include <map>
+#include <print>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "CallProfiler.hpp"
+
+namespace gb {
+
+// Mcycles in a frame, to turn totals into time per frame.
+static constexpr double frameCycles = 70224 / 4;
+
+// Above every address a return address can be pushed to.
+static constexpr u32 rootSp = 0x10000;
+
+CallProfiler::CallProfiler(std::optional<SymbolTable> symbols)
+	: _symbols(std::move(symbols))
+{
+	Reset();
+}
+
+void CallProfiler::Reset() {
+	_stack.clear();
+	_functions.clear();
+
+	_stack.push_back({ rootKey, rootSp, _now });
+
+	Function& root = _functions[rootKey];
+	root.calls = 1;
+	root.active = 1;
+}
+
+void CallProfiler::Call(u16 bank, u16 addr, u16 sp, u64 offset) {
+	const u64 now = _now + offset;
+
+	while (_stack.back().sp <= sp)
+		Pop(_stack, _functions, now);
+
+	const Key key = MakeKey(bank, addr);
+	++_functions[_stack.back().key].callees[key].calls;
+
+	Function& function = _functions[key];
+	++function.calls;
+	++function.active;
+
+	_stack.push_back({ key, sp, now });
+}
+
+void CallProfiler::Return(u16 sp, u64 offset) {
+	// The root never returns.
+	const auto frame = std::ranges::find(_stack.begin() + 1, _stack.end(), static_cast<u32>(sp), &Frame::sp);
+	if (frame == _stack.end())
+		return;
+
+	const std::size_t depth = static_cast<std::size_t>(frame - _stack.begin());
+	const u64 now = _now + offset;
+
+	while (_stack.size() > depth)
+		Pop(_stack, _functions, now);
+}
+
+void CallProfiler::Pop(std::vector<Frame>& stack, Functions& functions, u64 now) {
+	const Frame frame = stack.back();
+	stack.pop_back();
+
+	const u64 inclusive = now - frame.entered;
+
+	Function& function = functions[frame.key];
+	function.exclusive += inclusive - frame.children;
+	if (--function.active == 0)
+		function.inclusive += inclusive;
+
+	if (stack.empty())
+		return;
+
+	stack.back().children += inclusive;
+	functions[stack.back().key].callees[frame.key].inclusive += inclusive;
+}
+
+CallProfiler::Functions CallProfiler::Snapshot() const {
+	std::vector<Frame> stack = _stack;
+	Functions functions = _functions;
+
+	while (!stack.empty())
+		Pop(stack, functions, _now);
+
+	return functions;
+}
+
+std::string CallProfiler::Name(Key key) const {
+	if (key == rootKey)
+		return "(outside any call)";
+
+	const u16 bank = static_cast<u16>(key >> 16);
+	const u16 addr = static_cast<u16>(key);
+	return _symbols ? _symbols->Resolve(bank, addr) : std::format("${:02X}:{:04X}", bank, addr);
+}
+
+void CallProfiler::WriteText(std::ostream& out) const {
+	const Functions functions = Snapshot();
+
+	std::vector<std::pair<Key, const Function*>> rows;
+	for (const auto& [key, function] : functions)
+		rows.emplace_back(key, &function);
+
+	std::ranges::sort(rows, [](const auto& lhs, const auto& rhs) {
+		return lhs.second->inclusive != rhs.second->inclusive ? lhs.second->inclusive > rhs.second->inclusive : lhs.first < rhs.first;
+	});
+
+	const u64 total = std::max<u64>(functions.at(rootKey).inclusive, 1);
+	const double frames = total / frameCycles;
+
+	std::println(out, "{} mcycles ({:.0f} frames) in {} functions, {} symbols loaded",
+				 total, frames, functions.size() - 1, _symbols ? _symbols->Size() : 0);
+	std::println(out, "");
+	std::println(out, "{:<40}{:>10}{:>14}{:>8}{:>14}{:>8}{:>16}", "function", "calls", "inclusive", "%", "exclusive", "%", "incl/frame");
+
+	for (const auto& [key, function] : rows) {
+		std::println(out, "{:<40}{:>10}{:>14}{:>7.2f}%{:>14}{:>7.2f}%{:>16.1f}",
+					 Name(key), function->calls,
+					 function->inclusive, 100.0 * function->inclusive / total,
+					 function->exclusive, 100.0 * function->exclusive / total,
+					 function->inclusive / std::max(frames, 1.0));
+	}
+}
+
+void CallProfiler::WriteCallgrind(std::ostream& out, std::string_view command) const {
+	const Functions functions = Snapshot();
+
+	// Sorted so the same run always writes the same file.
+	const std::map<Key, const Function*> sorted = [&] {
+		std::map<Key, const Function*> map;
+		for (const auto& [key, function] : functions)
+			map.emplace(key, &function);
+
+		return map;
+	}();
+
+	// Names are written out the first time and only referred to by id after that.
+	std::map<Key, std::size_t> ids;
+	std::set<u16> namedFiles;
+
+	auto fileOf = [&](Key key) {
+		const u16 bank = key == rootKey ? 0 : static_cast<u16>(key >> 16);
+		return namedFiles.insert(bank).second ? std::format("({}) bank ${:02X}", bank, bank) : std::format("({})", bank);
+	};
+
+	auto nameOf = [&](Key key) {
+		const auto [it, added] = ids.try_emplace(key, ids.size() + 1);
+		return added ? std::format("({}) {}", it->second, Name(key)) : std::format("({})", it->second);
+	};
+
+	// Positions are addresses, and the root is at the entry point.
+	auto position = [](Key key) { return key == rootKey ? u16{ 0x0100 } : static_cast<u16>(key); };
+
+	std::println(out, "# callgrind format");
+	std::println(out, "version: 1");
+	std::println(out, "creator: gbemu");
+	std::println(out, "cmd: {}", command);
+	std::println(out, "positions: instr");
+	std::println(out, "events: MCycles");
+	std::println(out, "summary: {}", functions.at(rootKey).inclusive);
+
+	for (const auto& [key, function] : sorted) {
+		std::println(out, "");
+		std::println(out, "fl={}", fileOf(key));
+		std::println(out, "fn={}", nameOf(key));
+		std::println(out, "0x{:04X} {}", position(key), function->exclusive);
+
+		const std::map<Key, Edge> callees{ function->callees.begin(), function->callees.end() };
+		for (const auto& [callee, edge] : callees) {
+			std::println(out, "cfi={}", fileOf(callee));
+			std::println(out, "cfn={}", nameOf(callee));
+			std::println(out, "calls={} 0x{:04X}", edge.calls, position(callee));
+			std::println(out, "0x{:04X} {}", position(key), edge.inclusive);
+		}
+	}
+}
+
+} // namespace gb
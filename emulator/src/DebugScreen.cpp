@@ -1,5 +1,10 @@
 #ifdef DEBUG
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_opengl3.h>
@@ -9,6 +14,7 @@
 #include <glm/vec2.hpp>
 
 #include "DebugScreen.hpp"
+#include "Disasm.hpp"
 #include "Memory.hpp"
 
 /*
@@ -26,6 +32,7 @@ namespace gb {
 namespace debug {
 
 static const Memory* debugMem = nullptr;
+static std::unique_ptr<disasm::Cache> disasmCache;
 static constexpr float DebugScale = 3;
 
 // gb colors
@@ -37,6 +44,7 @@ static constexpr ImColor colors[4] = {
 };
 
 static void VRAMViewer();
+static void DisassemblyViewer();
 static void ScreenViewer();
 
 void InitDebugScreen(GLFWwindow* emuWindow, const Memory* mem) {
@@ -44,6 +52,7 @@ void InitDebugScreen(GLFWwindow* emuWindow, const Memory* mem) {
 		return; // avoid being called twice
 
 	debugMem = mem;
+	disasmCache = std::make_unique<disasm::Cache>(*mem);
 
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -74,6 +83,7 @@ void UpdateDebugScreenBegin() {
 	ImGui::ShowMetricsWindow();
 
 	VRAMViewer();
+	DisassemblyViewer();
 
 	ImGui::Render();
 }
@@ -123,6 +133,70 @@ static void VRAMViewer() {
 	ImGui::End();
 }
 
+static void DisassemblyViewer() {
+	enum Area : int { ROM, WRAM, HRAM };
+	static constexpr const char* areaNames[] = { "ROM", "WRAM", "HRAM" };
+
+	static int area = ROM;
+	static int bank = 0;
+	static int goTo = -1;
+
+	if (!ImGui::Begin("Disassembly")) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::SetNextItemWidth(80.f);
+	ImGui::Combo("##area", &area, areaNames, IM_ARRAYSIZE(areaNames));
+
+	if (area == ROM) {
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(100.f);
+		ImGui::InputInt("Bank", &bank);
+		bank = std::clamp(bank, 0, std::max(disasmCache->RomBanks() - 1, 0));
+	}
+
+	static char goToText[5] = "";
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(60.f);
+	if (ImGui::InputText("Go to", goToText, sizeof(goToText), ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue))
+		goTo = static_cast<int>(std::strtol(goToText, nullptr, 16));
+
+	// Only ever disassembled again when the bytes change, not every frame.
+	const std::vector<disasm::Line>& lines = area == ROM ? disasmCache->RomBank(static_cast<u16>(bank))
+		: area == WRAM ? disasmCache->Wram() : disasmCache->Hram();
+
+	ImGui::BeginChild("##lines");
+
+	const float lineHeight = ImGui::GetTextLineHeightWithSpacing();
+	if (goTo >= 0 && !lines.empty()) {
+		ImGui::SetScrollY(disasm::Cache::Find(lines, static_cast<u16>(goTo)) * lineHeight);
+		goTo = -1;
+	}
+
+	// Only the lines that can be seen get drawn.
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(lines.size()), lineHeight);
+
+	while (clipper.Step()) {
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+			const disasm::Line& line = lines[i];
+
+			// Numbered the same way rgbds does.
+			const int lineBank = area == ROM ? bank : area == WRAM && line.addr >= ram0End ? 1 : 0;
+
+			char bytes[10] = "";
+			for (byte b = 0; b < line.length; ++b)
+				std::snprintf(bytes + b * 3, 4, "%02X ", line.bytes[b]);
+
+			ImGui::Text("%02X:%04X  %-9s %s", lineBank, line.addr, bytes, line.text.c_str());
+		}
+	}
+
+	ImGui::EndChild();
+	ImGui::End();
+}
+
 static void ScreenViewer() {
 
 }
@@ -143,6 +217,8 @@ void ShutdownDebugScreen() {
 	if (!debugMem)
 		return;
 
+	disasmCache.reset();
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
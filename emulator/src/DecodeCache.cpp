@@ -0,0 +1,31 @@
+#include "DecodeCache.hpp"
+
+namespace gb::cpu {
+
+DecodeCache::DecodeCache(std::size_t romSize)
+	: _romPages((romSize + romPageSize - 1) / romPageSize)
+	, _ram(Memory::codeRamSize)
+	, _romSize(romSize)
+{}
+
+bool DecodeCache::CanStore(const Memory& mem, u16 addr, byte length) const {
+	const u16 last = addr + length - 1;
+
+	if (addr < romNEnd) {
+		// must stay in the same rom window, and the rom has to actually contain every byte
+		if (last >= romNEnd || addr / romBankSize != last / romBankSize)
+			return false;
+
+		return mem.RomPhysicalAddr(last) < _romSize;
+	}
+
+	const u16 index = Memory::CodeRamIndex(addr);
+	const u16 lastIndex = Memory::CodeRamIndex(last);
+
+	if (index == Memory::noCodeRamIndex || lastIndex != index + length - 1)
+		return false;
+
+	return index / Memory::codePageSize == lastIndex / Memory::codePageSize;
+}
+
+} // namespace gb::cpu
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <utility>
+
+#include "Disasm.hpp"
+#include "CPU.hpp"
+#include "InstrInfo.hpp"
+
+namespace gb::disasm {
+
+using cpu::OpCode;
+
+// Operands are encoded in the op code bits, in the same order as the gbdev op code tables.
+static constexpr std::array<std::string_view, 8> r8 = { "b", "c", "d", "e", "h", "l", "[hl]", "a" };
+static constexpr std::array<std::string_view, 4> r16 = { "bc", "de", "hl", "sp" };
+static constexpr std::array<std::string_view, 4> r16stk = { "bc", "de", "hl", "af" };
+static constexpr std::array<std::string_view, 4> r16mem = { "[bc]", "[de]", "[hl+]", "[hl-]" };
+static constexpr std::array<std::string_view, 4> cond = { "nz", "z", "nc", "c" };
+
+static std::string SignedOffset(byte offset) {
+	const int val = static_cast<int8_t>(offset);
+	return val < 0 ? std::format("- {}", -val) : std::format("+ {}", val);
+}
+
+static std::string Prefixed(byte op) {
+	const std::string_view reg = r8[op & 0b111];
+	const byte bit = (op >> 3) & 0b111;
+
+	switch (cpu::Context::InstrOp(op, true)) {
+	case OpCode::cb_rlc_r8: return std::format("rlc {}", reg);
+	case OpCode::cb_rrc_r8: return std::format("rrc {}", reg);
+	case OpCode::cb_rl_r8: return std::format("rl {}", reg);
+	case OpCode::cb_rr_r8: return std::format("rr {}", reg);
+	case OpCode::cb_sla_r8: return std::format("sla {}", reg);
+	case OpCode::cb_sra_r8: return std::format("sra {}", reg);
+	case OpCode::cb_swap_r8: return std::format("swap {}", reg);
+	case OpCode::cb_srl_r8: return std::format("srl {}", reg);
+	case OpCode::cb_bit_b3_r8: return std::format("bit {}, {}", bit, reg);
+	case OpCode::cb_res_b3_r8: return std::format("res {}, {}", bit, reg);
+	case OpCode::cb_set_b3_r8: return std::format("set {}, {}", bit, reg);
+	default: return std::format("db $CB, ${:02X}", op);
+	}
+}
+
+static std::string Text(u16 addr, const std::array<byte, 3>& bytes) {
+	const byte op = bytes[0];
+	const byte imm8 = bytes[1];
+	const u16 imm16 = static_cast<u16>(bytes[1] | (bytes[2] << 8));
+
+	const std::string_view dst8 = r8[(op >> 3) & 0b111];
+	const std::string_view src8 = r8[op & 0b111];
+	const std::size_t pair = (op >> 4) & 0b11;
+	const std::string_view cc = cond[(op >> 3) & 0b11];
+
+	// jr is relative to the end of the instruction.
+	const u16 jrTarget = static_cast<u16>(addr + 2 + static_cast<int8_t>(imm8));
+
+	switch (cpu::Context::InstrOp(op)) {
+	case OpCode::nop: return "nop";
+
+	case OpCode::ld_r8_r8: return std::format("ld {}, {}", dst8, src8);
+	case OpCode::ld_r8_imm8: return std::format("ld {}, ${:02X}", dst8, imm8);
+	case OpCode::ld_acc_r16mem: return std::format("ld a, {}", r16mem[pair]);
+	case OpCode::ld_r16mem_acc: return std::format("ld {}, a", r16mem[pair]);
+	case OpCode::ld_acc_imm16: return std::format("ld a, [${:04X}]", imm16);
+	case OpCode::ld_imm16_acc: return std::format("ld [${:04X}], a", imm16);
+	case OpCode::ldh_acc_ffc: return "ldh a, [c]";
+	case OpCode::ldh_ffc_acc: return "ldh [c], a";
+	case OpCode::ldh_acc_ffimm8: return std::format("ldh a, [$FF{:02X}]", imm8);
+	case OpCode::ldh_ffimm8_acc: return std::format("ldh [$FF{:02X}], a", imm8);
+
+	case OpCode::ld_r16_imm16: return std::format("ld {}, ${:04X}", r16[pair], imm16);
+	case OpCode::ld_imm16_sp: return std::format("ld [${:04X}], sp", imm16);
+	case OpCode::ld_sp_hl: return "ld sp, hl";
+	case OpCode::ld_hl_spimm8: return std::format("ld hl, sp {}", SignedOffset(imm8));
+	case OpCode::push_r16stk: return std::format("push {}", r16stk[pair]);
+	case OpCode::pop_r16stk: return std::format("pop {}", r16stk[pair]);
+
+	case OpCode::add_r8: return std::format("add a, {}", src8);
+	case OpCode::add_imm8: return std::format("add a, ${:02X}", imm8);
+	case OpCode::adc_r8: return std::format("adc a, {}", src8);
+	case OpCode::adc_imm8: return std::format("adc a, ${:02X}", imm8);
+	case OpCode::sub_r8: return std::format("sub a, {}", src8);
+	case OpCode::sub_imm8: return std::format("sub a, ${:02X}", imm8);
+	case OpCode::sbc_r8: return std::format("sbc a, {}", src8);
+	case OpCode::sbc_imm8: return std::format("sbc a, ${:02X}", imm8);
+	case OpCode::cp_r8: return std::format("cp a, {}", src8);
+	case OpCode::cp_imm8: return std::format("cp a, ${:02X}", imm8);
+	case OpCode::inc_r8: return std::format("inc {}", dst8);
+	case OpCode::dec_r8: return std::format("dec {}", dst8);
+	case OpCode::and_r8: return std::format("and a, {}", src8);
+	case OpCode::and_imm8: return std::format("and a, ${:02X}", imm8);
+	case OpCode::or_r8: return std::format("or a, {}", src8);
+	case OpCode::or_imm8: return std::format("or a, ${:02X}", imm8);
+	case OpCode::xor_r8: return std::format("xor a, {}", src8);
+	case OpCode::xor_imm8: return std::format("xor a, ${:02X}", imm8);
+	case OpCode::ccf: return "ccf";
+	case OpCode::scf: return "scf";
+	case OpCode::daa: return "daa";
+	case OpCode::cpl: return "cpl";
+
+	case OpCode::inc_r16: return std::format("inc {}", r16[pair]);
+	case OpCode::dec_r16: return std::format("dec {}", r16[pair]);
+	case OpCode::add_hl_r16: return std::format("add hl, {}", r16[pair]);
+	case OpCode::add_sp_imm8: return std::format("add sp, {}", static_cast<int8_t>(imm8));
+
+	case OpCode::rlca: return "rlca";
+	case OpCode::rrca: return "rrca";
+	case OpCode::rla: return "rla";
+	case OpCode::rra: return "rra";
+	case OpCode::cb_prefix: return Prefixed(imm8);
+
+	case OpCode::jp_imm16: return std::format("jp ${:04X}", imm16);
+	case OpCode::jp_hl: return "jp hl";
+	case OpCode::jp_cond_imm16: return std::format("jp {}, ${:04X}", cc, imm16);
+	case OpCode::jr_imm8: return std::format("jr ${:04X}", jrTarget);
+	case OpCode::jr_cond_imm8: return std::format("jr {}, ${:04X}", cc, jrTarget);
+	case OpCode::call_imm16: return std::format("call ${:04X}", imm16);
+	case OpCode::call_cond_imm16: return std::format("call {}, ${:04X}", cc, imm16);
+	case OpCode::ret: return "ret";
+	case OpCode::ret_cond: return std::format("ret {}", cc);
+	case OpCode::reti: return "reti";
+	case OpCode::rst_tgt3: return std::format("rst ${:02X}", op & 0b00'111'000);
+
+	case OpCode::stop: return "stop";
+	case OpCode::halt: return "halt";
+	case OpCode::di: return "di";
+	case OpCode::ei: return "ei";
+
+	default: return std::format("db ${:02X}", op);
+	}
+}
+
+Line Disassemble(u16 addr, const std::array<byte, 3>& bytes) {
+	return { addr, cpu::instrInfo[bytes[0]].length, bytes, Text(addr, bytes) };
+}
+
+// Disassembles from addr until reaching to, or until landing on the start of a line in resync at or after
+// resyncFrom. Bytes past end read as 0. Returns the index of the line in resync it landed on, or resync.size().
+template <typename Peek>
+static std::size_t Sweep(u32 addr, u32 to, u32 end, Peek&& peek, std::vector<Line>& out,
+						 const std::vector<Line>& resync = {}, u32 resyncFrom = 0)
+{
+	std::size_t next = std::ranges::lower_bound(resync, resyncFrom, {}, &Line::addr) - resync.begin();
+
+	while (addr < to) {
+		while (next < resync.size() && resync[next].addr < addr)
+			++next;
+
+		if (next < resync.size() && addr >= resyncFrom && resync[next].addr == addr)
+			return next;
+
+		std::array<byte, 3> bytes{};
+		for (u32 i = 0; i < bytes.size() && addr + i < end; ++i)
+			bytes[i] = peek(static_cast<u16>(addr + i));
+
+		out.push_back(Disassemble(static_cast<u16>(addr), bytes));
+		addr += out.back().length;
+	}
+
+	return resync.size();
+}
+
+Cache::Cache(const Memory& mem)
+	: _mem(mem)
+{}
+
+const std::vector<Line>& Cache::RomBank(u16 bank) {
+	auto [it, added] = _romBanks.try_emplace(bank);
+	std::vector<Line>& lines = it->second;
+
+	if (added && bank < RomBanks()) {
+		const u32 base = bank == 0 ? 0 : romBankSize;
+		auto peek = [&](u16 addr) { return _mem.PeekRom(bank * romBankSize + (addr - base)); };
+
+		Sweep(base, base + romBankSize, base + romBankSize, peek, lines);
+	}
+
+	return lines;
+}
+
+const std::vector<Line>& Cache::Wram() {
+	Refresh(_wram);
+	return _wram.lines;
+}
+
+const std::vector<Line>& Cache::Hram() {
+	Refresh(_hram);
+	return _hram.lines;
+}
+
+std::size_t Cache::Find(const std::vector<Line>& lines, u16 addr) {
+	const auto next = std::ranges::upper_bound(lines, addr, {}, &Line::addr);
+	return next == lines.begin() ? 0 : static_cast<std::size_t>(next - lines.begin() - 1);
+}
+
+void Cache::Refresh(RamArea& area) {
+	static constexpr u16 pageSize = Memory::codePageSize;
+
+	const u16 firstIndex = Memory::CodeRamIndex(area.start);
+	const std::size_t pages = (area.end - area.start + pageSize - 1) / pageSize;
+
+	auto peek = [&](u16 addr) { return _mem.PeekCodeRam(Memory::CodeRamIndex(addr)); };
+
+	if (area.pageVersions.empty()) {
+		area.pageVersions.resize(pages);
+		for (std::size_t page = 0; page < pages; ++page)
+			area.pageVersions[page] = _mem.CodePageVersion(static_cast<u16>(firstIndex + page * pageSize));
+
+		Sweep(area.start, area.end, area.end, peek, area.lines);
+		return;
+	}
+
+	std::size_t firstDirty = pages, lastDirty = 0;
+	for (std::size_t page = 0; page < pages; ++page) {
+		const u32 version = _mem.CodePageVersion(static_cast<u16>(firstIndex + page * pageSize));
+
+		if (std::exchange(area.pageVersions[page], version) != version) {
+			firstDirty = std::min(firstDirty, page);
+			lastDirty = page;
+		}
+	}
+
+	if (firstDirty == pages)
+		return;
+
+	// The line before the first written page can reach into it.
+	const u32 dirtyStart = area.start + static_cast<u32>(firstDirty * pageSize);
+	const u32 dirtyEnd = std::min<u32>(area.start + static_cast<u32>((lastDirty + 1) * pageSize), area.end);
+	const std::size_t first = Find(area.lines, static_cast<u16>(dirtyStart));
+
+	// Lines past the written pages are still right once the sweep starts on one of them again.
+	std::vector<Line> swept;
+	const std::size_t resumed = Sweep(area.lines[first].addr, area.end, area.end, peek, swept, area.lines, dirtyEnd);
+
+	area.lines.erase(area.lines.begin() + first, area.lines.begin() + resumed);
+	area.lines.insert(area.lines.begin() + first, std::make_move_iterator(swept.begin()), std::make_move_iterator(swept.end()));
+}
+
+} // namespace gb::disasm
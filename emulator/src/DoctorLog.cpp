@@ -0,0 +1,135 @@
+#ifdef DEBUG
+#include <algorithm>
+#include <print>
+#include <string_view>
+
+#include "DoctorLog.hpp"
+
+namespace gb::cpu {
+
+// Lines of the log after a divergence to show what was supposed to happen next.
+static constexpr std::size_t linesAfter = 3;
+
+// Formatted by hand since it runs for every instruction.
+static void AppendHex(std::string& out, byte val) {
+	static constexpr std::string_view digits = "0123456789ABCDEF";
+	out.push_back(digits[val >> 4]);
+	out.push_back(digits[val & 0xF]);
+}
+
+static void WriteLine(std::string& out, const std::array<byte, 12>& regs, const std::array<byte, 4>& pcMem) {
+	static constexpr std::array<std::string_view, 10> names = {
+		"A:", " F:", " B:", " C:", " D:", " E:", " H:", " L:", " SP:", " PC:"
+	};
+
+	out.clear();
+
+	for (std::size_t i = 0; i < names.size(); ++i) {
+		out += names[i];
+
+		// sp and pc take two bytes each
+		if (i < 8)
+			AppendHex(out, regs[i]);
+		else {
+			AppendHex(out, regs[8 + (i - 8) * 2]);
+			AppendHex(out, regs[9 + (i - 8) * 2]);
+		}
+	}
+
+	out += " PCMEM:";
+	for (std::size_t i = 0; i < pcMem.size(); ++i) {
+		if (i != 0)
+			out.push_back(',');
+
+		AppendHex(out, pcMem[i]);
+	}
+}
+
+DoctorLog::DoctorLog(const std::filesystem::path& logPath, std::size_t contextLines)
+	: _log(logPath)
+	, _context(std::max<std::size_t>(contextLines, 1))
+{
+	if (!_log)
+		_status = Status::NO_LOG;
+}
+
+std::string DoctorLog::FormatLine(const std::array<byte, 12>& regs, const std::array<byte, 4>& pcMem) {
+	std::string line;
+	WriteLine(line, regs, pcMem);
+	return line;
+}
+
+bool DoctorLog::Check(const std::array<byte, 12>& regs, const std::array<byte, 4>& pcMem) {
+	if (_status != Status::RUNNING)
+		return false;
+
+	if (!std::getline(_log, _line)) {
+		_status = Status::MATCHED;
+		return false;
+	}
+
+	if (!_line.empty() && _line.back() == '\r')
+		_line.pop_back();
+
+	WriteLine(_actual, regs, pcMem);
+
+	if (_line != _actual) [[unlikely]] {
+		_status = Status::DIVERGED;
+
+		for (std::string next; _after.size() < linesAfter && std::getline(_log, next);)
+			_after.push_back(std::move(next));
+
+		return false;
+	}
+
+	// Swapped in so the strings keep their memory.
+	std::swap(_context[_lineNum % _context.size()], _line);
+	++_lineNum;
+
+	return true;
+}
+
+void DoctorLog::PrintReport() const {
+	switch (_status) {
+	case Status::NO_LOG:
+		std::println("The gameboy-doctor log couldn't be opened.");
+		return;
+	case Status::RUNNING:
+		std::println("All {} instructions so far match the log.", _lineNum);
+		return;
+	case Status::MATCHED:
+		std::println("All {} lines of the log matched.", _lineNum);
+		return;
+	case Status::DIVERGED:
+		break;
+	}
+
+	std::println("Diverged from the log at line {}, after {} matching instructions:", _lineNum + 1, _lineNum);
+
+	const u64 shown = std::min<u64>(_lineNum, _context.size());
+	for (u64 lineNum = _lineNum - shown; lineNum < _lineNum; ++lineNum)
+		std::println("{:>10}   {}", lineNum + 1, _context[lineNum % _context.size()]);
+
+	std::println("{:>10} - {}", _lineNum + 1, _line);
+	std::println("{:>10} + {}", "", _actual);
+
+	// Fields are separated by spaces and are in the same order in both.
+	std::string_view expected = _line;
+	std::string_view actual = _actual;
+	while (!expected.empty() && !actual.empty()) {
+		const std::string_view expectedField = expected.substr(0, expected.find(' '));
+		const std::string_view actualField = actual.substr(0, actual.find(' '));
+
+		if (expectedField != actualField)
+			std::println("{:>10}   expected {}, got {}", "", expectedField, actualField);
+
+		expected.remove_prefix(std::min(expected.size(), expectedField.size() + 1));
+		actual.remove_prefix(std::min(actual.size(), actualField.size() + 1));
+	}
+
+	for (std::size_t i = 0; i < _after.size(); ++i)
+		std::println("{:>10}   {}", _lineNum + 2 + i, _after[i]);
+}
+
+} // namespace gb::cpu
+#endif // DEBUG
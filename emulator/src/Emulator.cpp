@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <chrono>
 #include <stdexcept>
 #include <thread>
+#include <utility>
 
 #include "Emulator.hpp"
 #include "ConstexprAdditions.hpp"
@@ -18,17 +20,25 @@ static auto LoadRom(const std::filesystem::path& romPath) {
 }
 
 Emu::Emu(const std::filesystem::path& romPath)
-	: _timer()
+	: Emu(romPath, Headless{})
+{
+	_screen = std::make_unique<Screen>();
+	debug::InitDebugScreen(_screen->GetGLFWWindow(), &_memory);
+}
+
+Emu::Emu(const std::filesystem::path& romPath, Headless)
+	: _romPath(romPath)
+	, _timer()
 	, _memory(std::move(LoadRom(romPath)), _timer)
 	, _cpuCtx(_memory)
 	, _ppuCtx(_memory)
 {
-	debug::InitDebugScreen(_screen.GetGLFWWindow(), &_memory);
+	SetCatchUp(true);
 }
 
 void Emu::Run() {
-	using namespace std::chrono_literals;
-	
+	assert(_screen && "Headless emus can only be stepped.");
+
 	_isRunning = true;
 	_isMultithreaded = true;
 
@@ -37,8 +47,8 @@ void Emu::Run() {
 	auto emuThread = std::jthread([this] {
 		while (_isRunning) {
 			if (_isPaused) {
-				// TODO: better pause?
-				std::this_thread::sleep_for(10ms);
+				// Woken by Resume, which also happens when the screen closes.
+				_isPaused.wait(true);
 				continue;
 			}
 
@@ -54,6 +64,7 @@ void Emu::Run() {
 	while (_isRunning) {
 		if (!ScreenUpdate()) {
 			_isRunning = false;
+			Resume();
 			debug::cexpr::println(stderr, "Something in the screen went wrong!");
 
 			emuThread.join();
@@ -63,20 +74,107 @@ void Emu::Run() {
 
 #ifdef DEBUG // TODO: REMOVE
 #include <print>
-static std::string debugStr{}, prevStr{};
 #endif // DEBUG
 
 bool Emu::CoreUpdate() {
 	if (_isPaused)
 		return true;
 
-	if (!_cpuCtx.Update())
+	if (_breakpointsChanged.load(std::memory_order_relaxed)) [[unlikely]]
+		ApplyBreakpoints();
+
+	// Recompiled code only syncs the hardware through SyncHardware when the cpu could see it change.
+	if (_cpuCtx.HasRecompiled()) {
+		_memory.SetCpuAhead(true);
+		const bool ok = _cpuCtx.RunRecompiled(cpuBudget, &Emu::SyncHardware, this);
+		_memory.SetCpuAhead(false);
+
+		return ok;
+	}
+
+#ifdef JIT
+	if (_cpuCtx.IsJitEnabled()) {
+		_memory.SetCpuAhead(true);
+		const bool ok = _cpuCtx.RunJit(cpuBudget, &Emu::SyncHardware, this);
+		_memory.SetCpuAhead(false);
+
+		return ok;
+	}
+#endif
+
+#ifdef THREADED_DISPATCH
+	// Hardware is only synced through SyncHardware when the cpu could see it change, like with recompiled code.
+	_memory.SetCpuAhead(true);
+	const bool ok = _cpuCtx.Run(cpuBudget, &Emu::SyncHardware, this);
+	_memory.SetCpuAhead(false);
+
+	return ok;
+#else
+	if (!StepCpu())
 		return false;
 
 	if (!ProcessCycles(_cpuCtx.GetUpdateCycles()))
 		return false;
 
 #ifdef DEBUG // TODO: REMOVE
+	DebugSerial();
+#endif // DEBUG
+
+	return true;
+#endif // THREADED_DISPATCH
+}
+
+cpu::Context::SyncResult Emu::SyncHardware(void* emu, u64 mCycles) {
+	using enum cpu::Context::SyncResult;
+
+	Emu& self = *static_cast<Emu*>(emu);
+
+	if (!self.ProcessCycles(mCycles))
+		return FAILED;
+
+#ifdef DEBUG // TODO: REMOVE
+	self.DebugSerial();
+#endif // DEBUG
+
+	// The cpu starts its next update from 0 cycles before it touches anything.
+	self._memory.SetCpuAhead(true);
+
+	self._quietCycles = self.DeferrableCycles();
+	self._cpuCtx.SetQuietCycles(self._quietCycles);
+
+	// Leave the cpu loop as soon as possible when pausing.
+	return self._isPaused ? STOP : CONTINUE;
+}
+
+void Emu::CatchUpHardware(void* emu) {
+	Emu& self = *static_cast<Emu*>(emu);
+
+	const u64 mCycles = self._cpuCtx.GetUpdateCycles();
+	if (mCycles > self._caughtUp) {
+		// Also keeps the hardware's own accesses from catching up while it's already catching up.
+		self._memory.SetCpuAhead(false);
+		self.AdvanceHardware(mCycles - std::exchange(self._caughtUp, mCycles));
+		self._memory.SetCpuAhead(true);
+	}
+
+	// Whatever the cpu is about to touch can change what the hardware does next.
+	self._quietCycles = 0;
+	self._cpuCtx.SetQuietCycles(0);
+}
+
+void Emu::SetCatchUp(bool enabled) {
+	_memory.SetCatchUp(enabled ? Memory::CatchUp{ &Emu::CatchUpHardware, this } : Memory::CatchUp{});
+}
+
+bool Emu::StepCpu() {
+	_memory.SetCpuAhead(true);
+	return _cpuCtx.Update();
+}
+
+#ifdef DEBUG // TODO: REMOVE
+static std::string debugStr{}, prevStr{};
+
+void Emu::DebugSerial() {
 	auto& mem = _memory;
 	if (mem[0xFF02] == 0x81) {
 		debugStr.push_back(static_cast<char>(mem[0xFF01]));
@@ -87,41 +185,90 @@ bool Emu::CoreUpdate() {
 		std::println(stderr, "{}", debugStr);
 		prevStr = debugStr;
 	}
-#endif // DEBUG
-
-	return true;
 }
+#endif // DEBUG
 
 bool Emu::ScreenUpdate() {
-	if (_screen.IsClosed())
+	if (_screen->IsClosed())
 		return false;
 
-	return _screen.Update();
+	return _screen->Update();
 }
 
 bool Emu::Update() {
 	if (_isPaused)
 		return true;
 
-	if (!_cpuCtx.Update())
+	if (_breakpointsChanged.load(std::memory_order_relaxed)) [[unlikely]]
+		ApplyBreakpoints();
+
+	if (!StepCpu())
 		return false;
 
 	if (!ProcessCycles(_cpuCtx.GetUpdateCycles()))
 		return false;
 
-	if (_screen.IsClosed())
+	if (!_screen)
+		return true;
+
+	if (_screen->IsClosed())
 		return false;
 	
-	return _screen.Update();
+	return _screen->Update();
 }
 
 bool Emu::ProcessCycles(u64 mCycles) {
+	_memory.SetCpuAhead(false);
+
+	// The update stopped at a breakpoint without running anything.
+	if (mCycles == 0) [[unlikely]]
+		return true;
+	_cycles += mCycles;
+
+#ifdef SAMPLING_PROFILER
+	if (_cycles >= _nextSample) [[unlikely]]
+		TakeSample();
+#endif
+
+#ifdef CALL_PROFILER
+	if (_callProfiling) [[unlikely]]
+		_callProfiler->Advance(mCycles);
+#endif
+
+#ifdef INSTR_TRACE
+	if (_trace) [[unlikely]]
+		TraceInstr();
+#endif
+
+	// Only ever set while halted or in an idle loop, and the dma isn't active then.
+	if (const u64 skipped = std::min(std::exchange(_skipCycles, 0), mCycles); skipped != 0) {
+		_timer.Skip(static_cast<u32>(skipped * 4));
+		_ppuCtx.Skip(static_cast<u32>(skipped * 4));
+		mCycles -= skipped;
+	}
+
+	// Accesses partway through the update already ran some of it.
+	AdvanceHardware(mCycles - std::exchange(_caughtUp, 0));
+
+	// A halted cpu does nothing but wait for an interrupt, so let it skip straight to the last mcycle
+	// before one could be requested. It still wakes up on the same cycle as it would one at a time.
+	if (_cpuCtx.IsHalted() && _memory.PendingInterrupts() == 0 && !_memory.IsDMAActive()) {
+		_skipCycles = HaltedCycles();
+		_cpuCtx.SkipHalted(_skipCycles);
+	}
+	else if (const auto iteration = _cpuCtx.TakeIdleIteration()) [[unlikely]]
+		SkipIdleLoop(*iteration);
+
+	return true;
+}
+
+void Emu::TickHardware(u64 mCycles) {
 	for (u64 mCycle = 0; mCycle < mCycles; ++mCycle) {
 		for (u64 tCycle = 0; tCycle < 4; ++tCycle) {
 			if (_timer.Tick()) {
 				// TIMA overflows to 0, then one cycle later, IF is set
 				//_cpuCtx.MCycle();
-				_memory.GetInterruptFlag().flags.TimerInt = 1;
+				_memory.RequestInterrupt(Interrupt::TIMER);
 			}
 
 			if (_ppuCtx.Update() == ppu::State::END_FRAME && _isMultithreaded)
@@ -131,10 +278,274 @@ bool Emu::ProcessCycles(u64 mCycles) {
 		if (_memory.IsDMAActive())
 			_memory.DMATransferTick();
 	}
+}
+
+void Emu::AdvanceHardware(u64 mCycles) {
+	if (const u64 quiet = std::min(std::exchange(_quietCycles, 0), mCycles); quiet != 0) {
+		_timer.Skip(static_cast<u32>(quiet * 4));
+		_ppuCtx.Skip(static_cast<u32>(quiet * 4));
+		mCycles -= quiet;
+	}
+
+	TickHardware(mCycles);
+}
+
+u64 Emu::QuietCycles(bool countTima) const {
+	u32 ticks = std::min(_timer.QuietTicks(), _ppuCtx.QuietDots());
+	if (countTima)
+		ticks = std::min(ticks, _timer.QuietTimaTicks());
+
+	// Every tcycle of a skipped mcycle has to be quiet.
+	return ticks / 4;
+}
+
+u64 Emu::DeferrableCycles() const {
+	// Without catching up, the cpu would see the hardware as it was at the last sync.
+	if (!_memory.GetCatchUp().func)
+		return 0;
+
+	// Halts and idle loops skip on their own, and the dma copies a byte every mcycle.
+	if (_skipCycles != 0 || _memory.IsDMAActive())
+		return 0;
+
+#ifdef SAMPLING_PROFILER
+	// Samples are taken wherever the cpu is when the hardware gets to them.
+	if (_nextSample != noSample)
+		return 0;
+#endif
+
+#ifdef CALL_PROFILER
+	// Cycles are counted towards whatever function is running when they're processed.
+	if (_callProfiling)
+		return 0;
+#endif
+
+	return QuietCycles();
+}
+
+u64 Emu::HaltedCycles() const {
+	return std::min(_timer.QuietTicks(), _ppuCtx.HaltedDots()) / 4;
+}
+
+void Emu::SkipIdleLoop(const cpu::IdleIteration& iteration) {
+	const bool sameLoop = iteration.head == _lastIdleIteration.head && iteration.count == _lastIdleIteration.count + 1;
+	const u64 length = _cycles - _lastIdleIterationEnd;
+
+	// The iteration that just finished read the hardware before its cycles were processed, so quiet cycles
+	// have to be counted from the end of the iteration before it.
+	const u64 quiet = _lastIdleQuiet;
+
+	_lastIdleIteration = iteration;
+	_lastIdleIterationEnd = _cycles;
+	_lastIdleQuiet = QuietCycles(iteration.readsTima);
+
+	// Every iteration takes as long as the one before it, which is only known after two of them.
+	if (!sameLoop || quiet <= length || _memory.IsDMAActive())
+		return;
 
+	// Each skipped iteration reads before it ends, so all of them have to end within the quiet cycles.
+	const u64 iterations = (quiet - length) / length;
+	if (iterations == 0)
+		return;
+
+	_skipCycles = iterations * length;
+	_cpuCtx.SkipIdleLoop(iterations, _skipCycles);
+
+	// The cpu will be at the end of the last skipped iteration.
+	_lastIdleIterationEnd += _skipCycles;
+	_lastIdleQuiet -= _skipCycles;
+}
+
+#ifdef SAMPLING_PROFILER
+void Emu::StartSampling(u64 interval) {
+	std::filesystem::path symPath = _romPath;
+	symPath.replace_extension(".sym");
+
+	_sampler = std::make_unique<SamplingProfiler>(interval, SymbolTable::Load(symPath));
+	_nextSample = _cycles + _sampler->Interval();
+}
+
+void Emu::StopSampling() {
+	_nextSample = noSample;
+}
+
+void Emu::TakeSample() {
+	// Skipped halts and idle loops can cover more than one interval. All of their samples go to where the cpu waited.
+	const u64 interval = _sampler->Interval();
+	const u64 count = (_cycles - _nextSample) / interval + 1;
+	_nextSample += count * interval;
+
+	_sampler->Record(PcBank(), _cpuCtx.reg.pc, static_cast<u32>(count));
+}
+#endif // SAMPLING_PROFILER
+
+#ifdef CALL_PROFILER
+void Emu::StartCallProfiling() {
+	std::filesystem::path symPath = _romPath;
+	symPath.replace_extension(".sym");
+
+	_callProfiler = std::make_unique<CallProfiler>(SymbolTable::Load(symPath));
+	_callProfiling = true;
+	_cpuCtx.SetCallProfiler(_callProfiler.get());
+}
+
+void Emu::StopCallProfiling() {
+	_callProfiling = false;
+	_cpuCtx.SetCallProfiler(nullptr);
+}
+#endif // CALL_PROFILER
+
+void Emu::StartRomAnalysis() {
+	if (!_romAnalysis.valid())
+		_romAnalysis = rom::AnalyseAsync(_memory.GetRom());
+}
+
+rom::SharedAnalysis Emu::GetRomAnalysis() const {
+	using namespace std::chrono_literals;
+
+	if (!_romAnalysis.valid() || _romAnalysis.wait_for(0s) != std::future_status::ready)
+		return nullptr;
+
+	return _romAnalysis.get();
+}
+
+#ifdef INSTR_TRACE
+bool Emu::StartTrace(const std::filesystem::path& tracePath) {
+	StopTrace();
+
+	_trace = std::make_unique<TraceWriter>(tracePath);
+	if (!_trace->IsOpen()) {
+		_trace.reset();
+		return false;
+	}
+
+	// Fused sequences and the faster interpreters don't stop between instructions.
+	_cpuCtx.SetTracing(true);
+	TraceInstr();
 	return true;
 }
 
+void Emu::StopTrace() {
+	_trace.reset();
+	_cpuCtx.SetTracing(false);
+}
+
+void Emu::TraceInstr() {
+	// Nothing runs while halted, the next record is where the cpu woke up to.
+	if (_cpuCtx.IsHalted())
+		return;
+
+	const auto& reg = _cpuCtx.reg;
+	const u16 pc = reg.pc;
+
+	_trace->Record({
+		.cycle = _cycles, .pc = pc, .bank = PcBank(), .sp = reg.sp,
+		.a = reg.a, .f = static_cast<byte>(reg.f), .b = reg.b(), .c = reg.c(), .d = reg.d(), .e = reg.e(), .h = reg.h(), .l = reg.l(),
+		.pcMem = { _memory.Read(pc), _memory.Read(pc + 1), _memory.Read(pc + 2), _memory.Read(pc + 3) }
+	});
+}
+#endif // INSTR_TRACE
+
+void Emu::Resume() {
+	_isPaused = false;
+	_isPaused.notify_all();
+}
+
+u32 Emu::AddBreakpoint(Breakpoint breakpoint) {
+	std::scoped_lock lock{ _breakpointMutex };
+
+	const u32 id = _nextBreakpointId++;
+	_breakpointEdits.push_back({ id, std::move(breakpoint) });
+	_breakpointsChanged = true;
+
+	return id;
+}
+
+std::optional<u32> Emu::AddBreakpoint(std::string_view label, Breakpoint::Condition condition) {
+	const SymbolTable::Symbol* symbol = nullptr;
+
+	{
+		std::scoped_lock lock{ _breakpointMutex };
+
+		if (!_breakpointSymbols) {
+			std::filesystem::path symPath = _romPath;
+			symPath.replace_extension(".sym");
+
+			_breakpointSymbols = SymbolTable::Load(symPath).value_or(SymbolTable{});
+		}
+
+		symbol = _breakpointSymbols->Lookup(label);
+	}
+
+	if (symbol == nullptr)
+		return std::nullopt;
+
+	return AddBreakpoint({ symbol->addr, symbol->bank, std::move(condition) });
+}
+
+void Emu::RemoveBreakpoint(u32 id) {
+	std::scoped_lock lock{ _breakpointMutex };
+
+	std::erase_if(_breakpointEdits, [id](const IdBreakpoint& edit) { return edit.id == id; });
+	_breakpointsChanged = true;
+}
+
+void Emu::ClearBreakpoints() {
+	std::scoped_lock lock{ _breakpointMutex };
+
+	_breakpointEdits.clear();
+	_breakpointsChanged = true;
+}
+
+void Emu::ApplyBreakpoints() {
+	{
+		std::scoped_lock lock{ _breakpointMutex };
+
+		_breakpoints = _breakpointEdits;
+		_breakpointsChanged = false;
+	}
+
+	std::ranges::sort(_breakpoints, {}, [](const IdBreakpoint& active) { return active.breakpoint.addr; });
+
+	_cpuCtx.ClearDebugPages();
+	for (const IdBreakpoint& active : _breakpoints)
+		_cpuCtx.MarkDebugPage(active.breakpoint.addr);
+
+	_cpuCtx.SetBreakCheck(_breakpoints.empty() ? nullptr : &Emu::CheckBreakpoints, this);
+}
+
+bool Emu::CheckBreakpoints(void* emu) {
+	Emu& self = *static_cast<Emu*>(emu);
+
+	// Resuming runs the instruction the emulator paused at instead of pausing at it again.
+	if (self._cycles == self._breakCycle)
+		return false;
+
+	const auto atPc = std::ranges::equal_range(self._breakpoints, self._cpuCtx.reg.pc, {},
+		[](const IdBreakpoint& active) { return active.breakpoint.addr; });
+
+	for (const IdBreakpoint& active : atPc) {
+		const Breakpoint& breakpoint = active.breakpoint;
+
+		if (breakpoint.bank != Breakpoint::anyBank && breakpoint.bank != self.PcBank())
+			continue;
+
+		if (breakpoint.condition && !breakpoint.condition(self._cpuCtx))
+			continue;
+
+		self._breakCycle = self._cycles;
+		self._lastBreakpoint = active.id;
+		self._isPaused = true;
+		return true;
+	}
+
+	return false;
+}
+
+u16 Emu::PcBank() const {
+	return _memory.CodeBank(_cpuCtx.reg.pc);
+}
+
 void Emu::LimitSpeed() {
 	using namespace std::chrono_literals;
 
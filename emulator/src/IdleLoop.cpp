@@ -0,0 +1,128 @@
+#include "IdleLoop.hpp"
+#include "InstrInfo.hpp"
+#include "Memory.hpp"
+
+namespace gb::cpu {
+
+static constexpr u16 regTIMA = 0xFF05;
+static constexpr u16 regIF = 0xFF0F;
+static constexpr u16 regSTAT = 0xFF41;
+static constexpr u16 regLY = 0xFF44;
+
+// Memory an idle loop can wait on. Nothing but the cpu, the ppu (vram and oam are locked in some modes,
+// and dma isn't skipped), the timer, and interrupts can change it.
+static bool CanWaitOn(u16 addr) {
+	// cartridge ram can have a clock in it
+	if (addr >= vramEnd && addr < ramCartEnd)
+		return false;
+
+	// joypad, serial, div, sound...
+	if (addr >= unusableEnd && addr < ioEnd)
+		return addr == regTIMA || addr == regIF || addr == regSTAT || addr == regLY;
+
+	return true;
+}
+
+// Instructions that can't change anything but a and f.
+static bool OnlyChangesAcc(byte op, byte cbOp) {
+	switch (op) {
+	case 0x00:										// nop
+	case 0x07: case 0x0F: case 0x17: case 0x1F:		// rlca, rrca, rla, rra
+	case 0x27: case 0x2F: case 0x37: case 0x3F:		// daa, cpl, scf, ccf
+	case 0x3C: case 0x3D: case 0x3E:				// inc a, dec a, ld a, imm8
+	case 0x0A: case 0x1A:							// ld a, [bc]; ld a, [de]
+	case 0xF0: case 0xF2: case 0xFA:				// ldh a, [imm8]; ld a, [c]; ld a, [imm16]
+		return true;
+	case 0xCB:
+		// bit never writes its operand, everything else only writes a if that's its operand
+		return (cbOp >> 6) == 0b01 || (cbOp & 0b111) == 0b111;
+	default:
+		break;
+	}
+
+	return (op >= 0x78 && op <= 0x7F)				// ld a, r8
+		|| (op >= 0x80 && op <= 0xBF)				// alu a, r8
+		|| (op & 0b11'000'111) == 0b11'000'110;		// alu a, imm8
+}
+
+// The address an instruction from OnlyChangesAcc reads, if it reads memory.
+static std::optional<u16> ReadAddr(byte op, u16 imm, const IdleLoopDetector::State& state) {
+	const bool readsHl = op == 0x7E
+		|| (op >= 0x80 && op <= 0xBF && (op & 0b111) == 0b110)
+		|| (op == 0xCB && (imm & 0b111) == 0b110);
+
+	if (readsHl)
+		return state.hl;
+
+	switch (op) {
+	case 0x0A: return state.bc;
+	case 0x1A: return state.de;
+	case 0xF0: return static_cast<u16>(0xFF00 | (imm & 0xFF));
+	case 0xF2: return static_cast<u16>(0xFF00 | (state.bc & 0xFF));
+	case 0xFA: return imm;
+	default: return std::nullopt;
+	}
+}
+
+void IdleLoopDetector::JumpedBack(Memory& mem, const State& state, u16 head, u16 loopEnd) {
+	if (head != _head || state != _state) {
+		_head = head;
+		_state = state;
+		_analyzed = false;
+		_iteration.count = 0;
+		return;
+	}
+
+	// The cpu is exactly where it was an iteration ago.
+	if (!_analyzed) {
+		_readsTima = Analyze(mem, state, head, loopEnd);
+		_analyzed = true;
+
+		if (_readsTima)
+			++_stats.detected;
+	}
+
+	if (!_readsTima)
+		return;
+
+	_iteration = { head, _iteration.count + 1, *_readsTima };
+	_hasIteration = true;
+}
+
+std::optional<bool> IdleLoopDetector::Analyze(Memory& mem, const State& state, u16 head, u16 loopEnd) {
+	bool readsTima = false;
+
+	for (u16 pc = head; pc < loopEnd;) {
+		const byte op = mem[pc];
+		const InstrInfo info = instrInfo[op];
+		const u16 next = pc + info.length;
+
+		if (next > loopEnd || next < pc)
+			return std::nullopt;
+
+		// Only the jump back can leave the loop.
+		if (next == loopEnd)
+			return info.flow == Flow::JUMP || info.flow == Flow::COND_JUMP ? std::optional{ readsTima } : std::nullopt;
+
+		u16 imm = 0;
+		for (byte i = 1; i < info.length; ++i)
+			imm |= static_cast<u16>(mem[static_cast<u16>(pc + i)] << (8 * (i - 1)));
+
+		if (!OnlyChangesAcc(op, static_cast<byte>(imm)))
+			return std::nullopt;
+
+		// Nothing the loop reads through can change, the loop doesn't write any of them.
+		if (const std::optional<u16> addr = ReadAddr(op, imm, state); addr) {
+			if (!CanWaitOn(*addr))
+				return std::nullopt;
+
+			readsTima |= *addr == regTIMA;
+		}
+
+		pc = next;
+	}
+
+	return std::nullopt;
+}
+
+} // namespace gb::cpu
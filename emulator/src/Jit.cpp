@@ -0,0 +1,861 @@
+#ifdef JIT
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include "Jit.hpp"
+#include "ConstexprAdditions.hpp"
+#include "InstrInfo.hpp"
+
+namespace gb::cpu {
+
+using SyncResult = Context::SyncResult;
+
+static constexpr std::size_t codeBufferSize = 16 * 1024 * 1024;
+
+// Every block has to fit in this much space, so a translation never runs out of room halfway through.
+static constexpr std::size_t maxBlockCodeSize = 8 * 1024;
+static constexpr u32 maxBlockInstrs = 32;
+
+static constexpr u32 ramKeyBit = 1u << 31;
+
+template <typename Base, typename Member>
+static u32 OffsetOf(const Base& base, const Member& member) {
+	return static_cast<u32>(reinterpret_cast<const byte*>(&member) - reinterpret_cast<const byte*>(&base));
+}
+
+Jit::Jit(Context& ctx, Memory& mem)
+	: _ctx(ctx)
+	, _mem(mem)
+{
+	// Starts out writable, and is only made executable right before translated code runs.
+	void* buffer = mmap(nullptr, codeBufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED)
+		throw std::runtime_error{ "Couldn't allocate memory for the jit." };
+
+	_codeBegin = static_cast<byte*>(buffer);
+	_codeEnd = _codeBegin + codeBufferSize;
+
+	_irOffset = OffsetOf(ctx, ctx.ir);
+	_immOffset = OffsetOf(ctx, ctx.imm);
+	_pcOffset = OffsetOf(ctx, ctx.reg.pc);
+	_mCyclesOffset = OffsetOf(ctx, ctx._mCycles);
+	_lastExitOffset = OffsetOf(*this, _lastExit);
+	_inlineLimitOffset = OffsetOf(*this, _inlineLimit);
+	_fOffset = OffsetOf(ctx, ctx.reg.f);
+	_r8Offsets = { OffsetOf(ctx, ctx.reg.b()), OffsetOf(ctx, ctx.reg.c()), OffsetOf(ctx, ctx.reg.d()),
+				   OffsetOf(ctx, ctx.reg.e()), OffsetOf(ctx, ctx.reg.h()), OffsetOf(ctx, ctx.reg.l()), 0,
+				   OffsetOf(ctx, ctx.reg.a) };
+
+	// Translated code writes f as a whole byte, in whatever order the compiler put its bitfields.
+	static_assert(sizeof(Context::Flags) == 1);
+	auto pack = [](byte val) {
+		Context::Flags flags;
+		std::memset(&flags, 0, sizeof(flags));
+		flags = val;
+
+		byte packed = 0;
+		std::memcpy(&packed, &flags, sizeof(packed));
+		return packed;
+	};
+
+	for (u32 i = 0; i < 256; ++i) {
+		// lahf puts the zero flag in bit 6, the half carry (x86 calls it the adjust flag) in bit 4, and the carry in bit 0.
+		const bool z = i & (1 << 6);
+		const bool h = i & (1 << 4);
+		const bool c = i & (1 << 0);
+
+		_flagTables.add[i] = pack(alu::MakeFlags(z, false, h, c));
+		_flagTables.sub[i] = pack(alu::MakeFlags(z, true, h, c));
+		_flagTables.inc[i] = pack(alu::MakeFlags(z, false, h, false));
+		_flagTables.dec[i] = pack(alu::MakeFlags(z, true, h, false));
+		_flagTables.logic[i] = pack(alu::MakeFlags(i == 0, false, false, false));
+		_flagTables.andLogic[i] = pack(alu::MakeFlags(i == 0, false, true, false));
+	}
+
+	_zeroMask = pack(alu::zeroFlag);
+	_carryMask = pack(alu::carryFlag);
+	_carryBit = static_cast<byte>(std::countr_zero(_carryMask));
+
+	Flush();
+}
+
+Jit::~Jit() {
+	munmap(_codeBegin, codeBufferSize);
+}
+
+bool Jit::Run(u64 cycleBudget, Context::SyncFunc sync, void* owner) {
+	_sync = sync;
+	_owner = owner;
+	_cyclesRan = 0;
+	_cycleBudget = cycleBudget;
+	_synced = SyncResult::CONTINUE;
+
+	// The hardware was synced at the end of the last update, so nothing's pending. What it said was quiet
+	// then may not be anymore.
+	_ctx._mCycles = 0;
+	_ctx.SetQuietCycles(0);
+
+	while (_cyclesRan < cycleBudget && _synced == SyncResult::CONTINUE && _ctx._jitEnabled) {
+		// Halting, skipping, dma, breakpoints, and dumping or checking state all go through the interpreter.
+		bool useUpdate = _ctx._isHalted || _ctx._skipCycles != 0 || _mem.IsDMAActive() || _ctx.IsTracing()
+			|| _ctx.HasBreakCheck();
+#ifdef OPCODE_PROFILER
+		useUpdate = true;
+#endif
+
+		Block* block = useUpdate ? nullptr : Lookup();
+
+		// Linked blocks are validated as one chain, so only link when not validating.
+		if (block && _lastExit && !_validate)
+			Link(*_lastExit, *block);
+
+		_lastExit = nullptr;
+
+		if (block && !_validate) {
+			_entryBanks = _mem.RomBankBases();
+			_inlineLimit = InlineLimit();
+			SetExecutable(true);
+			_enter(&_ctx, &_mem, this, block->code);
+			continue;
+		}
+
+		// The interpreter starts its update from 0 cycles, and validation checks the cycles of every instruction.
+		if (!SyncDeferred())
+			break;
+
+		if (!(block ? RunValidated(*block) : Step()))
+			return false;
+	}
+
+	// The jit was turned off halfway through, finish with the interpreter.
+	SyncDeferred();
+	while (_cyclesRan < cycleBudget && _synced == SyncResult::CONTINUE) {
+		if (!Step())
+			return false;
+	}
+
+	return _synced != SyncResult::FAILED;
+}
+
+bool Jit::Step() {
+	if (!_ctx.Update())
+		return false;
+
+	// Synced even when it stopped at a breakpoint without running anything, so the pause is seen.
+	const u64 mCycles = std::exchange(_ctx._mCycles, 0);
+	_cyclesRan += mCycles;
+	_synced = _sync(_owner, mCycles);
+
+	return true;
+}
+
+bool Jit::Retire(Jit* jit) {
+	Context& ctx = jit->_ctx;
+
+	// The end of Context::Update.
+	if (ctx._ime & (ctx._memory.PendingInterrupts() != 0)) [[unlikely]]
+		ctx.InterruptHandler();
+	else if (ctx._enablingIME)
+		ctx._ime = true;
+
+	++jit->_instrsRan;
+
+	// Blocks were translated for the banks that were mapped when they were entered.
+	if (ctx.CanDeferSync() && jit->_cyclesRan + ctx._mCycles < jit->_cycleBudget) [[likely]] {
+		jit->_inlineLimit = jit->InlineLimit();
+		return jit->_mem.RomBankBases() != jit->_entryBanks;
+	}
+
+	if (!jit->SyncDeferred()) [[unlikely]]
+		return true;
+
+	jit->_inlineLimit = jit->InlineLimit();
+
+	// Leave if anything the translation depends on changed.
+	return jit->_cyclesRan >= jit->_cycleBudget || ctx._isHalted || ctx._skipCycles != 0 || jit->_mem.IsDMAActive()
+		|| jit->_mem.RomBankBases() != jit->_entryBanks;
+}
+
+u64 Jit::InlineLimit() const {
+	// Inline instructions don't check for interrupts, so the next instruction has to take a pending one.
+	if (!_ctx.CanDeferSync() || (_ctx._ime && _mem.PendingInterrupts() != 0) || _cyclesRan >= _cycleBudget)
+		return 0;
+
+	return std::min(_ctx._quietCycles, _cycleBudget - _cyclesRan - 1);
+}
+
+bool Jit::SyncDeferred() {
+	if (_ctx._mCycles != 0) {
+		const u64 mCycles = std::exchange(_ctx._mCycles, 0);
+		_cyclesRan += mCycles;
+		_synced = _sync(_owner, mCycles);
+	}
+
+	return _synced == SyncResult::CONTINUE;
+}
+
+bool Jit::JumpedBack(Context* ctx, u16 loopEnd) {
+	ctx->JumpedBack(loopEnd);
+	return ctx->_idleLoops.HasIteration();
+}
+
+Jit::Block* Jit::Lookup() {
+	const u16 pc = _ctx.reg.pc;
+	u16 codeRamIndex = Memory::noCodeRamIndex;
+	u32 key = 0;
+
+	if (pc < romNEnd) {
+		key = _mem.RomPhysicalAddr(pc);
+		if (key >= _mem.RomSize())
+			return nullptr;
+	}
+	else {
+		codeRamIndex = Memory::CodeRamIndex(pc);
+		if (codeRamIndex == Memory::noCodeRamIndex)
+			return nullptr;
+
+		key = ramKeyBit | codeRamIndex;
+	}
+
+	if (auto it = _blocks.find(key); it != _blocks.end()) {
+		if (codeRamIndex == Memory::noCodeRamIndex || it->second.version == _mem.CodePageVersion(codeRamIndex))
+			return &it->second;
+
+		// The code was written to. Nothing links to ram blocks, so the old code can just be left behind.
+		_blocks.erase(it);
+	}
+
+	return Compile(pc, key, codeRamIndex);
+}
+
+Jit::Block* Jit::Compile(u16 pc, u32 key, u16 codeRamIndex) {
+	if (static_cast<std::size_t>(_codeEnd - _emit) < maxBlockCodeSize)
+		Flush();
+
+	SetExecutable(false);
+
+	const bool isRam = codeRamIndex != Memory::noCodeRamIndex;
+	const u16 codePage = codeRamIndex / Memory::codePageSize;
+
+	Block block{ .code = _emit, .pc = pc, .codeRamIndex = codeRamIndex };
+	if (isRam)
+		block.version = _mem.CodePageVersion(codeRamIndex);
+
+	// Rom blocks stay in one rom window and ram blocks in one code page, so a single check covers all of it.
+	auto inBlock = [&](u16 addr, byte length) {
+		if (!_ctx._decodeCache.CanStore(_mem, addr, length))
+			return false;
+
+		return isRam ? Memory::CodeRamIndex(addr) / Memory::codePageSize == codePage
+					 : addr / romBankSize == pc / romBankSize;
+	};
+
+	auto readCode = [&](u16 addr) {
+		return isRam ? _mem.Read(addr) : _mem.ReadRom(_mem.RomPhysicalAddr(addr));
+	};
+
+	u16 addr = pc;
+	byte lastOp = 0;
+	std::array<byte, 4> lastImm{};
+
+	while (block.instrCount < maxBlockInstrs) {
+		const byte op = readCode(addr);
+		const Context::InstrFunc handler = Context::MainHandler(op);
+		const InstrInfo info = instrInfo[op];
+
+		// Invalid op codes hang the cpu, leave that to the interpreter.
+		if (!handler || !inBlock(addr, info.length))
+			break;
+
+		std::array<byte, 4> imm{};
+		for (byte i = 1; i < info.length; ++i)
+			imm[i - 1] = readCode(static_cast<u16>(addr + i));
+
+		u32 packedImm = 0;
+		std::memcpy(&packedImm, imm.data(), sizeof(packedImm));
+
+		const u16 next = static_cast<u16>(addr + info.length);
+		const bool inlined = CanInline(op);
+		byte* toRetire = nullptr;
+
+		if (inlined)
+			toRetire = EmitInline(op, static_cast<u16>(packedImm), next);
+		else {
+			// Fetch: ir = op; imm = ...; ++pc; MCycle();
+			Emit({ 0xC6, 0x83 });		// mov byte [rbx + ir], op
+			Emit32(_irOffset);
+			Emit({ op });
+			Emit({ 0xC7, 0x83 });		// mov dword [rbx + imm], imm
+			Emit32(_immOffset);
+			Emit32(packedImm);
+			Emit({ 0x66, 0x83, 0x83 });	// add word [rbx + pc], 1
+			Emit32(_pcOffset);
+			Emit({ 1 });
+			Emit({ 0x48, 0x83, 0x83 });	// add qword [rbx + mCycles], 1
+			Emit32(_mCyclesOffset);
+			Emit({ 1 });
+
+			// Exec: handler(ctx, mem)
+			Emit({ 0x48, 0x89, 0xDF });	// mov rdi, rbx
+			Emit({ 0x4C, 0x89, 0xE6 });	// mov rsi, r12
+			Emit({ 0x48, 0xB8 });		// mov rax, handler
+			EmitAddress(reinterpret_cast<const void*>(handler));
+			Emit({ 0xFF, 0xD0 });		// call rax
+		}
+
+		++block.instrCount;
+		addr = next;
+		lastOp = op;
+		lastImm = imm;
+
+		const bool last = EndsBlock(info.flow) || block.instrCount == maxBlockInstrs;
+
+		// Inline instructions only go through Retire once they've added up enough cycles.
+		byte* skipRetire = nullptr;
+		if (inlined) {
+			Emit({ 0x48, 0x8B, 0x83 });	// mov rax, [rbx + mCycles]
+			Emit32(_mCyclesOffset);
+			Emit({ 0x49, 0x3B, 0x85 });	// cmp rax, [r13 + inlineLimit]
+			Emit32(_inlineLimitOffset);
+			skipRetire = EmitJump({ 0x0F, 0x86 }); // jbe next
+		}
+
+		if (toRetire)
+			PatchJump(toRetire, _emit);
+
+		// if (Retire(jit)) leave
+		Emit({ 0x4C, 0x89, 0xEF });		// mov rdi, r13
+		Emit({ 0x48, 0xB8 });			// mov rax, Retire
+		EmitAddress(reinterpret_cast<const void*>(&Jit::Retire));
+		Emit({ 0xFF, 0xD0 });			// call rax
+		Emit({ 0x84, 0xC0 });			// test al, al
+		PatchJump(EmitJump({ 0x0F, 0x85 }), _leave); // jnz leave
+
+		if (!last) {
+			// Leave if an interrupt was taken.
+			Emit({ 0x66, 0x81, 0xBB });	// cmp word [rbx + pc], addr
+			Emit32(_pcOffset);
+			Emit16(addr);
+			PatchJump(EmitJump({ 0x0F, 0x85 }), _leave); // jne leave
+
+			// Leave if the instruction wrote over the rest of the block.
+			if (isRam) {
+				Emit({ 0x48, 0xB8 });	// mov rax, &version
+				EmitAddress(_mem.CodePageVersionPtr(codeRamIndex));
+				Emit({ 0x81, 0x38 });	// cmp dword [rax], version
+				Emit32(block.version);
+				PatchJump(EmitJump({ 0x0F, 0x85 }), _leave); // jne leave
+			}
+		}
+
+		if (skipRetire)
+			PatchJump(skipRetire, _emit);
+
+		if (last)
+			break;
+	}
+
+	if (block.instrCount == 0) {
+		_emit = block.code;
+		return nullptr;
+	}
+
+	// Static successors of the block. Every other way out goes back through Run.
+	std::array<u16, 2> targets{};
+	std::size_t targetCount = 0;
+
+	const u16 imm16 = static_cast<u16>(lastImm[1] << 8 | lastImm[0]);
+	const u16 relTarget = static_cast<u16>(addr + static_cast<sbyte>(lastImm[0]));
+
+	switch (instrInfo[lastOp].flow) {
+	case Flow::NEXT:
+		targets[targetCount++] = addr;
+		break;
+	case Flow::JUMP:
+	case Flow::COND_JUMP:
+		targets[targetCount++] = instrInfo[lastOp].length == 2 ? relTarget : imm16;
+		break;
+	case Flow::CALL:
+	case Flow::COND_CALL:
+		targets[targetCount++] = instrInfo[lastOp].length == 1 ? static_cast<u16>(lastOp & 0b00'111'000) : imm16;
+		break;
+	default:
+		break;
+	}
+
+	const Flow lastFlow = instrInfo[lastOp].flow;
+	if (lastFlow == Flow::COND_JUMP || lastFlow == Flow::COND_CALL || lastFlow == Flow::COND_RET)
+		targets[targetCount++] = addr;
+
+	const std::size_t firstExit = _exits.size();
+
+	for (std::size_t i = 0; i < targetCount; ++i) {
+		const u16 target = targets[i];
+
+		// Only rom can be linked to, ram blocks need their version checked on entry.
+		if (target >= romNEnd)
+			continue;
+
+		Exit& exit = _exits.emplace_back();
+		exit.target = target;
+
+		Emit({ 0x66, 0x81, 0xBB });		// cmp word [rbx + pc], target
+		Emit32(_pcOffset);
+		Emit16(target);
+		Emit({ 0x75, 10 + 6 + 2 + 5 });	// jne next exit
+		Emit({ 0x48, 0xB8 });			// mov rax, &bankBase
+		EmitAddress(&_mem.RomBankBases()[target / romBankSize]);
+		Emit({ 0x81, 0x38 });			// cmp dword [rax], bankBase
+		exit.bankCheck = _emit;
+		Emit32(_mem.RomBankBases()[target / romBankSize]);
+		Emit({ 0x75, 5 });				// jne next exit
+		exit.jump = EmitJump({ 0xE9 });	// jmp stub, or the target block once linked
+	}
+
+	PatchJump(EmitJump({ 0xE9 }), _leave); // jmp leave
+
+	// Unlinked exits tell Run which exit was taken so it can be linked.
+	for (std::size_t i = firstExit; i < _exits.size(); ++i) {
+		Exit& exit = _exits[i];
+		PatchJump(exit.jump, _emit);
+
+		Emit({ 0x48, 0xB8 });			// mov rax, &exit
+		EmitAddress(&exit);
+		Emit({ 0x49, 0x89, 0x85 });		// mov [r13 + lastExit], rax
+		Emit32(_lastExitOffset);
+		PatchJump(EmitJump({ 0xE9 }), _leave); // jmp leave
+	}
+
+	++_blocksCompiled;
+
+	auto [it, _] = _blocks.insert_or_assign(key, block);
+	return &it->second;
+}
+
+void Jit::Link(Exit& exit, const Block& target) {
+	if (exit.linked || exit.target != target.pc || target.codeRamIndex != Memory::noCodeRamIndex)
+		return;
+
+	SetExecutable(false);
+
+	// The target was just entered, so the bank it's in is the one that's mapped right now.
+	const u32 bankBase = _mem.RomBankBases()[target.pc / romBankSize];
+	std::memcpy(exit.bankCheck, &bankBase, sizeof(bankBase));
+
+	PatchJump(exit.jump, target.code);
+	exit.linked = true;
+}
+
+void Jit::Flush() {
+	SetExecutable(false);
+
+	_blocks.clear();
+	_exits.clear();
+	_lastExit = nullptr;
+	_emit = _codeBegin;
+
+	// enter(ctx, mem, jit, code) keeps the arguments in callee saved registers for every block.
+	_enter = reinterpret_cast<EnterFunc>(_emit);
+	Emit({ 0x53 });					// push rbx
+	Emit({ 0x41, 0x54 });			// push r12
+	Emit({ 0x41, 0x55 });			// push r13 -- the stack is 16 byte aligned again
+	Emit({ 0x48, 0x89, 0xFB });		// mov rbx, rdi
+	Emit({ 0x49, 0x89, 0xF4 });		// mov r12, rsi
+	Emit({ 0x49, 0x89, 0xD5 });		// mov r13, rdx
+	Emit({ 0xFF, 0xE1 });			// jmp rcx
+
+	_leave = _emit;
+	Emit({ 0x41, 0x5D });			// pop r13
+	Emit({ 0x41, 0x5C });			// pop r12
+	Emit({ 0x5B });					// pop rbx
+	Emit({ 0xC3 });					// ret
+}
+
+void Jit::SetExecutable(bool executable) {
+	if (executable == _executable)
+		return;
+
+	if (mprotect(_codeBegin, codeBufferSize, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) != 0)
+		throw std::runtime_error{ "Couldn't change the protection of the jit's code." };
+
+	_executable = executable;
+}
+
+bool Jit::CanInline(byte op) {
+	const byte dest = (op & 0b00'111'000) >> 3;
+	const byte src = op & 0b00'000'111;
+
+	// ld r8, r8 and alu a, r8. [hl] (6) reads or writes memory, and ld [hl], [hl] is halt.
+	if (op >= 0x40 && op < 0x80)
+		return dest != 6 && src != 6;
+	if (op >= 0x80 && op < 0xC0)
+		return src != 6;
+
+	// ld r8, imm8; inc r8; dec r8
+	if ((op & 0b11'000'111) == 0b00'000'110 || (op & 0b11'000'110) == 0b00'000'100)
+		return dest != 6;
+
+	// alu a, imm8
+	if ((op & 0b11'000'111) == 0b11'000'110)
+		return true;
+
+	// jr, jr cond, jp, jp cond
+	return op == 0x18 || op == 0x20 || op == 0x28 || op == 0x30 || op == 0x38
+		|| op == 0xC3 || op == 0xC2 || op == 0xCA || op == 0xD2 || op == 0xDA;
+}
+
+byte* Jit::EmitInline(byte op, u16 imm16, u16 next) {
+	const byte imm8 = static_cast<byte>(imm16);
+	const byte dest = (op & 0b00'111'000) >> 3;
+	const byte src = op & 0b00'000'111;
+
+	auto addCycles = [this](byte mCycles) {
+		Emit({ 0x48, 0x83, 0x83 });		// add qword [rbx + mCycles], mCycles
+		Emit32(_mCyclesOffset);
+		Emit({ mCycles });
+	};
+
+	// f = table[rdx]
+	auto storeFlags = [this](const std::array<byte, 256>& table) {
+		Emit({ 0x48, 0xB9 });			// mov rcx, table
+		EmitAddress(table.data());
+		Emit({ 0x8A, 0x14, 0x11 });		// mov dl, [rcx + rdx]
+		Emit({ 0x88, 0x93 });			// mov [rbx + f], dl
+		Emit32(_fOffset);
+	};
+
+	// ir and pc end up the same as after a fetch and the handler.
+	Emit({ 0xC6, 0x83 });				// mov byte [rbx + ir], op
+	Emit32(_irOffset);
+	Emit({ op });
+	Emit({ 0x66, 0xC7, 0x83 });			// mov word [rbx + pc], next
+	Emit32(_pcOffset);
+	Emit16(next);
+
+	// ld r8, r8
+	if (op >= 0x40 && op < 0x80) {
+		Emit({ 0x8A, 0x83 });			// mov al, [rbx + src]
+		Emit32(_r8Offsets[src]);
+		Emit({ 0x88, 0x83 });			// mov [rbx + dest], al
+		Emit32(_r8Offsets[dest]);
+		addCycles(1);
+
+		return nullptr;
+	}
+
+	// ld r8, imm8
+	if ((op & 0b11'000'111) == 0b00'000'110) {
+		Emit({ 0xC6, 0x83 });			// mov byte [rbx + dest], imm8
+		Emit32(_r8Offsets[dest]);
+		Emit({ imm8 });
+		addCycles(2);
+
+		return nullptr;
+	}
+
+	// inc r8, dec r8
+	if ((op & 0b11'000'110) == 0b00'000'100) {
+		const bool isDec = op & 1;
+
+		Emit({ 0x8A, 0x83 });			// mov al, [rbx + dest]
+		Emit32(_r8Offsets[dest]);
+		Emit({ static_cast<byte>(isDec ? 0x2C : 0x04), 1 }); // sub al, 1 or add al, 1
+		Emit({ 0x9F });					// lahf
+		Emit({ 0x88, 0x83 });			// mov [rbx + dest], al
+		Emit32(_r8Offsets[dest]);
+
+		// The carry stays what it was.
+		Emit({ 0x0F, 0xB6, 0xD4 });		// movzx edx, ah
+		Emit({ 0x48, 0xB9 });			// mov rcx, table
+		EmitAddress(isDec ? _flagTables.dec.data() : _flagTables.inc.data());
+		Emit({ 0x8A, 0x14, 0x11 });		// mov dl, [rcx + rdx]
+		Emit({ 0x8A, 0x8B });			// mov cl, [rbx + f]
+		Emit32(_fOffset);
+		Emit({ 0x80, 0xE1, _carryMask });	// and cl, carry
+		Emit({ 0x08, 0xCA });			// or dl, cl
+		Emit({ 0x88, 0x93 });			// mov [rbx + f], dl
+		Emit32(_fOffset);
+		addCycles(1);
+
+		return nullptr;
+	}
+
+	// alu a, r8 and alu a, imm8
+	if ((op >= 0x80 && op < 0xC0) || (op & 0b11'000'111) == 0b11'000'110) {
+		// add, adc, sub, sbc, and, xor, or, cp as the op field of the x86 alu instruction that sets the same flags.
+		static constexpr std::array<byte, 8> x86Ops{ 0, 2, 5, 3, 4, 6, 1, 7 };
+
+		const byte aluOp = dest;
+		const byte x86Op = x86Ops[aluOp];
+		const bool isImm = op >= 0xC0;
+
+		Emit({ 0x8A, 0x83 });			// mov al, [rbx + a]
+		Emit32(_r8Offsets[7]);
+
+		if (aluOp == 1 || aluOp == 3) {
+			Emit({ 0x0F, 0xB6, 0x93 });	// movzx edx, byte [rbx + f]
+			Emit32(_fOffset);
+			Emit({ 0x0F, 0xBA, 0xE2, _carryBit }); // bt edx, carry
+		}
+
+		if (isImm)
+			Emit({ static_cast<byte>(x86Op << 3 | 4), imm8 }); // op al, imm8
+		else {
+			Emit({ static_cast<byte>(x86Op << 3 | 2), 0x83 }); // op al, [rbx + src]
+			Emit32(_r8Offsets[src]);
+		}
+
+		if (aluOp >= 4 && aluOp <= 6) {
+			Emit({ 0x0F, 0xB6, 0xD0 });	// movzx edx, al
+			storeFlags(aluOp == 4 ? _flagTables.andLogic : _flagTables.logic);
+		}
+		else {
+			Emit({ 0x9F });				// lahf
+			Emit({ 0x0F, 0xB6, 0xD4 });	// movzx edx, ah
+			storeFlags(aluOp < 2 ? _flagTables.add : _flagTables.sub);
+		}
+
+		// cp only sets the flags.
+		if (aluOp != 7) {
+			Emit({ 0x88, 0x83 });		// mov [rbx + a], al
+			Emit32(_r8Offsets[7]);
+		}
+
+		addCycles(isImm ? 2 : 1);
+		return nullptr;
+	}
+
+	// jr, jr cond, jp, jp cond
+	const bool isJr = op < 0x40;
+	const u16 target = isJr ? static_cast<u16>(next + static_cast<sbyte>(imm8)) : imm16;
+
+	addCycles(isJr ? 2 : 3);
+
+	byte* notTaken = nullptr;
+	if (op != 0x18 && op != 0xC3) {
+		const byte cond = (op & 0b000'11'000) >> 3;
+
+		Emit({ 0xF6, 0x83 });			// test byte [rbx + f], flag
+		Emit32(_fOffset);
+		Emit({ cond < 2 ? _zeroMask : _carryMask });
+
+		// nz and nc aren't taken when the flag is set, z and c when it isn't.
+		notTaken = EmitJump({ 0x0F, static_cast<byte>(cond & 1 ? 0x84 : 0x85) }); // jz or jnz skip
+	}
+
+	Emit({ 0x66, 0xC7, 0x83 });			// mov word [rbx + pc], target
+	Emit32(_pcOffset);
+	Emit16(target);
+	addCycles(1);
+
+	// Idle loops are found the same way the handlers find them. Retire has to see a finished iteration.
+	byte* toRetire = nullptr;
+	if (target < next && next - target <= IdleLoopDetector::maxLoopBytes) {
+		Emit({ 0x48, 0x89, 0xDF });		// mov rdi, rbx
+		Emit({ 0xBE });					// mov esi, next
+		Emit32(next);
+		Emit({ 0x48, 0xB8 });			// mov rax, JumpedBack
+		EmitAddress(reinterpret_cast<const void*>(&Jit::JumpedBack));
+		Emit({ 0xFF, 0xD0 });			// call rax
+		Emit({ 0x84, 0xC0 });			// test al, al
+		toRetire = EmitJump({ 0x0F, 0x85 }); // jnz retire
+	}
+
+	if (notTaken)
+		PatchJump(notTaken, _emit);
+
+	return toRetire;
+}
+
+bool Jit::RunValidated(const Block& block) {
+	struct State {
+		Context::RegisterFile reg;
+		byte ir;
+		bool ime;
+		bool enablingIME;
+		bool isHalted;
+		byte iF;	// dispatching an interrupt clears its flag without going through Write
+
+		bool operator==(const State& other) const {
+			return reg.pc == other.reg.pc && reg.sp == other.reg.sp && reg.af() == other.reg.af()
+				&& reg.bc() == other.reg.bc() && reg.de() == other.reg.de() && reg.hl() == other.reg.hl()
+				&& ir == other.ir && ime == other.ime && enablingIME == other.enablingIME
+				&& isHalted == other.isHalted && iF == other.iF;
+		}
+	};
+
+	auto save = [this] {
+		return State{ _ctx.reg, _ctx.ir, _ctx._ime, _ctx._enablingIME, _ctx._isHalted, _mem.GetInterruptRegs().second };
+	};
+	auto restore = [this](const State& state) {
+		_ctx.reg = state.reg;
+		_ctx.ir = state.ir;
+		_ctx._ime = state.ime;
+		_ctx._enablingIME = state.enablingIME;
+		_ctx._isHalted = state.isHalted;
+		_mem.Write(0xFF0F, state.iF);
+	};
+
+	const Context::SyncFunc sync = _sync;
+	void* const owner = _owner;
+	const u64 cyclesRan = _cyclesRan;
+
+	// Run the block without touching the hardware, recording the cycles of every instruction.
+	_sync = [](void* jit, u64 mCycles) {
+		static_cast<Jit*>(jit)->_validateCycles.push_back(mCycles);
+		return SyncResult::CONTINUE;
+	};
+	_owner = this;
+	_validateCycles.clear();
+	_instrsRan = 0;
+
+	// The hardware only catches up once the block is known to be right, below.
+	const Memory::CatchUp catchUp = _mem.GetCatchUp();
+	_mem.SetCatchUp({});
+
+	const State before = save();
+	std::vector<Memory::WriteRecord> jitWrites;
+
+	_mem.SetWriteJournal(&jitWrites);
+	_entryBanks = _mem.RomBankBases();
+	_ctx._mCycles = 0;
+
+	// Every instruction goes through Retire and syncs, so the cycles can be compared one by one.
+	_ctx.SetQuietCycles(0);
+	_inlineLimit = 0;
+
+	SetExecutable(true);
+	_enter(&_ctx, &_mem, this, block.code);
+	_mem.SetWriteJournal(nullptr);
+
+	_sync = sync;
+	_owner = owner;
+	_cyclesRan = cyclesRan;
+
+	std::vector<u64> cycles = std::move(_validateCycles);
+	_validateCycles = {};
+
+	// Mapper and io writes have side effects that can't be undone, so the block can't run twice.
+	const bool canUndo = std::ranges::none_of(jitWrites, [](const Memory::WriteRecord& write) {
+		return write.addr < romNEnd || (write.addr >= unusableEnd && write.addr < ioEnd);
+	});
+
+	if (canUndo) {
+		const State jitState = save();
+
+		for (auto it = jitWrites.rbegin(); it != jitWrites.rend(); ++it)
+			_mem.Write(it->addr, it->oldVal);
+
+		restore(before);
+
+		// Fused instructions would run more than one instruction per update.
+		const bool fusionEnabled = _ctx._fusionEnabled;
+		_ctx._fusionEnabled = false;
+
+		std::vector<Memory::WriteRecord> writes;
+		std::vector<u64> updateCycles;
+
+		_mem.SetWriteJournal(&writes);
+		for (u32 i = 0; i < _instrsRan; ++i) {
+			if (!_ctx.Update()) {
+				_mem.SetWriteJournal(nullptr);
+				_mem.SetCatchUp(catchUp);
+				_ctx._fusionEnabled = fusionEnabled;
+				return false;
+			}
+
+			updateCycles.push_back(_ctx._mCycles);
+		}
+		_mem.SetWriteJournal(nullptr);
+		_ctx._fusionEnabled = fusionEnabled;
+
+		// The hardware catches up on these below.
+		_ctx._mCycles = 0;
+
+		const bool sameWrites = std::ranges::equal(jitWrites, writes, [](const auto& a, const auto& b) {
+			return a.addr == b.addr && a.newVal == b.newVal;
+		});
+
+		const State updateState = save();
+
+		if (!(jitState == updateState) || cycles != updateCycles || !sameWrites) {
+			debug::cexpr::forceprinterr("Jit block at {:#06x} ({} instructions) doesn't match the interpreter!\n",
+										block.pc, _instrsRan);
+			debug::cexpr::forceprinterr("jit:    pc: {:#06x} sp: {:#06x} af: {:#06x} bc: {:#06x} de: {:#06x} hl: {:#06x} "
+										"cycles: {} writes: {}\n", jitState.reg.pc, jitState.reg.sp, jitState.reg.af(),
+										jitState.reg.bc(), jitState.reg.de(), jitState.reg.hl(), cycles.size(),
+										jitWrites.size());
+			debug::cexpr::forceprinterr("update: pc: {:#06x} sp: {:#06x} af: {:#06x} bc: {:#06x} de: {:#06x} hl: {:#06x} "
+										"cycles: {} writes: {}\n", updateState.reg.pc, updateState.reg.sp,
+										updateState.reg.af(), updateState.reg.bc(), updateState.reg.de(),
+										updateState.reg.hl(), updateCycles.size(), writes.size());
+			BREAKPOINT;
+
+			// Keep going with the interpreter, it already has the right state.
+			_ctx._jitEnabled = false;
+		}
+
+		cycles = std::move(updateCycles);
+	}
+
+	_mem.SetCatchUp(catchUp);
+
+	// Now the hardware can catch up, one instruction at a time like it normally would.
+	for (u64 mCycles : cycles) {
+		_cyclesRan += mCycles;
+
+		_synced = _sync(_owner, mCycles);
+		if (_synced != SyncResult::CONTINUE)
+			break;
+	}
+
+	return true;
+}
+
+void Jit::Emit(std::initializer_list<byte> bytes) {
+	for (byte b : bytes)
+		*_emit++ = b;
+}
+
+void Jit::Emit16(u16 val) {
+	std::memcpy(_emit, &val, sizeof(val));
+	_emit += sizeof(val);
+}
+
+void Jit::Emit32(u32 val) {
+	std::memcpy(_emit, &val, sizeof(val));
+	_emit += sizeof(val);
+}
+
+void Jit::Emit64(u64 val) {
+	std::memcpy(_emit, &val, sizeof(val));
+	_emit += sizeof(val);
+}
+
+void Jit::EmitAddress(const void* ptr) {
+	Emit64(reinterpret_cast<u64>(ptr));
+}
+
+byte* Jit::EmitJump(std::initializer_list<byte> op) {
+	Emit(op);
+
+	byte* rel32 = _emit;
+	Emit32(0);
+
+	return rel32;
+}
+
+void Jit::PatchJump(byte* rel32, const byte* target) {
+	const auto offset = static_cast<std::int32_t>(target - (rel32 + sizeof(u32)));
+	std::memcpy(rel32, &offset, sizeof(offset));
+}
+
+} // namespace gb::cpu
+
+#endif // JIT
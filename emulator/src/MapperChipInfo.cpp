@@ -56,7 +56,7 @@ byte MBC1::Bank(u16 addr) const {
 
 OptByteRef MBC1::ReadRom(Memory& mem, u16 addr) {
 	if (addr < romNEnd)
-		return mem.ReadRom((Bank(addr) << 14) | (addr & 0x3FFF));
+		return mem.ReadRom((static_cast<u32>(Bank(addr)) << 14) | (addr & 0x3FFF));
 
 	return {};
 }
@@ -98,9 +98,29 @@ Memory::Memory(rom::RomData&& data, Timer& timerRegsRef)
 	, _mapperChip(GetMapperChipType(_romData[0x0147]))
 {
 	_dmaTransfer.active = false;
+
+	// rom sizes are always a power of 2
+	_romAddrMask = static_cast<u32>(std::bit_floor(_romData.size())) - 1;
+	UpdateRomBanks();
+	UpdatePendingInterrupts();
+}
+
+void Memory::UpdateRomBanks() {
+	if (!_mapperChipData)
+		return;
+
+	_romBankBase[0] = (static_cast<u32>(_mapperChipData->Bank(0)) * romBankSize) & _romAddrMask;
+	_romBankBase[1] = (static_cast<u32>(_mapperChipData->Bank(rom0End)) * romBankSize) & _romAddrMask;
 }
 
 byte& Memory::Read(u16 addr) {
+#if defined(DEBUG) && defined(TESTS)
+	if (_flatRam) [[unlikely]]
+		return (*_flatRam)[addr];
+#endif
+
+	CatchUpHardware(addr);
+
 	// TODO: different behavior for this check on cgb
 	// during OAM DMA, cpu can only access HRAM.
 	// ppu cannot read OAM properly either
@@ -170,13 +190,33 @@ byte& Memory::Read(u16 addr) {
 }
 
 void Memory::Write(u16 addr, byte val) {
+#ifdef JIT
+	if (_writeJournal) [[unlikely]] {
+		// reading the unusable range isn't implemented yet
+		const bool readable = addr < oamEnd || addr >= unusableEnd;
+		_writeJournal->push_back({ addr, readable ? Read(addr) : byte{ 0 }, val });
+	}
+#endif
+
+#if defined(DEBUG) && defined(TESTS)
+	if (_flatRam) [[unlikely]] {
+		(*_flatRam)[addr] = val;
+		_flatWrites->push_back({ addr, val });
+		return;
+	}
+#endif
+
+	CatchUpHardware(addr);
+
 	// TODO: different behavior for this check on cgb
 	if (IsDMAActive() && (addr < ioEnd || addr == regIE))
 		return;
 
 	if (addr < romNEnd) {
-		if (_mapperChipData->AttemptWriteRam(addr, val))
+		if (_mapperChipData->AttemptWriteRam(addr, val)) {
+			UpdateRomBanks();
 			return;
+		}
 	}
 	// [$8000, $9FFF]
 	else if (addr < vramEnd) {
@@ -195,12 +235,14 @@ void Memory::Write(u16 addr, byte val) {
 	else if (addr < ramNEnd) {
 		// TODO?: cgb has switchable banks (1-7)
 		_ramInternal[addr - 0xC000] = val;
+		MarkCodeWrite(addr - 0xC000);
 		return;
 	}
 	// [$E000, $FDFF]
 	else if (addr < echoRamEnd) {
 		// mapped to wram
 		_ramInternal[addr - 0xE000] = val;
+		MarkCodeWrite(addr - 0xE000);
 		return;
 	}
 	// [$FE00, $FE9F]
@@ -225,16 +267,23 @@ void Memory::Write(u16 addr, byte val) {
 			_dmaTransfer = oam::TransferData(val); // reset transfer state to be on
 
 		_io.Write(addr, val);
+
+		// if, or stat which can request an lcd interrupt
+		if (addr == 0xFF0F || addr == 0xFF41)
+			UpdatePendingInterrupts();
+
 		return;
 	}
 	// [$FF80, $FFFE]
 	else if (addr < hramEnd) {
 		_hram[addr - 0xFF80] = val;
+		MarkCodeWrite(0x2000 + (addr - 0xFF80));
 		return;
 	}
 	// $FFFF
 	else {
 		_io.ie = val;
+		UpdatePendingInterrupts();
 		return;
 	}
 	
@@ -0,0 +1,79 @@
+#ifdef OPCODE_PROFILER
+#include <algorithm>
+#include <format>
+#include <print>
+#include <string>
+
+#include "OpcodeProfiler.hpp"
+#include "CPU.hpp"
+
+namespace gb::cpu {
+
+void OpcodeProfiler::Reset() {
+	_main.fill({});
+	_cb.fill({});
+}
+
+std::vector<OpcodeProfiler::Row> OpcodeProfiler::SortedRows() const {
+	std::vector<Row> rows;
+
+	for (std::size_t op = 0; op < 256; ++op) {
+		if (_main[op].count != 0)
+			rows.push_back({ static_cast<byte>(op), false, _main[op] });
+
+		if (_cb[op].count != 0)
+			rows.push_back({ static_cast<byte>(op), true, _cb[op] });
+	}
+
+	std::ranges::sort(rows, [](const Row& lhs, const Row& rhs) {
+		if (lhs.entry.mCycles != rhs.entry.mCycles)
+			return lhs.entry.mCycles > rhs.entry.mCycles;
+
+		return lhs.entry.count > rhs.entry.count;
+	});
+
+	return rows;
+}
+
+void OpcodeProfiler::WriteText(std::ostream& out) const {
+	const std::vector<Row> rows = SortedRows();
+
+	u64 totalCount = 0;
+	u64 totalCycles = 0;
+	for (const Row& row : rows) {
+		totalCount += row.entry.count;
+		totalCycles += row.entry.mCycles;
+	}
+
+	std::println(out, "{} instructions, {} mcycles", totalCount, totalCycles);
+	std::println(out, "{:<8}{:<18}{:>14}{:>8}{:>14}{:>8}{:>6}", "op", "handler", "count", "%", "mcycles", "%", "avg");
+
+	for (const Row& row : rows) {
+		const std::string op = row.prefixed ? std::format("cb {:02x}", row.op) : std::format("{:02x}", row.op);
+
+		std::println(out, "{:<8}{:<18}{:>14}{:>7.2f}%{:>14}{:>7.2f}%{:>6.2f}",
+					 op, Context::InstrName(row.op, row.prefixed),
+					 row.entry.count, 100.0 * row.entry.count / totalCount,
+					 row.entry.mCycles, 100.0 * row.entry.mCycles / totalCycles,
+					 static_cast<double>(row.entry.mCycles) / row.entry.count);
+	}
+}
+
+void OpcodeProfiler::WriteJson(std::ostream& out) const {
+	const std::vector<Row> rows = SortedRows();
+
+	std::println(out, "[");
+
+	for (std::size_t i = 0; i < rows.size(); ++i) {
+		const Row& row = rows[i];
+
+		std::println(out, "\t{{ \"op\": {}, \"prefixed\": {}, \"handler\": \"{}\", \"count\": {}, \"mcycles\": {} }}{}",
+					 row.op, row.prefixed, Context::InstrName(row.op, row.prefixed),
+					 row.entry.count, row.entry.mCycles, i + 1 < rows.size() ? "," : "");
+	}
+
+	std::println(out, "]");
+}
+
+} // namespace gb::cpu
+#endif // OPCODE_PROFILER
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "PPU.hpp"
 #include "Memory.hpp"
 
@@ -83,6 +85,100 @@ State GContext::Update() {
 	return State::PROCESSING;
 }
 
+// Nothing is drawn from the fifos yet (Tick never gets past its delay), so drawing only counts dots like the other modes.
+u32 GContext::QuietDots() const {
+	return ModeEnd(GetMode()) - _curDot;
+}
+
+u32 GContext::HaltedDots() const {
+	const auto [ie, iF] = _memory.GetInterruptRegs();
+	const bool lcdEnabled = (ie & static_cast<byte>(Interrupt::LCD)) != 0;
+
+	const LCDStatus stat = static_cast<LCDStatus>(_memory[0xFF41]);
+	const byte lyc = _memory[0xFF45];
+
+	Mode mode = GetMode();
+	byte ly = _memory[0xFF44];
+	u32 dots = ModeEnd(mode) - _curDot;
+
+	// Same mode changes as Update, each taking one more dot. Lines only change when leaving h/vblank.
+	while (true) {
+		byte newLy = ly;
+		Mode newMode = mode;
+
+		switch (mode) {
+		case Mode::OAM_SCAN:
+			newMode = Mode::PIXEL_DRAW;
+			break;
+		case Mode::PIXEL_DRAW:
+			newMode = Mode::HBLANK;
+			break;
+		case Mode::HBLANK:
+			newLy = static_cast<byte>(ly + 1);
+			newMode = newLy == vBlankStart ? Mode::VBLANK : Mode::OAM_SCAN;
+			break;
+		case Mode::VBLANK:
+			newLy = ly == lineMax ? 0 : static_cast<byte>(ly + 1);
+			newMode = newLy == 0 ? Mode::OAM_SCAN : Mode::VBLANK;
+			break;
+		}
+
+		// Vblank always stops it, since the frame ends there.
+		if (newMode == Mode::VBLANK && mode != Mode::VBLANK)
+			return dots;
+
+		// Same as UpdateLine and SetMode.
+		const bool lycRequest = newLy != ly && newLy == lyc && stat.flags.LycIntSelect == 1;
+		const bool modeRequest = newMode != mode &&
+			((newMode == Mode::HBLANK && stat.flags.M0Select == 1) || (newMode == Mode::OAM_SCAN && stat.flags.M2Select == 1));
+
+		if (lcdEnabled && (lycRequest || modeRequest))
+			return dots;
+
+		dots += 1 + ModeEnd(newMode) - ModeStart(newMode);
+
+		ly = newLy;
+		mode = newMode;
+	}
+}
+
+void GContext::Skip(u32 dots) {
+	// Dots within a mode only count up. The update that changes it is a normal one.
+	while (true) {
+		const u32 counted = std::min<u32>(dots, ModeEnd(GetMode()) - _curDot);
+		_curDot += static_cast<u16>(counted);
+		dots -= counted;
+
+		if (dots == 0)
+			return;
+
+		Update();
+		--dots;
+	}
+}
+
+u16 GContext::ModeEnd(Mode mode) const {
+	switch (mode) {
+	case Mode::OAM_SCAN:
+		return oamScanDots;
+	case Mode::PIXEL_DRAW:
+		return _pixelDrawDots;
+	default:
+		return dotsPerLine;
+	}
+}
+
+u16 GContext::ModeStart(Mode mode) const {
+	switch (mode) {
+	case Mode::PIXEL_DRAW:
+		return oamScanDots;
+	case Mode::HBLANK:
+		return _pixelDrawDots;
+	default:
+		return 0;
+	}
+}
+
 void GContext::UpdateLine(byte& ly, bool zero) {
 	if (zero)
 		ly = 0;
@@ -98,7 +194,7 @@ void GContext::UpdateLine(byte& ly, bool zero) {
 		statFlags.flags.LycEqLy = 1;
 
 		if (statFlags.flags.LycIntSelect == 1)
-			_memory.GetInterruptFlag().flags.LCDInt = 1;
+			_memory.RequestInterrupt(Interrupt::LCD);
 
 		stat = statFlags;
 	}
@@ -117,13 +213,13 @@ void GContext::SetMode(Mode newMode) {
 	stat |= static_cast<byte>(newMode); // then set to new value
 
 	if (newMode == Mode::VBLANK)
-		_memory.GetInterruptFlag().flags.VBlankInt = 1;
+		_memory.RequestInterrupt(Interrupt::VBLANK);
 
 	if (newMode != Mode::PIXEL_DRAW) {
 		byte statIntBit = (1 << 3) << static_cast<byte>(newMode);
 
 		if ((stat & statIntBit) != 0)
-			_memory.GetInterruptFlag().flags.LCDInt = 1; // LCDInt == Stat Int
+			_memory.RequestInterrupt(Interrupt::LCD); // LCDInt == Stat Int
 	}
 }
 
@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "Recompiled.hpp"
+#include "ROM.hpp"
+#include "ConstexprAdditions.hpp"
+
+namespace gb::cpu {
+
+using SyncResult = Context::SyncResult;
+
+Recompiled::Recompiled(Context& ctx, Memory& mem, const RecompiledRom& rom)
+	: _ctx(ctx)
+	, _mem(mem)
+	, _blocks((mem.RomSize() + blockPageSize - 1) / blockPageSize)
+{
+	for (const RecompiledBlock& block : rom.blocks) {
+		if (block.romAddr >= mem.RomSize())
+			continue;
+
+		auto& page = _blocks[block.romAddr / blockPageSize];
+		if (!page)
+			page = std::make_unique<BlockPage>();
+
+		(*page)[block.romAddr % blockPageSize] = block.run;
+	}
+}
+
+bool Recompiled::Matches(const Memory& mem, const RecompiledRom& rom) {
+	const std::span<const byte> data = mem.GetRom();
+	if (data.size() < headerEnd || static_cast<u16>(data[0x014E] << 8 | data[0x014F]) != rom.globalChecksum)
+		return false;
+
+	// Hacks and patched roms usually keep the original header, checksum included.
+	return std::ranges::all_of(rom.banks, [&](const RecompiledBank& bank) {
+		const std::size_t start = static_cast<std::size_t>(bank.bank) * romBankSize;
+		if (start >= data.size())
+			return false;
+
+		return rom::Hash(data.subspan(start, std::min<std::size_t>(romBankSize, data.size() - start))) == bank.hash;
+	});
+}
+
+bool Recompiled::Run(u64 cycleBudget, Context::SyncFunc sync, void* owner) {
+	_sync = sync;
+	_owner = owner;
+	_cyclesRan = 0;
+	_cycleBudget = cycleBudget;
+	_synced = SyncResult::CONTINUE;
+
+	// The hardware was synced at the end of the last update, so nothing's pending. What it said was quiet
+	// then may not be anymore.
+	_ctx._mCycles = 0;
+	_ctx.SetQuietCycles(0);
+
+	while (_cyclesRan < cycleBudget && _synced == SyncResult::CONTINUE) {
+		// Halting, skipping, dma, breakpoints, and dumping or checking state all go through the interpreter.
+		bool useUpdate = _ctx._isHalted || _ctx._skipCycles != 0 || _mem.IsDMAActive() || _ctx.reg.pc >= romNEnd
+			|| _ctx.IsTracing() || _ctx.HasBreakCheck();
+#ifdef OPCODE_PROFILER
+		useUpdate = true;
+#endif
+
+		if (BlockFunc block = useUpdate ? nullptr : Lookup()) {
+			_entryBanks = _mem.RomBankBases();
+			block(_ctx, _mem, *this);
+			continue;
+		}
+
+		// The interpreter starts its update from 0 cycles.
+		if (!Flush())
+			break;
+
+		if (!Step())
+			return false;
+	}
+
+	Flush();
+	return _synced != SyncResult::FAILED;
+}
+
+Recompiled::BlockFunc Recompiled::Lookup() const {
+	const u32 romAddr = _mem.RomPhysicalAddr(_ctx.reg.pc);
+	if (romAddr >= _mem.RomSize())
+		return nullptr;
+
+	const auto& page = _blocks[romAddr / blockPageSize];
+	return page ? (*page)[romAddr % blockPageSize] : nullptr;
+}
+
+bool Recompiled::Step() {
+	if (!_ctx.Update())
+		return false;
+
+	++_interpretedInstrs;
+
+	// Synced even when it stopped at a breakpoint without running anything, so the pause is seen.
+	const u64 mCycles = std::exchange(_ctx._mCycles, 0);
+	_cyclesRan += mCycles;
+	_synced = _sync(_owner, mCycles);
+
+	return true;
+}
+
+} // namespace gb::cpu
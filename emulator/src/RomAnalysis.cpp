@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "RomAnalysis.hpp"
+#include "InstrInfo.hpp"
+
+namespace gb::rom {
+
+using cpu::Flow;
+using cpu::instrInfo;
+
+// The same entry points and bank switch pattern gbrecomp traces from.
+static constexpr byte ldAccImm8 = 0x3E;
+static constexpr byte ldImm16Acc = 0xEA;
+static constexpr u16 romBankSelect = 0x2000;
+
+static constexpr u16 entryPoint = 0x0100;
+static constexpr std::array<u16, 13> vectors = {
+	0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38,
+	0x40, 0x48, 0x50, 0x58, 0x60
+};
+
+// No bank is known to be mapped into [$4000, $7FFF].
+static constexpr u32 unknownBank = 0;
+static constexpr u32 noRomAddr = ~0u;
+
+namespace {
+
+// Code at addr with bank mapped into [$4000, $7FFF].
+struct Entry {
+	u16 addr;
+	u32 bank;
+};
+
+// Everything one thread touches while tracing one bank. Entries into other banks are handed over between rounds.
+struct BankTrace {
+	std::set<std::pair<u16, u32>> visited;
+	std::vector<Entry> worklist;
+	std::vector<Entry> outgoing;
+	std::map<u32, Analysis::Block> blocks;
+};
+
+class Tracer {
+public:
+	Tracer(const RomData& rom, std::vector<Analysis::Byte>& map)
+		: _rom(rom)
+		, _map(map)
+		, _bankCount(std::max<u32>(2, static_cast<u32>(rom.size() / romBankSize)))
+	{}
+
+	// Physical address of the entry after filling in the bank small roms always have mapped, or noRomAddr.
+	u32 Resolve(Entry& entry) const {
+		if (entry.bank == unknownBank && _bankCount <= 2)
+			entry.bank = 1;
+
+		return RomAddr(entry.addr, entry.bank);
+	}
+
+	// Returns the physical address of the entry, or noRomAddr if it can't be traced.
+	u32 AddEntry(Entry entry, BankTrace& trace, u32 bank) const {
+		const u32 romAddr = Resolve(entry);
+		if (romAddr == noRomAddr)
+			return noRomAddr;
+
+		if (romAddr / romBankSize != bank)
+			trace.outgoing.push_back(entry);
+		else if (trace.visited.emplace(entry.addr, entry.bank).second)
+			trace.worklist.push_back(entry);
+
+		return romAddr;
+	}
+
+	void TraceBank(BankTrace& trace, u32 bank) const {
+		while (!trace.worklist.empty()) {
+			const Entry entry = trace.worklist.back();
+			trace.worklist.pop_back();
+
+			TraceBlock(entry, trace, bank);
+		}
+	}
+
+private:
+	void TraceBlock(Entry entry, BankTrace& trace, u32 bank) const {
+		const u32 start = RomAddr(entry.addr, entry.bank);
+
+		Analysis::Block block{ start, start, static_cast<u16>(bank), entry.addr, {} };
+
+		std::optional<byte> knownAcc;
+		u32 mappedBank = entry.bank;
+		u16 pc = entry.addr;
+
+		byte lastOp = 0;
+		u16 lastImm = 0;
+		Flow flow = Flow::NEXT;
+
+		while (true) {
+			const u32 romAddr = RomAddr(pc, entry.bank);
+			if (romAddr == noRomAddr)
+				break;
+
+			const byte op = _rom[romAddr];
+			const cpu::InstrInfo info = instrInfo[op];
+
+			if (info.flow == Flow::INVALID)
+				break;
+
+			// The whole instruction has to be in the same rom window.
+			const u16 last = static_cast<u16>(pc + info.length - 1);
+			if (last / romBankSize != pc / romBankSize || RomAddr(last, entry.bank) == noRomAddr)
+				break;
+
+			u16 imm = 0;
+			for (byte i = 1; i < info.length; ++i)
+				imm |= static_cast<u16>(_rom[romAddr + i] << (8 * (i - 1)));
+
+			// The first trace to reach a byte decides what it is, so overlapping instructions don't flip it back and forth.
+			if (_map[romAddr] == Analysis::Byte::UNKNOWN)
+				_map[romAddr] = Analysis::Byte::OPCODE;
+			for (byte i = 1; i < info.length; ++i) {
+				if (_map[romAddr + i] == Analysis::Byte::UNKNOWN)
+					_map[romAddr + i] = Analysis::Byte::OPERAND;
+			}
+
+			pc += info.length;
+			block.end = romAddr + info.length;
+			lastOp = op;
+			lastImm = imm;
+			flow = info.flow;
+
+			if (cpu::EndsBlock(info.flow))
+				break;
+
+			// Running off the end of a window lands in another bank's trace.
+			if (pc % romBankSize == 0)
+				break;
+
+			if (op == ldAccImm8) {
+				knownAcc = static_cast<byte>(imm);
+				continue;
+			}
+
+			if (op == ldImm16Acc && imm >= romBankSelect && imm < rom0End) {
+				if (knownAcc) {
+					mappedBank = (*knownAcc & 0x1F) == 0 ? 1 : (*knownAcc & 0x1F);
+					mappedBank %= _bankCount;
+				}
+				else
+					mappedBank = unknownBank;
+
+				// Code after it in [$4000, $7FFF] is now in a different bank, so it has to be a new block.
+				break;
+			}
+
+			knownAcc.reset();
+		}
+
+		if (block.end == start)
+			return;
+
+		auto addSuccessor = [&](u16 target) {
+			if (const u32 romAddr = AddEntry({ target, mappedBank }, trace, bank); romAddr != noRomAddr)
+				block.successors.push_back(romAddr);
+		};
+
+		const byte lastLength = instrInfo[lastOp].length;
+
+		switch (flow) {
+		case Flow::NEXT:
+		case Flow::HALT:
+		case Flow::STOP:
+			addSuccessor(pc);
+			break;
+		case Flow::JUMP:
+		case Flow::COND_JUMP:
+			addSuccessor(lastLength == 2 ? static_cast<u16>(pc + static_cast<sbyte>(lastImm)) : lastImm);
+			break;
+		case Flow::CALL:
+		case Flow::COND_CALL:
+			addSuccessor(lastLength == 1 ? static_cast<u16>(lastOp & 0b00'111'000) : lastImm);
+			// the call returns to the next instruction
+			addSuccessor(pc);
+			break;
+		default:
+			break;
+		}
+
+		if (flow == Flow::COND_JUMP || flow == Flow::COND_RET)
+			addSuccessor(pc);
+
+		// Code in bank 0 is traced again for every bank it's reached with, which only changes where it goes.
+		auto [it, added] = trace.blocks.try_emplace(start, std::move(block));
+		if (!added)
+			it->second.successors.insert(it->second.successors.end(), block.successors.begin(), block.successors.end());
+	}
+
+	u32 RomAddr(u16 addr, u32 bank) const {
+		u32 romAddr = noRomAddr;
+
+		if (addr < rom0End)
+			romAddr = addr;
+		else if (addr < romNEnd && bank != unknownBank)
+			romAddr = bank * romBankSize + (addr - rom0End);
+
+		return romAddr < _rom.size() ? romAddr : noRomAddr;
+	}
+
+private:
+	const RomData& _rom;
+	std::vector<Analysis::Byte>& _map;
+	u32 _bankCount;
+};
+
+} // namespace
+
+Analysis::Analysis(const RomData& rom, u64 hash, std::size_t threads)
+	: _hash(hash)
+	, _map(rom.size(), Byte::UNKNOWN)
+{
+	Tracer tracer{ rom, _map };
+	std::vector<BankTrace> traces((rom.size() + romBankSize - 1) / romBankSize);
+
+	// bank 1 is mapped on power up
+	std::vector<Entry> pending{ { entryPoint, 1 } };
+	for (u16 vector : vectors)
+		pending.push_back({ vector, unknownBank });
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// Every round traces each bank with new entries on its own thread, until no bank reaches into another one it
+	// hasn't been traced with yet. Each thread only writes to its own bank of the map.
+	std::vector<u32> active;
+	while (!pending.empty()) {
+		active.clear();
+
+		for (Entry entry : pending) {
+			const u32 romAddr = tracer.Resolve(entry);
+			if (romAddr == noRomAddr)
+				continue;
+
+			const u32 bank = romAddr / romBankSize;
+			if (traces[bank].visited.emplace(entry.addr, entry.bank).second) {
+				if (traces[bank].worklist.empty())
+					active.push_back(bank);
+
+				traces[bank].worklist.push_back(entry);
+			}
+		}
+
+		pending.clear();
+
+		const std::size_t workerCount = std::min(threads, active.size());
+		std::atomic<std::size_t> next = 0;
+
+		auto work = [&] {
+			for (std::size_t i = next++; i < active.size(); i = next++)
+				tracer.TraceBank(traces[active[i]], active[i]);
+		};
+
+		if (workerCount <= 1)
+			work();
+		else {
+			std::vector<std::jthread> workers;
+			workers.reserve(workerCount);
+
+			for (std::size_t i = 0; i < workerCount; ++i)
+				workers.emplace_back(work);
+		}
+
+		// In bank order, so the result doesn't depend on which thread finished first.
+		std::ranges::sort(active);
+		for (u32 bank : active) {
+			pending.insert(pending.end(), traces[bank].outgoing.begin(), traces[bank].outgoing.end());
+			traces[bank].outgoing.clear();
+		}
+	}
+
+	for (BankTrace& trace : traces) {
+		for (auto& [start, block] : trace.blocks)
+			_blocks.push_back(std::move(block));
+	}
+
+	// A block that something jumps into the middle of ends there instead, and falls through to the one starting there.
+	// Blocks are traced until they end on their own, so the later one already ends where this one did.
+	for (std::size_t i = 0; i + 1 < _blocks.size(); ++i) {
+		Block& block = _blocks[i];
+		Block& next = _blocks[i + 1];
+
+		if (next.start >= block.end || next.end != block.end)
+			continue;
+
+		u32 addr = block.start;
+		while (addr < next.start)
+			addr += instrInfo[rom[addr]].length;
+
+		if (addr != next.start)
+			continue;
+
+		next.successors.insert(next.successors.end(), block.successors.begin(), block.successors.end());
+		block.end = next.start;
+		block.successors = { next.start };
+	}
+
+	for (Block& block : _blocks) {
+		std::ranges::sort(block.successors);
+		block.successors.erase(std::ranges::unique(block.successors).begin(), block.successors.end());
+	}
+
+	_codeBytes = static_cast<std::size_t>(std::ranges::count_if(_map, [](Byte kind) { return kind != Byte::UNKNOWN; }));
+}
+
+u64 Analysis::Hash(const RomData& rom) {
+	return rom::Hash(rom);
+}
+
+const Analysis::Block* Analysis::BlockAt(u32 physicalAddr) const {
+	const auto next = std::ranges::upper_bound(_blocks, physicalAddr, {}, &Block::start);
+	if (next == _blocks.begin())
+		return nullptr;
+
+	const Block& block = *std::prev(next);
+	return physicalAddr < block.end ? &block : nullptr;
+}
+
+std::shared_future<SharedAnalysis> AnalyseAsync(RomData rom) {
+	static std::mutex cacheMutex;
+	static std::unordered_map<u64, std::shared_future<SharedAnalysis>> cache;
+
+	return std::async(std::launch::async, [rom = std::move(rom)] {
+		const u64 hash = Analysis::Hash(rom);
+
+		std::promise<SharedAnalysis> promise;
+		std::shared_future<SharedAnalysis> shared;
+		bool first = false;
+
+		{
+			std::scoped_lock lock{ cacheMutex };
+
+			auto [it, added] = cache.try_emplace(hash);
+			if (added)
+				it->second = promise.get_future().share();
+
+			shared = it->second;
+			first = added;
+		}
+
+		if (first)
+			promise.set_value(std::make_shared<const Analysis>(rom, hash));
+
+		return shared.get();
+	}).share();
+}
+
+} // namespace gb::rom
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <format>
+#include <map>
+#include <print>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "SamplingProfiler.hpp"
+
+namespace gb {
+
+// Mcycles in a frame, to turn samples into time per frame.
+static constexpr double frameCycles = 70224 / 4;
+
+// How many of the hottest addresses the text report lists.
+static constexpr std::size_t hottestAddrs = 32;
+
+SamplingProfiler::SamplingProfiler(u64 interval, std::optional<SymbolTable> symbols)
+	: _interval(std::max<u64>(interval, 1))
+	, _symbols(std::move(symbols))
+{}
+
+void SamplingProfiler::Reset() {
+	_size = 0;
+	_counts.clear();
+	_total = 0;
+}
+
+void SamplingProfiler::Flush() {
+	for (const Sample& sample : std::span{ _buffer.data(), _size }) {
+		_counts[Key(sample.bank, sample.pc)] += sample.count;
+		_total += sample.count;
+	}
+
+	_size = 0;
+}
+
+void SamplingProfiler::WriteText(std::ostream& out) {
+	Flush();
+
+	struct Row {
+		std::string name;
+		u64 samples;
+	};
+
+	// Samples at every address are also added up for the symbol they're in.
+	std::map<std::string, u64> bySymbol;
+	std::vector<Row> byAddr;
+
+	for (const auto& [key, samples] : _counts) {
+		const u16 bank = static_cast<u16>(key >> 16);
+		const u16 pc = static_cast<u16>(key);
+		const SymbolTable::Symbol* symbol = _symbols ? _symbols->Find(bank, pc) : nullptr;
+
+		bySymbol[symbol ? symbol->name : std::format("${:02X}:????", bank)] += samples;
+		byAddr.push_back({ std::format("${:02X}:{:04X} {}", bank, pc, _symbols ? _symbols->Resolve(bank, pc) : ""), samples });
+	}
+
+	std::vector<Row> symbolRows;
+	for (auto& [name, samples] : bySymbol)
+		symbolRows.push_back({ name, samples });
+
+	auto bySamples = [](const Row& lhs, const Row& rhs) { return lhs.samples > rhs.samples; };
+	std::ranges::sort(symbolRows, bySamples);
+	std::ranges::sort(byAddr, bySamples);
+
+	const u64 total = std::max<u64>(_total, 1);
+
+	std::println(out, "{} samples, one every {} mcycles ({:.0f} frames), {} symbols loaded",
+				 _total, _interval, _total * _interval / frameCycles, _symbols ? _symbols->Size() : 0);
+
+	auto printRows = [&](std::string_view title, std::span<const Row> rows) {
+		std::println(out, "");
+		std::println(out, "{:<40}{:>12}{:>8}{:>16}", title, "samples", "%", "mcycles/frame");
+
+		for (const Row& row : rows) {
+			const double fraction = static_cast<double>(row.samples) / total;
+			std::println(out, "{:<40}{:>12}{:>7.2f}%{:>16.1f}", row.name, row.samples, 100.0 * fraction, fraction * frameCycles);
+		}
+	};
+
+	printRows("symbol", symbolRows);
+	printRows("address", std::span{ byAddr }.first(std::min(byAddr.size(), hottestAddrs)));
+}
+
+void SamplingProfiler::WriteCollapsed(std::ostream& out) {
+	Flush();
+
+	// Sorted so the same run always writes the same file.
+	std::map<std::string, u64> stacks;
+
+	for (const auto& [key, samples] : _counts) {
+		const u16 bank = static_cast<u16>(key >> 16);
+		const u16 pc = static_cast<u16>(key);
+		std::string stack = std::format("bank ${:02X}", bank);
+
+		if (const SymbolTable::Symbol* symbol = _symbols ? _symbols->Find(bank, pc) : nullptr) {
+			// local labels get their own frame under the global label they belong to
+			const std::string_view name = symbol->name;
+			if (const auto dot = name.find('.'); dot != std::string_view::npos && dot != 0)
+				stack += std::format(";{};{}", name.substr(0, dot), name);
+			else
+				stack += std::format(";{}", name);
+		}
+		else
+			stack += std::format(";${:04X}", pc);
+
+		stacks[stack] += samples;
+	}
+
+	for (const auto& [stack, samples] : stacks)
+		std::println(out, "{} {}", stack, samples);
+}
+
+} // namespace gb
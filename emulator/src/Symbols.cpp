@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+#include "Symbols.hpp"
+
+namespace gb {
+
+// Start of the memory region addr is in. A symbol never covers anything past the end of its region.
+static u16 RegionStart(u16 addr) {
+	if (addr < rom0End)
+		return 0;
+	else if (addr < romNEnd)
+		return rom0End;
+	else if (addr < vramEnd)
+		return romNEnd;
+	else if (addr < ramCartEnd)
+		return vramEnd;
+	else if (addr < ram0End)
+		return ramCartEnd;
+	else if (addr < ramNEnd)
+		return ram0End;
+	else if (addr < ioEnd)
+		return ramNEnd;
+
+	return ioEnd;
+}
+
+static std::string_view Trim(std::string_view str) {
+	const auto first = str.find_first_not_of(" \t\r");
+	if (first == std::string_view::npos)
+		return {};
+
+	return str.substr(first, str.find_last_not_of(" \t\r") - first + 1);
+}
+
+template <typename T>
+static bool ParseHex(std::string_view str, T& val) {
+	auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), val, 16);
+	return ec == std::errc{} && ptr == str.data() + str.size();
+}
+
+std::optional<SymbolTable> SymbolTable::Load(const std::filesystem::path& path) {
+	std::ifstream stream{ path };
+	if (!stream)
+		return std::nullopt;
+
+	SymbolTable table;
+
+	for (std::string line; std::getline(stream, line);) {
+		std::string_view str = line;
+		str = Trim(str.substr(0, str.find(';')));
+
+		// bank:addr name
+		const auto colon = str.find(':');
+		const auto space = str.find_first_of(" \t");
+		if (colon == std::string_view::npos || space == std::string_view::npos || colon > space)
+			continue;
+
+		Symbol symbol{};
+		if (!ParseHex(str.substr(0, colon), symbol.bank) || !ParseHex(str.substr(colon + 1, space - colon - 1), symbol.addr))
+			continue;
+
+		symbol.name = Trim(str.substr(space));
+		if (!symbol.name.empty())
+			table._symbols.push_back(std::move(symbol));
+	}
+
+	table._byName = table._symbols;
+	std::ranges::sort(table._byName, {}, &Symbol::name);
+
+	// Global labels go before the local labels at the same address, so they're the ones kept.
+	std::ranges::sort(table._symbols, {}, [](const Symbol& symbol) {
+		return std::tuple{ symbol.bank, symbol.addr, symbol.name.contains('.'), std::string_view{ symbol.name } };
+	});
+	const auto dupes = std::ranges::unique(table._symbols, [](const Symbol& lhs, const Symbol& rhs) {
+		return lhs.bank == rhs.bank && lhs.addr == rhs.addr;
+	});
+	table._symbols.erase(dupes.begin(), dupes.end());
+
+	return table;
+}
+
+const SymbolTable::Symbol* SymbolTable::Find(u16 bank, u16 addr) const {
+	// first symbol past addr, the one before it is the closest
+	const auto next = std::ranges::upper_bound(_symbols, std::pair{ bank, addr }, {}, [](const Symbol& symbol) {
+		return std::pair{ symbol.bank, symbol.addr };
+	});
+
+	if (next == _symbols.begin())
+		return nullptr;
+
+	const Symbol& symbol = *std::prev(next);
+	if (symbol.bank != bank || RegionStart(symbol.addr) != RegionStart(addr))
+		return nullptr;
+
+	return &symbol;
+}
+
+std::string SymbolTable::Resolve(u16 bank, u16 addr) const {
+	const Symbol* symbol = Find(bank, addr);
+
+	if (symbol == nullptr)
+		return std::format("${:02X}:{:04X}", bank, addr);
+	else if (symbol->addr == addr)
+		return symbol->name;
+
+	return std::format("{}+${:X}", symbol->name, addr - symbol->addr);
+}
+
+const SymbolTable::Symbol* SymbolTable::Lookup(std::string_view name) const {
+	const auto symbol = std::ranges::lower_bound(_byName, name, {}, [](const Symbol& symbol) {
+		return std::string_view{ symbol.name };
+	});
+
+	if (symbol == _byName.end() || symbol->name != name)
+		return nullptr;
+
+	return &*symbol;
+}
+
+} // namespace gb
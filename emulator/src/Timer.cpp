@@ -1,3 +1,5 @@
+#include <limits>
+
 #include "Timer.hpp"
 #include "ConstexprAdditions.hpp"
 
@@ -18,15 +20,43 @@ bool Timer::Tick() {
 	if (tac.data.Enable == 0)
 		return false;
 
-	// 4 tcycles per mcycle
-	static constexpr u16 incRate[4] = { 256 << 1, 4 << 1, 16 << 1, 64 << 1 };
-
 	if ((prev & incRate[tac.data.ClockSelect]) != 0 && (divWhole & incRate[tac.data.ClockSelect]) == 0)
 		return Update();
 
 	return false;
 }
 
+u32 Timer::QuietTicks() const {
+	if (tac.data.Enable == 0)
+		return std::numeric_limits<u32>::max();
+
+	// tima increments every time div reaches a multiple of period.
+	const u32 period = incRate[tac.data.ClockSelect] << 1;
+	const u32 untilIncrement = period - divWhole % period;
+
+	// Update requests the interrupt when tima becomes $FF.
+	const u32 increments = static_cast<byte>(0xFE - tima) + 1u;
+
+	return untilIncrement + (increments - 1) * period - 1;
+}
+
+u32 Timer::QuietTimaTicks() const {
+	if (tac.data.Enable == 0)
+		return std::numeric_limits<u32>::max();
+
+	const u32 period = incRate[tac.data.ClockSelect] << 1;
+	return period - divWhole % period - 1;
+}
+
+void Timer::Skip(u32 ticks) {
+	if (tac.data.Enable != 0) {
+		const u32 period = incRate[tac.data.ClockSelect] << 1;
+		tima += static_cast<byte>((divWhole % period + ticks) / period);
+	}
+
+	divWhole += static_cast<u16>(ticks);
+}
+
 bool Timer::Update() {
 	// TODO: If a TMA write is executed on the same M-cycle as the content of TMA
 	// is transferred to TIMA due to a timer overflow, the old value
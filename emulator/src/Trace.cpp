@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <format>
+#include <iterator>
+
+#include "Trace.hpp"
+
+namespace gb {
+
+using trace::recordSize;
+using trace::IndexEntry;
+
+using PackedRecord = std::array<byte, recordSize>;
+
+#pragma region encoding
+// Everything is little endian no matter the platform.
+template <typename T>
+static void PutLE(byte* out, T val) {
+	for (std::size_t i = 0; i < sizeof(T); ++i)
+		out[i] = static_cast<byte>(val >> (8 * i));
+}
+
+template <typename T>
+static T GetLE(const byte* in) {
+	T val = 0;
+	for (std::size_t i = 0; i < sizeof(T); ++i)
+		val |= static_cast<T>(static_cast<T>(in[i]) << (8 * i));
+
+	return val;
+}
+
+template <typename T>
+static void WriteLE(std::ostream& out, T val) {
+	std::array<byte, sizeof(T)> bytes;
+	PutLE(bytes.data(), val);
+	out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+template <typename T>
+static bool ReadLE(std::istream& in, T& val) {
+	std::array<byte, sizeof(T)> bytes;
+	if (!in.read(reinterpret_cast<char*>(bytes.data()), bytes.size()))
+		return false;
+
+	val = GetLE<T>(bytes.data());
+	return true;
+}
+
+static PackedRecord Pack(const TraceRecord& record) {
+	PackedRecord packed;
+	PutLE(&packed[0], record.cycle);
+	PutLE(&packed[8], record.pc);
+	PutLE(&packed[10], record.bank);
+	PutLE(&packed[12], record.sp);
+	packed[14] = record.a;
+	packed[15] = record.f;
+	packed[16] = record.b;
+	packed[17] = record.c;
+	packed[18] = record.d;
+	packed[19] = record.e;
+	packed[20] = record.h;
+	packed[21] = record.l;
+	std::ranges::copy(record.pcMem, &packed[22]);
+	return packed;
+}
+
+static TraceRecord Unpack(const PackedRecord& packed) {
+	TraceRecord record{};
+	record.cycle = GetLE<u64>(&packed[0]);
+	record.pc = GetLE<u16>(&packed[8]);
+	record.bank = GetLE<u16>(&packed[10]);
+	record.sp = GetLE<u16>(&packed[12]);
+	record.a = packed[14];
+	record.f = packed[15];
+	record.b = packed[16];
+	record.c = packed[17];
+	record.d = packed[18];
+	record.e = packed[19];
+	record.h = packed[20];
+	record.l = packed[21];
+	std::ranges::copy_n(&packed[22], 4, record.pcMem.begin());
+	return record;
+}
+
+// Control bytes under 0x80 are followed by that many + 1 bytes as they are.
+// The rest stand for (control & 0x7F) + 1 zeros.
+static constexpr byte zeroRun = 0x80;
+static constexpr std::size_t maxRun = 0x80;
+
+static void CompressZeros(const std::vector<byte>& in, std::vector<byte>& out) {
+	std::size_t i = 0;
+
+	auto zerosAt = [&](std::size_t at) {
+		std::size_t run = 0;
+		while (at + run < in.size() && run < maxRun && in[at + run] == 0)
+			++run;
+
+		return run;
+	};
+
+	while (i < in.size()) {
+		if (const std::size_t zeros = zerosAt(i); zeros >= 2) {
+			out.push_back(static_cast<byte>(zeroRun | (zeros - 1)));
+			i += zeros;
+			continue;
+		}
+
+		// Literals until the next run of zeros worth encoding.
+		std::size_t literals = 1;
+		while (i + literals < in.size() && literals < maxRun && zerosAt(i + literals) < 2)
+			++literals;
+
+		out.push_back(static_cast<byte>(literals - 1));
+		out.insert(out.end(), in.begin() + i, in.begin() + i + literals);
+		i += literals;
+	}
+}
+
+static bool DecompressZeros(const std::vector<byte>& in, std::vector<byte>& out, std::size_t size) {
+	out.clear();
+
+	for (std::size_t i = 0; i < in.size();) {
+		const byte control = in[i++];
+		const std::size_t count = (control & ~zeroRun) + 1u;
+
+		if (control & zeroRun)
+			out.insert(out.end(), count, 0);
+		else {
+			if (i + count > in.size())
+				return false;
+
+			out.insert(out.end(), in.begin() + i, in.begin() + i + count);
+			i += count;
+		}
+	}
+
+	return out.size() == size;
+}
+#pragma endregion encoding
+
+std::string trace::FormatShortDump(const TraceRecord& record) {
+	return std::format("A:{:02X} F:{:02X} B:{:02X} C:{:02X} D:{:02X} E:{:02X} H:{:02X} L:{:02X} SP:{:04X} PC:{:04X} PCMEM:{:02X},{:02X},{:02X},{:02X}",
+					   record.a, record.f, record.b, record.c, record.d, record.e, record.h, record.l,
+					   record.sp, record.pc, record.pcMem[0], record.pcMem[1], record.pcMem[2], record.pcMem[3]);
+}
+
+#pragma region writer
+TraceWriter::TraceWriter(const std::filesystem::path& path)
+	: _file(path, std::ios::binary)
+	, _isOpen(static_cast<bool>(_file))
+{
+	if (!_isOpen)
+		return;
+
+	_file.write(trace::fileMagic.data(), trace::fileMagic.size());
+	WriteLE(_file, trace::version);
+	WriteLE(_file, static_cast<u32>(recordSize));
+	WriteLE(_file, static_cast<u32>(trace::blockRecords));
+
+	_block.reserve(trace::blockRecords);
+	_writer = std::jthread{ [this](std::stop_token stop) { WriteBlocks(stop); } };
+}
+
+TraceWriter::~TraceWriter() {
+	Close();
+}
+
+void TraceWriter::Submit() {
+	_recordCount += _block.size();
+
+	{
+		std::scoped_lock lock{ _mutex };
+		_queue.push_back(std::move(_block));
+	}
+
+	_blockReady.notify_one();
+
+	_block = {};
+	_block.reserve(trace::blockRecords);
+}
+
+void TraceWriter::Close() {
+	if (!_isOpen)
+		return;
+
+	if (!_block.empty())
+		Submit();
+
+	// The writing thread finishes what's queued before it stops.
+	_writer.request_stop();
+	_writer.join();
+
+	const u64 indexOffset = static_cast<u64>(_file.tellp());
+	_file.write(trace::indexMagic.data(), trace::indexMagic.size());
+	WriteLE(_file, _writtenRecords);
+	WriteLE(_file, static_cast<u64>(_index.size()));
+
+	for (const IndexEntry& entry : _index) {
+		WriteLE(_file, entry.firstCycle);
+		WriteLE(_file, entry.firstRecord);
+		WriteLE(_file, entry.offset);
+	}
+
+	// Last, so readers can find the index from the end of the file.
+	WriteLE(_file, indexOffset);
+
+	_file.close();
+	_isOpen = false;
+}
+
+void TraceWriter::WriteBlocks(std::stop_token stop) {
+	std::vector<byte> deltas;
+	std::vector<byte> compressed;
+
+	while (true) {
+		std::vector<TraceRecord> block;
+
+		{
+			std::unique_lock lock{ _mutex };
+			if (!_blockReady.wait(lock, stop, [this] { return !_queue.empty(); }))
+				return;
+
+			block = std::move(_queue.front());
+			_queue.pop_front();
+		}
+
+		deltas.clear();
+		compressed.clear();
+
+		PackedRecord prev{};
+		u64 prevCycle = 0;
+
+		for (const TraceRecord& record : block) {
+			const PackedRecord packed = Pack(record);
+
+			std::array<byte, recordSize> delta;
+			PutLE(&delta[0], record.cycle - prevCycle);
+			for (std::size_t i = 8; i < recordSize; ++i)
+				delta[i] = packed[i] ^ prev[i];
+
+			deltas.insert(deltas.end(), delta.begin(), delta.end());
+			prev = packed;
+			prevCycle = record.cycle;
+		}
+
+		CompressZeros(deltas, compressed);
+
+		_index.push_back({ block.front().cycle, _writtenRecords, static_cast<u64>(_file.tellp()) });
+		_writtenRecords += block.size();
+
+		WriteLE(_file, static_cast<u32>(block.size()));
+		WriteLE(_file, static_cast<u32>(compressed.size()));
+		_file.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+	}
+}
+#pragma endregion writer
+
+#pragma region reader
+TraceReader::TraceReader(const std::filesystem::path& path)
+	: _file(path, std::ios::binary)
+{
+	std::array<char, 8> magic{};
+	u32 version = 0, size = 0, records = 0;
+
+	if (!_file.read(magic.data(), magic.size()) || magic != trace::fileMagic)
+		return;
+
+	if (!ReadLE(_file, version) || !ReadLE(_file, size) || !ReadLE(_file, records))
+		return;
+
+	if (version != trace::version || size != recordSize)
+		return;
+
+	u64 indexOffset = 0, blockCount = 0;
+	_file.seekg(-static_cast<std::streamoff>(sizeof(u64)), std::ios::end);
+	if (!ReadLE(_file, indexOffset))
+		return;
+
+	_file.seekg(static_cast<std::streamoff>(indexOffset));
+	if (!_file.read(magic.data(), magic.size()) || magic != trace::indexMagic)
+		return;
+
+	if (!ReadLE(_file, _recordCount) || !ReadLE(_file, blockCount))
+		return;
+
+	_index.resize(blockCount);
+	for (IndexEntry& entry : _index) {
+		if (!ReadLE(_file, entry.firstCycle) || !ReadLE(_file, entry.firstRecord) || !ReadLE(_file, entry.offset))
+			return;
+	}
+
+	_isOpen = true;
+}
+
+bool TraceReader::ReadBlock(std::size_t block, std::vector<TraceRecord>& records) {
+	_file.clear();
+	_file.seekg(static_cast<std::streamoff>(_index[block].offset));
+
+	u32 count = 0, size = 0;
+	if (!ReadLE(_file, count) || !ReadLE(_file, size))
+		return false;
+
+	std::vector<byte> compressed(size);
+	if (!_file.read(reinterpret_cast<char*>(compressed.data()), size))
+		return false;
+
+	std::vector<byte> deltas;
+	if (!DecompressZeros(compressed, deltas, count * recordSize))
+		return false;
+
+	records.clear();
+
+	PackedRecord packed{};
+	u64 cycle = 0;
+
+	for (u32 i = 0; i < count; ++i) {
+		const byte* delta = &deltas[i * recordSize];
+
+		cycle += GetLE<u64>(delta);
+		for (std::size_t j = 8; j < recordSize; ++j)
+			packed[j] ^= delta[j];
+
+		PutLE(&packed[0], cycle);
+		records.push_back(Unpack(packed));
+	}
+
+	return true;
+}
+
+bool TraceReader::Read(u64 firstCycle, u64 lastCycle, const std::function<bool(const TraceRecord&)>& visit) {
+	if (!_isOpen)
+		return false;
+
+	// The last block that starts at or before firstCycle.
+	const auto next = std::ranges::upper_bound(_index, firstCycle, {}, &IndexEntry::firstCycle);
+	std::size_t block = next == _index.begin() ? 0 : static_cast<std::size_t>(std::distance(_index.begin(), next) - 1);
+
+	std::vector<TraceRecord> records;
+	for (; block < _index.size() && _index[block].firstCycle <= lastCycle; ++block) {
+		if (!ReadBlock(block, records))
+			return false;
+
+		for (const TraceRecord& record : records) {
+			if (record.cycle > lastCycle)
+				return true;
+
+			if (record.cycle >= firstCycle && !visit(record))
+				return true;
+		}
+	}
+
+	return true;
+}
+#pragma endregion reader
+
+} // namespace gb
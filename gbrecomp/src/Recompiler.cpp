@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <array>
+#include <format>
+#include <optional>
+#include <print>
+#include <ranges>
+#include <span>
+
+#include "Recompiler.hpp"
+#include "InstrInfo.hpp"
+#include "ROM.hpp"
+
+namespace gb::recomp {
+
+using cpu::Flow;
+using cpu::instrInfo;
+
+// ld a, imm8 and ld [imm16], a. Together they're how almost every game switches banks.
+static constexpr byte ldAccImm8 = 0x3E;
+static constexpr byte ldImm16Acc = 0xEA;
+
+// Writes to [$2000, $3FFF] select the bank mapped into [$4000, $7FFF].
+static constexpr u16 romBankSelect = 0x2000;
+
+// rst vectors and interrupt handlers.
+static constexpr std::array<u16, 13> vectors = {
+	0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38,
+	0x40, 0x48, 0x50, 0x58, 0x60
+};
+
+Recompiler::Recompiler(std::vector<byte> rom, Options options)
+	: _rom(std::move(rom))
+	, _options(options)
+	, _bankCount(std::max<u32>(2, static_cast<u32>(_rom.size() / romBankSize)))
+{}
+
+void Recompiler::Trace() {
+	// bank 1 is mapped on power up
+	AddEntry(0x0100, 1);
+
+	for (u16 vector : vectors)
+		AddEntry(vector, unknownBank);
+
+	while (!_worklist.empty()) {
+		auto [addr, bank] = _worklist.back();
+		_worklist.pop_back();
+
+		TraceBlock(addr, bank);
+	}
+}
+
+void Recompiler::AddEntry(u16 addr, u32 bank) {
+	// small roms don't have any banks to switch between
+	if (bank == unknownBank && _bankCount <= 2)
+		bank = 1;
+
+	if (addr >= rom0End && addr < romNEnd && bank == unknownBank) {
+		if (_options.allBanks) {
+			for (u32 b = 1; b < _bankCount; ++b)
+				AddEntry(addr, b);
+		}
+
+		return;
+	}
+
+	if (RomAddr(addr, bank) == noRomAddr)
+		return;
+
+	if (_visited.emplace(addr, bank).second)
+		_worklist.emplace_back(addr, bank);
+}
+
+void Recompiler::TraceBlock(u16 addr, u32 bank) {
+	Block block{ addr, {} };
+
+	std::optional<byte> knownAcc;
+	u32 mappedBank = bank;
+	u16 pc = addr;
+
+	while (block.instrs.size() < _options.maxBlockInstrs) {
+		const u32 romAddr = RomAddr(pc, bank);
+		if (romAddr == noRomAddr)
+			break;
+
+		const byte op = _rom[romAddr];
+		const cpu::InstrInfo info = instrInfo[op];
+
+		// Unused op codes hang the cpu, leave that to the interpreter.
+		if (info.flow == Flow::INVALID)
+			break;
+
+		// The whole instruction has to be in the same rom window.
+		const u16 last = static_cast<u16>(pc + info.length - 1);
+		if (last / romBankSize != pc / romBankSize || RomAddr(last, bank) == noRomAddr)
+			break;
+
+		u16 imm = 0;
+		for (byte i = 1; i < info.length; ++i)
+			imm |= static_cast<u16>(_rom[romAddr + i] << (8 * (i - 1)));
+
+		block.instrs.push_back({ pc, op, info.length, imm });
+		pc += info.length;
+
+		if (cpu::EndsBlock(info.flow))
+			break;
+
+		if (op == ldAccImm8) {
+			knownAcc = static_cast<byte>(imm);
+			continue;
+		}
+
+		if (op == ldImm16Acc && imm >= romBankSelect && imm < rom0End) {
+			// The block is left after a bank switch at runtime anyway, so end it here and keep going in the new bank.
+			if (knownAcc) {
+				mappedBank = (*knownAcc & 0x1F) == 0 ? 1 : (*knownAcc & 0x1F);
+				mappedBank %= _bankCount;
+			}
+			else
+				mappedBank = unknownBank;
+
+			break;
+		}
+
+		knownAcc.reset();
+	}
+
+	if (block.instrs.empty())
+		return;
+
+	const Instr lastInstr = block.instrs.back();
+	const Flow flow = instrInfo[lastInstr.op].flow;
+
+	auto addSuccessor = [&](u16 target) { AddEntry(target, mappedBank); };
+
+	switch (flow) {
+	case Flow::NEXT:
+		addSuccessor(pc);
+		break;
+	case Flow::JUMP:
+	case Flow::COND_JUMP:
+		addSuccessor(lastInstr.length == 2 ? static_cast<u16>(pc + static_cast<sbyte>(lastInstr.imm)) : lastInstr.imm);
+		break;
+	case Flow::CALL:
+	case Flow::COND_CALL:
+		addSuccessor(lastInstr.length == 1 ? static_cast<u16>(lastInstr.op & 0b00'111'000) : lastInstr.imm);
+		// the call returns to the next instruction
+		addSuccessor(pc);
+		break;
+	default:
+		break;
+	}
+
+	if (flow == Flow::COND_JUMP || flow == Flow::COND_RET)
+		addSuccessor(pc);
+
+	const u32 romAddr = RomAddr(addr, bank);
+	if (!_blocks.contains(romAddr)) {
+		_instrCount += block.instrs.size();
+		_blocks.emplace(romAddr, std::move(block));
+	}
+}
+
+u32 Recompiler::RomAddr(u16 addr, u32 bank) const {
+	u32 romAddr = noRomAddr;
+
+	if (addr < rom0End)
+		romAddr = addr;
+	else if (addr < romNEnd && bank != unknownBank)
+		romAddr = bank * romBankSize + (addr - rom0End);
+
+	return romAddr < _rom.size() ? romAddr : noRomAddr;
+}
+
+std::string Recompiler::Title() const {
+	std::string title;
+
+	for (u16 addr = 0x0134; addr <= 0x0143 && _rom[addr] != 0; ++addr) {
+		const char c = static_cast<char>(_rom[addr]);
+		title.push_back(c >= ' ' && c <= '~' && c != '"' && c != '\\' ? c : '?');
+	}
+
+	return title;
+}
+
+u16 Recompiler::GlobalChecksum() const {
+	return static_cast<u16>(_rom[0x014E] << 8 | _rom[0x014F]);
+}
+
+u64 Recompiler::BankHash(u32 bank) const {
+	const std::size_t start = static_cast<std::size_t>(bank) * romBankSize;
+	return rom::Hash(std::span{ _rom }.subspan(start, std::min<std::size_t>(romBankSize, _rom.size() - start)));
+}
+
+void Recompiler::Emit(std::ostream& out, const std::string& romName) const {
+	std::println(out, "// Generated by gbrecomp from {}. Do not edit.", romName);
+	std::println(out, "// {} blocks, {} instructions.", _blocks.size(), _instrCount);
+	std::println(out, "");
+	std::println(out, "#include \"RecompiledSupport.hpp\"");
+	std::println(out, "");
+	std::println(out, "namespace {{");
+	std::println(out, "");
+	std::println(out, "using namespace gb;");
+	std::println(out, "using namespace gb::cpu;");
+	std::println(out, "using recomp::Exec;");
+
+	for (const auto& [romAddr, block] : _blocks) {
+		std::println(out, "");
+		std::println(out, "// ${:04X} (bank {})", block.addr, romAddr / romBankSize);
+		std::println(out, "void block_{:06X}(Context& cpu, Memory& mem, Recompiled& rt) {{", romAddr);
+
+		for (std::size_t i = 0; i < block.instrs.size(); ++i) {
+			const Instr& instr = block.instrs[i];
+
+			std::string bytes = std::format("{:02x}", instr.op);
+			for (byte b = 1; b < instr.length; ++b)
+				bytes += std::format(" {:02x}", static_cast<byte>(instr.imm >> (8 * (b - 1))));
+
+			std::println(out, "\tExec<0x{:02X}>(cpu, mem, 0x{:04X});\t// ${:04X}: {}", instr.op, instr.imm, instr.addr, bytes);
+
+			if (i + 1 < block.instrs.size()) {
+				const u16 next = static_cast<u16>(instr.addr + instr.length);
+				std::println(out, "\tif (rt.Retire() || cpu.reg.pc != 0x{:04X}) return;", next);
+			}
+			else
+				std::println(out, "\trt.Retire();");
+		}
+
+		std::println(out, "}}");
+	}
+
+	std::set<u32> banks;
+	for (const u32 romAddr : _blocks | std::views::keys)
+		banks.insert(romAddr / romBankSize);
+
+	std::println(out, "");
+	std::println(out, "constexpr RecompiledBank banks[] = {{");
+	for (const u32 bank : banks)
+		std::println(out, "\t{{ {}, 0x{:016X} }},", bank, BankHash(bank));
+	std::println(out, "}};");
+
+	std::println(out, "");
+	std::println(out, "constexpr RecompiledBlock blocks[] = {{");
+	for (const auto& [romAddr, block] : _blocks)
+		std::println(out, "\t{{ 0x{:06X}, &block_{:06X} }},", romAddr, romAddr);
+	std::println(out, "}};");
+	std::println(out, "");
+	std::println(out, "}} // namespace");
+	std::println(out, "");
+	std::println(out, "extern const gb::cpu::RecompiledRom recompiledRom{{ \"{}\", 0x{:04X}, banks, blocks }};",
+				 Title(), GlobalChecksum());
+}
+
+} // namespace gb::recomp
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Core.hpp"
+
+namespace gb::recomp {
+
+struct Options {
+	// Follow jumps into [$4000, $7FFF] from code that doesn't say which bank it mapped into every bank.
+	// Finds more code, but also translates data that happens to look like code.
+	bool allBanks = false;
+
+	u32 maxBlockInstrs = 64;
+};
+
+/*
+	Finds the code in a rom by tracing it from the entry points (the header entry, rst vectors, and
+	interrupt vectors) and emits a C++ function for every basic block it finds.
+	Code in [$4000, $7FFF] is traced per bank. The bank is followed through constant bank switches
+	(ld a, n; ld [$2000-$3FFF], a). Anything that can't be found statically (jp hl, jump tables, code in
+	ram...) is left to the interpreter at runtime.
+*/
+class Recompiler {
+public:
+	Recompiler(std::vector<byte> rom, Options options);
+
+	void Trace();
+
+	// Writes a translation unit that defines `recompiledRom`.
+	void Emit(std::ostream& out, const std::string& romName) const;
+
+	inline std::size_t BlockCount() const { return _blocks.size(); }
+	inline std::size_t InstrCount() const { return _instrCount; }
+
+private:
+	// No bank is known to be mapped into [$4000, $7FFF].
+	static constexpr u32 unknownBank = 0;
+	static constexpr u32 noRomAddr = ~0u;
+
+	struct Instr {
+		u16 addr;
+		byte op;
+		byte length;
+		u16 imm;
+	};
+
+	struct Block {
+		u16 addr;
+		std::vector<Instr> instrs;
+	};
+
+	// Code at addr with the given bank mapped into [$4000, $7FFF].
+	void AddEntry(u16 addr, u32 bank);
+	void TraceBlock(u16 addr, u32 bank);
+
+	// Physical rom address of addr, or noRomAddr if it isn't in the rom.
+	u32 RomAddr(u16 addr, u32 bank) const;
+
+	std::string Title() const;
+	u16 GlobalChecksum() const;
+
+	// rom::Hash of a whole bank, which the emulator checks before running any of the blocks.
+	u64 BankHash(u32 bank) const;
+
+private:
+	std::vector<byte> _rom;
+	Options _options;
+	u32 _bankCount;
+
+	// Blocks are keyed by physical address so the output is sorted by bank.
+	std::map<u32, Block> _blocks;
+	std::set<std::pair<u32, u32>> _visited;
+	std::vector<std::pair<u16, u32>> _worklist;
+	std::size_t _instrCount = 0;
+};
+
+} // namespace gb::recomp
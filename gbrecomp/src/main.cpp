@@ -0,0 +1,61 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <string_view>
+#include <vector>
+
+#include "Recompiler.hpp"
+
+// gbrecomp <rom> <output.cpp> [--all-banks]
+// Translates a rom into a C++ translation unit that can be linked into the emulator with gb_add_recompiled_rom.
+int main(int argc, char** argv) {
+	using namespace gb;
+
+	if (argc < 3) {
+		std::println(stderr, "Usage: gbrecomp <rom> <output.cpp> [--all-banks]");
+		return 1;
+	}
+
+	const std::filesystem::path romPath = argv[1];
+	const std::filesystem::path outPath = argv[2];
+
+	recomp::Options options{};
+	for (int i = 3; i < argc; ++i) {
+		if (std::string_view{ argv[i] } == "--all-banks")
+			options.allBanks = true;
+		else {
+			std::println(stderr, "Unknown option: {}", argv[i]);
+			return 1;
+		}
+	}
+
+	std::ifstream romFile{ romPath, std::ios::binary };
+	if (!romFile) {
+		std::println(stderr, "Couldn't open {}.", romPath.string());
+		return 1;
+	}
+
+	std::vector<byte> rom{ std::istreambuf_iterator<char>{ romFile }, std::istreambuf_iterator<char>{} };
+
+	// too small to even have a header
+	if (rom.size() < 0x0150) {
+		std::println(stderr, "{} isn't a gameboy rom.", romPath.string());
+		return 1;
+	}
+
+	recomp::Recompiler recompiler{ std::move(rom), options };
+	recompiler.Trace();
+
+	std::ofstream out{ outPath };
+	if (!out) {
+		std::println(stderr, "Couldn't write to {}.", outPath.string());
+		return 1;
+	}
+
+	recompiler.Emit(out, romPath.filename().string());
+
+	std::println("{}: {} blocks, {} instructions", romPath.filename().string(), recompiler.BlockCount(),
+				 recompiler.InstrCount());
+	return 0;
+}
@@ -0,0 +1,22 @@
+#include <print>
+
+#include "Emulator.hpp"
+#include "Recompiled.hpp"
+
+// Defined in the code gbrecomp generated for this executable.
+extern const gb::cpu::RecompiledRom recompiledRom;
+
+// Runs the rom the code was generated from, or the rom given on the command line.
+int main(int argc, char** argv) {
+	const std::filesystem::path romPath = argc > 1 ? argv[1] : RECOMPILED_ROM;
+
+	gb::Emu emu{ romPath };
+
+	if (!emu.SetRecompiled(recompiledRom)) {
+		std::println(stderr, "{} isn't the rom {} was recompiled from.", romPath.string(), recompiledRom.title);
+		return 1;
+	}
+
+	emu.Run();
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include <charconv>
+
+#include "JsonReader.hpp"
+
+void JsonReader::SkipSpace() {
+	while (_pos < _text.size() && (_text[_pos] == ' ' || _text[_pos] == '\n' || _text[_pos] == '\r' || _text[_pos] == '\t'))
+		++_pos;
+}
+
+bool JsonReader::Consume(char c) {
+	SkipSpace();
+
+	if (_pos < _text.size() && _text[_pos] == c) {
+		++_pos;
+		return true;
+	}
+
+	return false;
+}
+
+bool JsonReader::BeginArray() {
+	return !_failed && (Consume('[') || Fail());
+}
+
+bool JsonReader::BeginObject() {
+	return !_failed && (Consume('{') || Fail());
+}
+
+bool JsonReader::NextElement() {
+	if (_failed)
+		return false;
+
+	// The comma before every value but the first.
+	Consume(',');
+
+	if (Consume(']'))
+		return false;
+
+	return _pos < _text.size() || Fail();
+}
+
+bool JsonReader::NextMember(std::string_view& key) {
+	if (_failed)
+		return false;
+
+	Consume(',');
+
+	if (Consume('}'))
+		return false;
+
+	return (String(key) && Consume(':')) || Fail();
+}
+
+bool JsonReader::Number(std::uint64_t& value) {
+	if (_failed)
+		return false;
+
+	SkipSpace();
+
+	auto [ptr, ec] = std::from_chars(_text.data() + _pos, _text.data() + _text.size(), value);
+	if (ec != std::errc{})
+		return Fail();
+
+	_pos = static_cast<std::size_t>(ptr - _text.data());
+	return true;
+}
+
+bool JsonReader::String(std::string_view& str) {
+	if (_failed || !Consume('"'))
+		return Fail();
+
+	const std::size_t start = _pos;
+	while (_pos < _text.size() && _text[_pos] != '"')
+		_pos += _text[_pos] == '\\' ? 2 : 1;
+
+	if (_pos >= _text.size())
+		return Fail();
+
+	str = _text.substr(start, _pos - start);
+	++_pos;
+	return true;
+}
+
+bool JsonReader::Null() {
+	SkipSpace();
+
+	if (_failed || !_text.substr(_pos).starts_with("null"))
+		return false;
+
+	_pos += 4;
+	return true;
+}
+
+bool JsonReader::Skip() {
+	if (_failed)
+		return false;
+
+	SkipSpace();
+	if (_pos >= _text.size())
+		return Fail();
+
+	const char c = _text[_pos];
+	if (c == '"') {
+		std::string_view str;
+		return String(str);
+	}
+
+	if (c == '[' || c == '{')
+		return SkipNested();
+
+	// Numbers, true, false, and null all end at the next delimiter.
+	while (_pos < _text.size() && _text[_pos] != ',' && _text[_pos] != ']' && _text[_pos] != '}')
+		++_pos;
+
+	return true;
+}
+
+bool JsonReader::SkipNested() {
+	int depth = 0;
+
+	do {
+		SkipSpace();
+		if (_pos >= _text.size())
+			return Fail();
+
+		const char c = _text[_pos];
+		if (c == '"') {
+			std::string_view str;
+			if (!String(str))
+				return false;
+
+			continue;
+		}
+
+		if (c == '[' || c == '{')
+			++depth;
+		else if (c == ']' || c == '}')
+			--depth;
+
+		++_pos;
+	} while (depth > 0);
+
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/*
+	Reads json one value at a time straight out of the text, without building a tree of the whole file.
+	Only what the sm83 test files use is understood: objects, arrays, unsigned integers, strings without escapes
+	that matter, and null. Anything else can still be skipped over.
+	Every function returns false on malformed input, and Failed stays true from then on.
+
+	Arrays and objects are read with a loop:
+		reader.BeginArray();
+		while (reader.NextElement()) { ...read one value... }
+*/
+class JsonReader {
+public:
+	explicit JsonReader(std::string_view text) : _text(text) {}
+
+	bool BeginArray();
+	bool BeginObject();
+
+	// True if there's another value in the array, false after the closing bracket.
+	bool NextElement();
+
+	// True and the key if there's another member in the object, false after the closing brace.
+	bool NextMember(std::string_view& key);
+
+	bool Number(std::uint64_t& value);
+
+	// The raw text between the quotes.
+	bool String(std::string_view& str);
+
+	// Reads a null if that's what's next.
+	bool Null();
+
+	// Skips over the next value, whatever it is.
+	bool Skip();
+
+	inline bool Failed() const { return _failed; }
+	inline std::size_t Offset() const { return _pos; }
+
+private:
+	void SkipSpace();
+
+	// Consumes c if it's next.
+	bool Consume(char c);
+
+	// The next value ends at the matching bracket or the next delimiter.
+	bool SkipNested();
+
+	inline bool Fail() { _failed = true; return false; }
+
+private:
+	std::string_view _text;
+	std::size_t _pos = 0;
+	bool _failed = false;
+};
@@ -0,0 +1,368 @@
+#if defined(DEBUG) && defined(TESTS)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Core.hpp"
+#include "CPU.hpp"
+#include "Memory.hpp"
+#include "Timer.hpp"
+#include "JsonReader.hpp"
+
+namespace {
+
+using namespace gb;
+
+struct State {
+	u16 pc = 0, sp = 0;
+	u16 af = 0, bc = 0, de = 0, hl = 0;
+	bool ime = false;
+	std::vector<Memory::FlatWrite> ram;
+};
+
+struct Case {
+	std::string_view name;
+	State initial;
+	State final;
+	u64 cycles = 0;
+	std::vector<Memory::FlatWrite> writes;	// in the order the cycles make them
+};
+
+struct FileResult {
+	std::string name;
+	std::size_t passed = 0;
+	std::size_t failed = 0;
+	std::string firstFailure{};
+};
+
+// Both are [addr, value] pairs, and cycles can also be null on cycles that don't touch the bus.
+bool ReadPair(JsonReader& reader, Memory::FlatWrite& pair, std::string_view* type = nullptr) {
+	u64 addr = 0, val = 0;
+	if (!reader.BeginArray() || !reader.NextElement() || !reader.Number(addr) || !reader.NextElement() || !reader.Number(val))
+		return false;
+
+	pair = { static_cast<u16>(addr), static_cast<byte>(val) };
+
+	while (reader.NextElement()) {
+		if (type && type->empty() ? !reader.String(*type) : !reader.Skip())
+			return false;
+	}
+
+	return !reader.Failed();
+}
+
+bool ReadState(JsonReader& reader, State& state) {
+	state.ram.clear();
+
+	byte a = 0, f = 0, b = 0, c = 0, d = 0, e = 0, h = 0, l = 0;
+	auto number = [&](auto& out) {
+		u64 val = 0;
+		if (!reader.Number(val))
+			return false;
+
+		out = static_cast<std::remove_reference_t<decltype(out)>>(val);
+		return true;
+	};
+
+	if (!reader.BeginObject())
+		return false;
+
+	std::string_view key;
+	while (reader.NextMember(key)) {
+		bool ok = true;
+
+		if (key == "pc") ok = number(state.pc);
+		else if (key == "sp") ok = number(state.sp);
+		else if (key == "a") ok = number(a);
+		else if (key == "f") ok = number(f);
+		else if (key == "b") ok = number(b);
+		else if (key == "c") ok = number(c);
+		else if (key == "d") ok = number(d);
+		else if (key == "e") ok = number(e);
+		else if (key == "h") ok = number(h);
+		else if (key == "l") ok = number(l);
+		else if (key == "ime") ok = number(state.ime);
+		else if (key == "ram") {
+			ok = reader.BeginArray();
+			while (ok && reader.NextElement())
+				ok = ReadPair(reader, state.ram.emplace_back());
+		}
+		else
+			ok = reader.Skip();
+
+		if (!ok)
+			return false;
+	}
+
+	state.af = static_cast<u16>((a << 8) | f);
+	state.bc = static_cast<u16>((b << 8) | c);
+	state.de = static_cast<u16>((d << 8) | e);
+	state.hl = static_cast<u16>((h << 8) | l);
+	return !reader.Failed();
+}
+
+bool ReadCase(JsonReader& reader, Case& test) {
+	test.cycles = 0;
+	test.writes.clear();
+
+	if (!reader.BeginObject())
+		return false;
+
+	std::string_view key;
+	while (reader.NextMember(key)) {
+		bool ok = true;
+
+		if (key == "name") ok = reader.String(test.name);
+		else if (key == "initial") ok = ReadState(reader, test.initial);
+		else if (key == "final") ok = ReadState(reader, test.final);
+		else if (key == "cycles") {
+			ok = reader.BeginArray();
+			while (ok && reader.NextElement()) {
+				++test.cycles;
+				if (reader.Null())
+					continue;
+
+				// like "r-m" or "-wm"
+				Memory::FlatWrite cycle;
+				std::string_view type;
+				ok = ReadPair(reader, cycle, &type);
+				if (type.contains('w'))
+					test.writes.push_back(cycle);
+			}
+		}
+		else
+			ok = reader.Skip();
+
+		if (!ok)
+			return false;
+	}
+
+	return !reader.Failed();
+}
+
+// Everything one thread needs to run tests on, reused from one file to the next.
+class Runner {
+public:
+	Runner()
+		: _memory(rom::RomData(2 * romBankSize), _timer)
+		, _ram(std::make_unique<Memory::FlatRam>())
+	{
+		_memory.SetFlatRam(_ram.get(), &_writes);
+		Reset();
+	}
+
+	FileResult RunFile(const std::filesystem::path& path) {
+		FileResult result{ path.filename().string() };
+
+		std::ifstream file{ path, std::ios::binary };
+		const std::string text{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+		JsonReader reader{ text };
+		reader.BeginArray();
+
+		while (reader.NextElement()) {
+			if (!ReadCase(reader, _case))
+				break;
+
+			std::string failure = Run();
+			if (failure.empty()) {
+				++result.passed;
+				continue;
+			}
+
+			if (result.failed++ == 0)
+				result.firstFailure = std::format("{}: {}", _case.name, failure);
+		}
+
+		if (reader.Failed() || text.empty()) {
+			++result.failed;
+			result.firstFailure = std::format("couldn't read the file past offset {}", reader.Offset());
+		}
+
+		return result;
+	}
+
+private:
+	// A halted cpu stays halted since flat ram never has an interrupt pending, so it has to start over.
+	void Reset() {
+		_cpu.emplace(_memory);
+		_cpu->SetIdleLoops(false);
+		_cpu->SetFusion(false);
+	}
+
+	// What's wrong, or empty if it passed.
+	std::string Run() {
+		cpu::Context& cpu = *_cpu;
+		const State& initial = _case.initial;
+		const State& final = _case.final;
+
+		for (auto [addr, val] : initial.ram)
+			(*_ram)[addr] = val;
+
+		// pc is at the op code, which the test expects to be fetched as part of the instruction.
+		cpu.reg.pc = initial.pc;
+		cpu.reg.sp = initial.sp;
+		cpu.reg.af(initial.af);
+		cpu.reg.bc(initial.bc);
+		cpu.reg.de(initial.de);
+		cpu.reg.hl(initial.hl);
+
+		cpu.DisableInterrupts();
+		if (initial.ime)
+			cpu.ForceEnableInterrupts();
+
+		_writes.clear();
+
+		std::string failure;
+		auto check = [&](std::string_view what, u64 expected, u64 actual) {
+			if (failure.empty() && expected != actual)
+				failure = std::format("{} is ${:X}, expected ${:X}", what, actual, expected);
+		};
+
+		if (!cpu.Update())
+			failure = "the cpu stopped";
+
+		check("pc", final.pc, cpu.reg.pc);
+		check("sp", final.sp, cpu.reg.sp);
+		check("af", final.af, cpu.reg.af());
+		check("bc", final.bc, cpu.reg.bc());
+		check("de", final.de, cpu.reg.de());
+		check("hl", final.hl, cpu.reg.hl());
+		check("ime", final.ime, cpu.InterruptsEnabled());
+		check("mcycles", _case.cycles, cpu.GetUpdateCycles());
+
+		for (auto [addr, val] : final.ram)
+			check(std::format("[${:04X}]", addr), val, (*_ram)[addr]);
+
+		check("number of writes", _case.writes.size(), _writes.size());
+		for (std::size_t i = 0; i < std::min(_case.writes.size(), _writes.size()); ++i) {
+			check(std::format("write {} address", i), _case.writes[i].addr, _writes[i].addr);
+			check(std::format("write {} value", i), _case.writes[i].val, _writes[i].val);
+		}
+
+		// Only what the test touched has to go back to 0 for the next one.
+		for (auto [addr, val] : initial.ram)
+			(*_ram)[addr] = 0;
+		for (auto [addr, val] : final.ram)
+			(*_ram)[addr] = 0;
+		for (auto [addr, val] : _writes)
+			(*_ram)[addr] = 0;
+
+		if (cpu.IsHalted())
+			Reset();
+
+		return failure;
+	}
+
+private:
+	Timer _timer;
+	Memory _memory;
+	std::unique_ptr<Memory::FlatRam> _ram;
+	std::vector<Memory::FlatWrite> _writes;
+	std::optional<cpu::Context> _cpu;
+
+	Case _case;
+};
+
+} // namespace
+
+// gbsm83tests <test directory or file> [threads]
+// Runs the sm83 single step tests (one json file of cases per op code) against the cpu on flat ram,
+// one file at a time on each thread.
+int main(int argc, char** argv) {
+	using namespace gb;
+
+	if (argc < 2) {
+		std::println(stderr, "Usage: gbsm83tests <test directory or file> [threads]");
+		return 1;
+	}
+
+	const std::filesystem::path testPath = argv[1];
+
+	std::vector<std::filesystem::path> files;
+	if (std::filesystem::is_directory(testPath)) {
+		for (const auto& entry : std::filesystem::directory_iterator(testPath)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".json")
+				files.push_back(entry.path());
+		}
+
+		std::ranges::sort(files);
+	}
+	else if (std::filesystem::is_regular_file(testPath))
+		files.push_back(testPath);
+
+	if (files.empty()) {
+		std::println(stderr, "No tests found in {}", testPath.string());
+		return 1;
+	}
+
+	std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	if (argc > 2)
+		threads = std::max(1, std::atoi(argv[2]));
+
+	threads = std::min(threads, files.size());
+
+	// Every instruction would otherwise be dumped.
+	cpu::Context::shortDump = false;
+	cpu::Context::longDump = false;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<FileResult> results(files.size());
+	std::atomic<std::size_t> next = 0;
+
+	{
+		std::vector<std::jthread> workers;
+		workers.reserve(threads);
+
+		for (std::size_t i = 0; i < threads; ++i) {
+			workers.emplace_back([&] {
+				Runner runner;
+				for (std::size_t file = next++; file < files.size(); file = next++)
+					results[file] = runner.RunFile(files[file]);
+			});
+		}
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::size_t passed = 0, failed = 0, failedFiles = 0;
+	for (const FileResult& result : results) {
+		passed += result.passed;
+		failed += result.failed;
+
+		if (result.failed == 0)
+			continue;
+
+		++failedFiles;
+		std::println("{}: {} of {} failed, first was {}", result.name, result.failed, result.passed + result.failed, result.firstFailure);
+	}
+
+	std::println("{} passed, {} failed in {} of {} files ({:.2f}s on {} threads)",
+				 passed, failed, failedFiles, files.size(), elapsed.count(), threads);
+
+	return failed == 0 ? 0 : 1;
+}
+
+#else // DEBUG && TESTS
+#include <print>
+
+int main() {
+	std::println(stderr, "DEBUG and TEST macros must be enabled.");
+	return 1;
+}
+#endif // DEBUG && TESTS
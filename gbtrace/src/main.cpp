@@ -0,0 +1,80 @@
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <print>
+#include <string_view>
+
+#include "Trace.hpp"
+
+static bool ParseCycle(std::string_view str, gb::u64& cycle) {
+	auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), cycle);
+	return ec == std::errc{} && ptr == str.data() + str.size();
+}
+
+// gbtrace <trace> [first cycle] [last cycle] [--cycles]
+// gbtrace <trace> --info
+// Turns a trace recorded by Emu::StartTrace back into ShortDump text, only decoding the blocks the range is in.
+int main(int argc, char** argv) {
+	using namespace gb;
+
+	if (argc < 2) {
+		std::println(stderr, "Usage: gbtrace <trace> [first cycle] [last cycle] [--cycles]");
+		std::println(stderr, "       gbtrace <trace> --info");
+		return 1;
+	}
+
+	const std::filesystem::path tracePath = argv[1];
+
+	u64 firstCycle = 0;
+	u64 lastCycle = std::numeric_limits<u64>::max();
+	bool showCycles = false;
+	bool showInfo = false;
+
+	for (int i = 2, cyclesParsed = 0; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+
+		if (arg == "--cycles")
+			showCycles = true;
+		else if (arg == "--info")
+			showInfo = true;
+		else if (cyclesParsed < 2 && ParseCycle(arg, cyclesParsed == 0 ? firstCycle : lastCycle))
+			++cyclesParsed;
+		else {
+			std::println(stderr, "Unknown argument: {}", arg);
+			return 1;
+		}
+	}
+
+	TraceReader reader{ tracePath };
+	if (!reader.IsOpen()) {
+		std::println(stderr, "{} isn't a complete trace.", tracePath.string());
+		return 1;
+	}
+
+	if (showInfo) {
+		const auto& index = reader.Index();
+
+		std::println("{}: {} records in {} blocks", tracePath.filename().string(), reader.RecordCount(), index.size());
+		if (!index.empty())
+			std::println("first block starts at mcycle {}, last block at mcycle {}", index.front().firstCycle, index.back().firstCycle);
+
+		return 0;
+	}
+
+	const bool ok = reader.Read(firstCycle, lastCycle, [&](const TraceRecord& record) {
+		if (showCycles)
+			std::println("{:>12} {}", record.cycle, trace::FormatShortDump(record));
+		else
+			std::println("{}", trace::FormatShortDump(record));
+
+		return true;
+	});
+
+	if (!ok) {
+		std::println(stderr, "{} is corrupt.", tracePath.string());
+		return 1;
+	}
+
+	return 0;
+}